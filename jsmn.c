@@ -1,4 +1,13 @@
 #include "jsmn.h"
+#ifndef JSMN_NO_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define JSMN_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define JSMN_SIMD_SSE2
+#endif
+#endif
 #ifdef JSMN_DOM
 #include "utf8.h"
 #ifdef USE_LIBC
@@ -54,6 +63,123 @@ size_t naive_strlen(const char *s) {
 #endif
 #endif
 
+/*
+ * Vectorized first stage. These helpers only ever advance over bytes the
+ * byte-at-a-time loops would also have passed over without acting, and
+ * never read at or beyond `len`, so token output is unchanged. Each
+ * returns the position at which the scalar loop should resume: exactly
+ * the first byte of interest when SIMD is available, or the start of the
+ * first block that might contain one in the portable build.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define jsmn_ctz(x) ((unsigned int)__builtin_ctz(x))
+#else
+static unsigned int jsmn_ctz(unsigned int x) {
+	unsigned int n = 0;
+	while ((x & 1) == 0) {
+		x >>= 1;
+		n++;
+	}
+	return n;
+}
+#endif
+
+/**
+ * Skips a run of string body bytes: anything but '"', '\\' or NUL.
+ */
+static unsigned int jsmn_scan_string(const char *js, unsigned int pos,
+		size_t len) {
+#if defined(JSMN_SIMD_AVX2)
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i nul = _mm256_setzero_si256();
+
+	while (pos + 32 <= len) {
+		__m256i block = _mm256_loadu_si256((const __m256i *)(js + pos));
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(block, quote),
+					_mm256_cmpeq_epi8(block, backslash)),
+				_mm256_cmpeq_epi8(block, nul)));
+		if (mask != 0) {
+			return pos + jsmn_ctz(mask);
+		}
+		pos += 32;
+	}
+#endif
+#if defined(JSMN_SIMD_AVX2) || defined(JSMN_SIMD_SSE2)
+	{
+		const __m128i quote = _mm_set1_epi8('"');
+		const __m128i backslash = _mm_set1_epi8('\\');
+		const __m128i nul = _mm_setzero_si128();
+
+		while (pos + 16 <= len) {
+			__m128i block = _mm_loadu_si128((const __m128i *)(js + pos));
+			unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(
+					_mm_or_si128(_mm_cmpeq_epi8(block, quote),
+						_mm_cmpeq_epi8(block, backslash)),
+					_mm_cmpeq_epi8(block, nul)));
+			if (mask != 0) {
+				return pos + jsmn_ctz(mask);
+			}
+			pos += 16;
+		}
+	}
+#else
+	/* SWAR: test eight bytes per step for a zero after xor-ing with each
+	 * byte of interest. */
+	while (pos + 8 <= len) {
+		const uint64_t ones = 0x0101010101010101ull;
+		const uint64_t highs = 0x8080808080808080ull;
+		uint64_t word = 0;
+		uint64_t q;
+		uint64_t b;
+		int i;
+
+		for (i = 7; i >= 0; i--) {
+			word = (word << 8) | (unsigned char)js[pos + i];
+		}
+		q = word ^ (ones * '"');
+		b = word ^ (ones * '\\');
+		if ((((word - ones) & ~word) | ((q - ones) & ~q)
+				| ((b - ones) & ~b)) & highs) {
+			return pos;
+		}
+		pos += 8;
+	}
+#endif
+	return pos;
+}
+
+/**
+ * Skips a run of insignificant whitespace: ' ', '\t', '\r' and '\n'.
+ */
+static unsigned int jsmn_scan_space(const char *js, unsigned int pos,
+		size_t len) {
+#if defined(JSMN_SIMD_AVX2) || defined(JSMN_SIMD_SSE2)
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8('\n');
+
+	while (pos + 16 <= len) {
+		__m128i block = _mm_loadu_si128((const __m128i *)(js + pos));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(block, space),
+					_mm_cmpeq_epi8(block, tab)),
+				_mm_or_si128(_mm_cmpeq_epi8(block, cr),
+					_mm_cmpeq_epi8(block, lf))));
+		if (mask != 0xFFFF) {
+			return pos + jsmn_ctz(~mask & 0xFFFF);
+		}
+		pos += 16;
+	}
+#else
+	(void)js;
+	(void)len;
+#endif
+	return pos;
+}
+
 /**
  * Allocates a fresh unused token from the token pull.
  */
@@ -65,6 +191,7 @@ static jsmntok_t *jsmn_alloc_token(jsmn_parser *parser,
 	}
 	tok = &tokens[parser->toknext++];
 	tok->start = tok->end = -1;
+	tok->escaped = 0;
 #ifdef JSMN_DOM
 	tok->family.parent = -1;
 	tok->family.siblings.prev = -1;
@@ -173,12 +300,28 @@ static int jsmn_parse_string(jsmn_parser *parser, const char *js,
 #endif
 
 	int start = parser->pos;
-
-	parser->pos++;
+	int escaped = 0;
+	int cut = -1;
+
+	/* After JSMN_ERROR_PART, pick up where the last scan stopped
+	 * instead of re-reading the string from its opening quote. */
+	if (parser->strpos != 0 && parser->strstart == parser->pos) {
+		parser->pos = parser->strpos;
+		escaped = (int)parser->strescaped;
+	} else {
+		parser->pos++;
+	}
+	parser->strpos = 0;
 
 	/* Skip starting quote */
 	for (; parser->pos < len && js[parser->pos] != '\0'; parser->pos++) {
-		char c = js[parser->pos];
+		char c;
+
+		parser->pos = jsmn_scan_string(js, parser->pos, len);
+		if (parser->pos >= len || js[parser->pos] == '\0') {
+			break;
+		}
+		c = js[parser->pos];
 
 		/* Quote: end of string */
 		if (c == '\"') {
@@ -196,6 +339,7 @@ static int jsmn_parse_string(jsmn_parser *parser, const char *js,
 				parser->pos = start;
 				return dom_i;
 			}
+			tokens[dom_i].escaped = escaped;
 #else
 			token = jsmn_alloc_token(parser, tokens, num_tokens);
 			if (token == NULL) {
@@ -203,6 +347,7 @@ static int jsmn_parse_string(jsmn_parser *parser, const char *js,
 				return JSMN_ERROR_NOMEM;
 			}
 			jsmn_fill_token(token, JSMN_STRING, start+1, parser->pos);
+			token->escaped = escaped;
 #ifdef JSMN_PARENT_LINKS
 			token->parent = parser->toksuper;
 #endif
@@ -211,8 +356,12 @@ static int jsmn_parse_string(jsmn_parser *parser, const char *js,
 		}
 
 		/* Backslash: Quoted symbol expected */
-		if (c == '\\' && parser->pos + 1 < len) {
+		if (c == '\\' && parser->pos + 1 >= len) {
+			cut = (int)parser->pos;
+		} else if (c == '\\') {
+			int backslash = (int)parser->pos;
 			int i;
+			escaped = 1;
 			parser->pos++;
 			switch (js[parser->pos]) {
 				/* Allowed escaped symbols */
@@ -232,6 +381,9 @@ static int jsmn_parse_string(jsmn_parser *parser, const char *js,
 						}
 						parser->pos++;
 					}
+					if (i < 4) {
+						cut = backslash;
+					}
 					parser->pos--;
 					break;
 				/* Unexpected symbol */
@@ -241,6 +393,11 @@ static int jsmn_parse_string(jsmn_parser *parser, const char *js,
 			}
 		}
 	}
+	/* Everything before pos is checked; an escape cut off by the end
+	 * of input is read again from its backslash. */
+	parser->strstart = (unsigned int)start;
+	parser->strpos = cut >= 0 ? (unsigned int)cut : parser->pos;
+	parser->strescaped = (unsigned int)escaped;
 	parser->pos = start;
 	return JSMN_ERROR_PART;
 }
@@ -369,6 +526,8 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 #endif /* !JSMN_DOM */
 				break;
 			case '\t' : case '\r' : case '\n' : case ' ':
+				/* Land on the last blank of the run; the loop steps past it. */
+				parser->pos = jsmn_scan_space(js, parser->pos + 1, len) - 1;
 				break;
 			case ':':
 				parser->toksuper = parser->toknext - 1;
@@ -470,6 +629,9 @@ void jsmn_init(jsmn_parser *parser) {
 	parser->pos = 0;
 	parser->toknext = 0;
 	parser->toksuper = -1;
+	parser->strstart = 0;
+	parser->strpos = 0;
+	parser->strescaped = 0;
 }
 
 #ifdef JSMN_DOM
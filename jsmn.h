@@ -58,11 +58,13 @@ struct family_t {
 /**
  * JSON token description.
  * @param		type	type (object, array, string etc.)
+ * @param		escaped	string token whose raw span contains a backslash escape
  * @param		start	start position in JSON data string
  * @param		end		end position in JSON data string
  */
 typedef struct jsmntok_s {
-	jsmntype_t type;
+	unsigned int type : 8; /* jsmntype_t */
+	unsigned int escaped : 1;
 	int start;
 	int end;
 #ifdef JSMN_DOM
@@ -83,6 +85,9 @@ typedef struct {
 	unsigned int pos; /* offset in the JSON string */
 	unsigned int toknext; /* next token to allocate */
 	int toksuper; /* superior token node, e.g parent object or array */
+	unsigned int strstart; /* opening quote of an unterminated string */
+	unsigned int strpos; /* where that string resumes, 0 if none */
+	unsigned int strescaped; /* that string has seen an escape */
 } jsmn_parser;
 
 /**
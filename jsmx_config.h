@@ -17,6 +17,14 @@
 #define JSMX_CRYPTO_BACKEND_OPENSSL 0
 #endif
 
+#ifndef JSMX_WITH_ALLOC_STATS
+#define JSMX_WITH_ALLOC_STATS 0
+#endif
+
+#ifndef JSMX_WITH_NAN_BOXING
+#define JSMX_WITH_NAN_BOXING 0
+#endif
+
 #if JSMX_REGEX_BACKEND_PCRE2 && !JSMX_WITH_REGEX
 #error "JSMX_REGEX_BACKEND_PCRE2 requires JSMX_WITH_REGEX=1"
 #endif
@@ -16,7 +16,18 @@
 #include <zlib.h>
 
 #define JSVAL_ALIGN sizeof(void *)
-#define JSVAL_JSON_EMIT_MAX_DEPTH 256
+#define JSVAL_JSON_INDEX_MIN_LEN 8u
+#define JSVAL_JSON_OBJECT_INDEX_MIN_LEN 16u
+#ifndef JSVAL_OBJECT_INDEX_MIN_CAP
+#define JSVAL_OBJECT_INDEX_MIN_CAP 16u
+#endif
+#ifndef JSVAL_COLLECTION_INDEX_MIN_CAP
+#define JSVAL_COLLECTION_INDEX_MIN_CAP 16u
+#endif
+#ifndef JSVAL_ATOM_TABLE_MIN_CAP
+#define JSVAL_ATOM_TABLE_MIN_CAP 64u
+#endif
+#define JSVAL_ATOM_TABLE_HEAD 3u
 #define JSVAL_METHOD_CASE_EXPANSION_MAX 3u
 
 typedef struct jsval_native_string_s {
@@ -140,9 +151,31 @@ typedef struct jsval_native_promise_reaction_s {
 	uint8_t reserved[6];
 } jsval_native_promise_reaction_t;
 
+/*
+ * Value cells: the stored form of array elements, object props and
+ * slots, and Set and Map entries. A cell is a plain jsval_t unless the
+ * build sets JSMX_WITH_NAN_BOXING, which packs it into 8 bytes (see
+ * jsval_cell_pack). Read and write them through jsval_cell_unpack /
+ * jsval_cell_pack; cells copy as is within a region.
+ */
+#if JSMX_WITH_NAN_BOXING
+typedef uint64_t jsval_cell_t;
+#else
+typedef jsval_t jsval_cell_t;
+#endif
+
+/*
+ * A dictionary object holds `cap` {name, value} props. A shaped object
+ * (jsval_object_new_shaped) holds just `len` values; its keys are the
+ * props of the dictionary at shape_off. When a shaped object gains or
+ * loses a key it moves to a new dictionary node and this one is left
+ * forwarding to it, so existing handles keep working.
+ */
 typedef struct jsval_native_object_s {
 	size_t len;
 	size_t cap;
+	jsval_off_t shape_off;
+	jsval_off_t forward_off;
 } jsval_native_object_t;
 
 typedef struct jsval_native_array_s {
@@ -161,8 +194,8 @@ typedef struct jsval_native_map_s {
 } jsval_native_map_t;
 
 typedef struct jsval_native_map_entry_s {
-	jsval_t key;
-	jsval_t value;
+	jsval_cell_t key;
+	jsval_cell_t value;
 } jsval_native_map_entry_t;
 
 typedef enum jsval_iterator_mode_e {
@@ -177,7 +210,14 @@ typedef enum jsval_iterator_mode_e {
 	JSVAL_ITERATOR_MODE_MAP_ENTRIES = 8,
 	JSVAL_ITERATOR_MODE_STRING_VALUES = 9,
 	JSVAL_ITERATOR_MODE_STRING_KEYS = 10,
-	JSVAL_ITERATOR_MODE_STRING_ENTRIES = 11
+	JSVAL_ITERATOR_MODE_STRING_ENTRIES = 11,
+	/*
+	 * JSON-backed array walks: `token` carries the token index of the
+	 * next element so each step is one skip-table load instead of an
+	 * O(index) jsval_array_get.
+	 */
+	JSVAL_ITERATOR_MODE_JSON_ARRAY_VALUES = 12,
+	JSVAL_ITERATOR_MODE_JSON_ARRAY_ENTRIES = 13
 } jsval_iterator_mode_t;
 
 typedef struct jsval_native_iterator_s {
@@ -185,7 +225,8 @@ typedef struct jsval_native_iterator_s {
 	size_t cursor;
 	uint8_t mode;
 	uint8_t done;
-	uint8_t reserved[6];
+	uint8_t reserved[2];
+	uint32_t token;
 } jsval_native_iterator_t;
 
 typedef struct jsval_native_url_field_s {
@@ -689,6 +730,14 @@ typedef struct jsval_native_microtask_fetch_body_drain_s {
 	size_t budget;
 	uint8_t consume_mode;
 	uint8_t reserved[7];
+	/*
+	 * JSON consume mode only: jsmn state carried across chunks so the
+	 * body is tokenized as it arrives. The token pool is allocated on
+	 * the first chunk and doubled on JSMN_ERROR_NOMEM.
+	 */
+	jsmn_parser json_parser;
+	jsval_off_t json_tokens_off;
+	unsigned int json_tokcap;
 } jsval_native_microtask_fetch_body_drain_t;
 
 /* Phase 3c-4: drain a JS-supplied ReadableStream Request body on
@@ -923,8 +972,8 @@ typedef struct jsval_native_fetch_waitlist_entry_s {
 } jsval_native_fetch_waitlist_entry_t;
 
 typedef struct jsval_native_prop_s {
-	jsval_t name;
-	jsval_t value;
+	jsval_cell_t name;
+	jsval_cell_t value;
 } jsval_native_prop_t;
 
 typedef struct jsval_object_copy_action_s {
@@ -943,16 +992,39 @@ typedef struct jsval_json_doc_s {
 	unsigned int tokcap;
 	unsigned int tokused;
 	int root_i;
+	/*
+	 * Optional subtree-end side array: one uint32_t per used token
+	 * holding the index just past that token's subtree, so sibling
+	 * skips are a single load. 0 means "not built" (the walkers fall
+	 * back to the recursive token scan); an entry of 0 marks a
+	 * malformed subtree.
+	 */
+	jsval_off_t skip_off;
+	/*
+	 * Lazily allocated per-token slot array (one jsval_off_t per used
+	 * token, 0 until first needed). A container's slot points at its
+	 * lookup table once one has been built; see
+	 * jsval_json_array_elements and jsval_json_object_index.
+	 */
+	jsval_off_t index_off;
+	/*
+	 * Caller-owned source bytes for docs made by
+	 * jsval_json_parse_borrowed; NULL when the bytes live in the
+	 * region at json_off.
+	 */
+	const uint8_t *borrowed;
+	/*
+	 * Nonzero when the root span holds no insignificant whitespace, so
+	 * any subtree can be emitted as a straight copy of its source span.
+	 */
+	uint8_t compact;
+	/* Set by jsval_json_index_objects: wide objects get a key index. */
+	uint8_t index_objects;
+	/* Set by jsval_json_index_arrays: long arrays get an element table. */
+	uint8_t index_arrays;
+	uint8_t reserved[5];
 } jsval_json_doc_t;
 
-typedef struct jsval_json_emit_state_s {
-	uint8_t *buf;
-	size_t cap;
-	size_t len;
-	jsval_off_t stack[JSVAL_JSON_EMIT_MAX_DEPTH];
-	size_t depth;
-} jsval_json_emit_state_t;
-
 typedef struct jsval_bigint_words_s {
 	size_t len;
 	size_t cap;
@@ -1010,6 +1082,8 @@ static int jsval_ascii_space(uint8_t ch);
 static jsval_t jsval_native_make_value(jsval_region_t *region, void *ptr,
 		jsval_kind_t kind);
 static jsval_t jsval_promise_value(jsval_off_t off);
+static jsval_cell_t jsval_cell_pack(jsval_t value);
+static jsval_t jsval_cell_unpack(jsval_region_t *region, jsval_cell_t cell);
 static jsval_t jsval_crypto_key_value(jsval_off_t off);
 static int jsval_subtle_crypto_digest_parse_algorithm(jsval_region_t *region,
 		jsval_t algorithm_value, jscrypto_digest_algorithm_t *algorithm_ptr);
@@ -1078,6 +1152,89 @@ static void *jsval_region_ptr(jsval_region_t *region, jsval_off_t off)
 	return region->base + off;
 }
 
+/* Ask the region's page allocator to extend it in place to `need`. */
+static int jsval_region_grow(jsval_region_t *region, size_t need)
+{
+	size_t len = 0;
+
+	if (region->grow == NULL || need > UINT32_MAX) {
+		return -1;
+	}
+	if (region->grow(region->grow_ctx, region->base,
+			region->pages->total_len, need, &len) < 0
+			|| len < need || len > UINT32_MAX) {
+		return -1;
+	}
+	region->pages->total_len = (uint32_t)len;
+	region->len = len;
+	return 0;
+}
+
+/*
+ * Allocation accounting. Allocation sites name what they are about to
+ * reserve with JSVAL_ALLOC_TAG (a jsval_alloc_class_t, or a microtask
+ * kind via JSVAL_ALLOC_TAG_MICROTASK); the next reserve charges its
+ * bytes to that class and resets the tag to OTHER. Compiled out unless
+ * JSMX_WITH_ALLOC_STATS.
+ */
+#define JSVAL_ALLOC_TAG_MICROTASK_BASE 128u
+
+#if JSMX_WITH_ALLOC_STATS
+static void jsval_alloc_tag(jsval_region_t *region, unsigned int tag)
+{
+	if (region != NULL) {
+		region->alloc_tag = (uint8_t)tag;
+	}
+}
+
+#define JSVAL_ALLOC_TAG(region, tag) jsval_alloc_tag((region), (tag))
+#else
+#define JSVAL_ALLOC_TAG(region, tag) ((void)0)
+#endif
+#define JSVAL_ALLOC_TAG_MICROTASK(region, kind) \
+	JSVAL_ALLOC_TAG((region), JSVAL_ALLOC_TAG_MICROTASK_BASE + (kind))
+
+static void jsval_region_stats_note(jsval_region_t *region, size_t len,
+		size_t charged, size_t stop)
+{
+#if JSMX_WITH_ALLOC_STATS
+	jsval_region_stats_t *stats = region->stats;
+	unsigned int tag = region->alloc_tag;
+
+	region->alloc_tag = JSVAL_ALLOC_CLASS_OTHER;
+	if (stats == NULL) {
+		return;
+	}
+	if (tag == JSVAL_KIND_STRING && len >= sizeof(jsval_native_string_t)) {
+		stats->string_payload_bytes += len - sizeof(jsval_native_string_t);
+	} else if (tag == JSVAL_KIND_STRING_JSSTR8
+			&& len >= sizeof(jsval_native_string_jsstr8_t)) {
+		stats->string_payload_bytes += len
+				- sizeof(jsval_native_string_jsstr8_t);
+	}
+	if (tag >= JSVAL_ALLOC_TAG_MICROTASK_BASE) {
+		tag -= JSVAL_ALLOC_TAG_MICROTASK_BASE;
+		if (tag < JSVAL_ALLOC_MICROTASK_KINDS) {
+			stats->microtask_bytes[tag] += charged;
+			stats->microtask_count[tag]++;
+		}
+		tag = JSVAL_ALLOC_CLASS_MICROTASK;
+	} else if (tag >= JSVAL_ALLOC_CLASS_COUNT) {
+		tag = JSVAL_ALLOC_CLASS_OTHER;
+	}
+	stats->bytes[tag] += charged;
+	stats->count[tag]++;
+	if (stop > stats->high_water) {
+		stats->high_water = stop;
+	}
+#else
+	(void)region;
+	(void)len;
+	(void)charged;
+	(void)stop;
+#endif
+}
+
 static int jsval_region_reserve(jsval_region_t *region, size_t len, size_t align, jsval_off_t *off_ptr, void **ptr_ptr)
 {
 	size_t start;
@@ -1087,10 +1244,15 @@ static int jsval_region_reserve(jsval_region_t *region, size_t len, size_t align
 		errno = EINVAL;
 		return -1;
 	}
+	if (region->readonly) {
+		errno = EROFS;
+		return -1;
+	}
 
 	start = jsval_align_up(region->pages->used_len, align);
 	stop = start + len;
-	if (stop < start || stop > region->pages->total_len) {
+	if (stop < start || (stop > region->pages->total_len
+			&& jsval_region_grow(region, stop) < 0)) {
 		errno = ENOBUFS;
 		return -1;
 	}
@@ -1105,11 +1267,103 @@ static int jsval_region_reserve(jsval_region_t *region, size_t len, size_t align
 	if (ptr_ptr != NULL) {
 		*ptr_ptr = region->base + start;
 	}
+	jsval_region_stats_note(region, len, stop - region->pages->used_len,
+			stop);
 	region->pages->used_len = (uint32_t)stop;
 	region->used = stop;
 	return 0;
 }
 
+/*
+ * Freelist allocation for runtime nodes that die at a known point
+ * (after their microtask runs, when a pending read/write or tee chunk
+ * is dequeued). Such nodes are carved at their power-of-two class size
+ * and pushed back on the region's per-class list when dead, so a
+ * steady stream of them reuses the same bytes instead of bumping. A
+ * free node's first word links to the next. Nodes larger than the top
+ * class are bump-allocated and never recycled. While a mark or
+ * snapshot is active, free nodes below it are left alone: release and
+ * restore tell live queued nodes from the scope by offset.
+ */
+#define JSVAL_NODE_MIN_SIZE 16u
+
+static int jsval_node_class(size_t len)
+{
+	size_t size = JSVAL_NODE_MIN_SIZE;
+	int i;
+
+	for (i = 0; i < JSVAL_REGION_NODE_CLASSES; i++, size <<= 1) {
+		if (len <= size) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static size_t jsval_node_size(size_t len)
+{
+	int cls = jsval_node_class(len);
+
+	return cls < 0 ? len : (size_t)JSVAL_NODE_MIN_SIZE << cls;
+}
+
+static int jsval_region_node_alloc(jsval_region_t *region, size_t len,
+		jsval_off_t *off_ptr, void **ptr_ptr)
+{
+	int cls = jsval_node_class(len);
+	jsval_off_t off;
+
+	if (cls >= 0 && jsval_region_valid(region)
+			&& region->node_free[cls] != 0
+			&& region->node_free[cls] >= region->mark_floor) {
+		off = region->node_free[cls];
+		region->node_free[cls] = *(jsval_off_t *)(region->base + off);
+		*off_ptr = off;
+		*ptr_ptr = region->base + off;
+#if JSMX_WITH_ALLOC_STATS
+		region->alloc_tag = JSVAL_ALLOC_CLASS_OTHER;
+		if (region->stats != NULL) {
+			region->stats->recycled_count++;
+		}
+#endif
+		return 0;
+	}
+	return jsval_region_reserve(region, jsval_node_size(len), JSVAL_ALIGN,
+			off_ptr, ptr_ptr);
+}
+
+static void jsval_region_node_free(jsval_region_t *region, jsval_off_t off,
+		size_t len)
+{
+	int cls = jsval_node_class(len);
+
+	if (cls < 0 || off == 0 || region->readonly) {
+		return;
+	}
+	*(jsval_off_t *)(region->base + off) = region->node_free[cls];
+	region->node_free[cls] = off;
+}
+
+/* Drop free nodes at or above `used` (about to be reclaimed). */
+static void jsval_region_node_trim(jsval_region_t *region, size_t used)
+{
+	int i;
+
+	for (i = 0; i < JSVAL_REGION_NODE_CLASSES; i++) {
+		jsval_off_t *link = &region->node_free[i];
+
+		while (*link != 0) {
+			jsval_off_t *next = (jsval_off_t *)(region->base + *link);
+
+			if (*link >= used) {
+				*link = *next;
+			} else {
+				link = next;
+			}
+		}
+	}
+}
+
 static int jsval_region_measure_reserve(const jsval_region_t *region,
 		size_t *used_ptr, size_t len, size_t align)
 {
@@ -1123,7 +1377,8 @@ static int jsval_region_measure_reserve(const jsval_region_t *region,
 
 	start = jsval_align_up(*used_ptr, align);
 	stop = start + len;
-	if (stop < start || stop > region->pages->total_len) {
+	if (stop < start || (stop > region->pages->total_len
+			&& region->grow == NULL)) {
 		errno = ENOBUFS;
 		return -1;
 	}
@@ -1997,6 +2252,7 @@ static int jsval_bigint_new_with_words(jsval_region_t *region,
 	}
 	cap = words->len > 0 ? words->len : 1;
 	bytes_len = sizeof(*bigint) + cap * sizeof(uint32_t);
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_BIGINT);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&bigint) < 0) {
 		return -1;
@@ -2138,10 +2394,17 @@ static int jsval_bigint_compare_double(const jsval_bigint_words_t *bigint,
 
 static jsval_native_object_t *jsval_native_object(jsval_region_t *region, jsval_t value)
 {
+	jsval_native_object_t *object;
+
 	if (value.repr != JSVAL_REPR_NATIVE || value.kind != JSVAL_KIND_OBJECT) {
 		return NULL;
 	}
-	return (jsval_native_object_t *)jsval_region_ptr(region, value.off);
+	object = (jsval_native_object_t *)jsval_region_ptr(region, value.off);
+	if (object != NULL && object->forward_off != 0) {
+		object = (jsval_native_object_t *)jsval_region_ptr(region,
+				object->forward_off);
+	}
+	return object;
 }
 
 static jsval_native_prop_t *jsval_native_object_props(jsval_native_object_t *object)
@@ -2149,6 +2412,138 @@ static jsval_native_prop_t *jsval_native_object_props(jsval_native_object_t *obj
 	return (jsval_native_prop_t *)(object + 1);
 }
 
+static jsval_cell_t *jsval_native_object_slots(jsval_native_object_t *object)
+{
+	return (jsval_cell_t *)(object + 1);
+}
+
+static jsval_native_object_t *jsval_native_object_shape(jsval_region_t *region,
+		jsval_native_object_t *object)
+{
+	if (object->shape_off == 0) {
+		return NULL;
+	}
+	return (jsval_native_object_t *)jsval_region_ptr(region, object->shape_off);
+}
+
+/* Key and value of own property `i` (< len), in either layout. */
+static jsval_t jsval_native_object_name_at(jsval_region_t *region,
+		jsval_native_object_t *object, size_t i)
+{
+	jsval_native_object_t *shape = jsval_native_object_shape(region, object);
+
+	if (shape != NULL) {
+		return jsval_cell_unpack(region, jsval_native_object_props(shape)[i].name);
+	}
+	return jsval_cell_unpack(region, jsval_native_object_props(object)[i].name);
+}
+
+static jsval_cell_t *jsval_native_object_value_at(jsval_native_object_t *object,
+		size_t i)
+{
+	if (object->shape_off != 0) {
+		return &jsval_native_object_slots(object)[i];
+	}
+	return &jsval_native_object_props(object)[i].value;
+}
+
+/*
+ * Open-addressed entry index kept after the fixed-capacity entries of
+ * large native objects, sets and maps: (mask + 1) {hash, entry index +
+ * 1} uint32_t pairs, 0 marking an empty slot, where mask + 1 is the
+ * smallest power of two >= 2 * cap. The entries stay in insertion
+ * order; the index only speeds up lookups. Returns 0 (no index) below
+ * `min_cap`, or always when `min_cap` is 0.
+ */
+static size_t jsval_hash_index_cap(size_t cap, size_t min_cap)
+{
+	size_t index_cap = 1;
+
+	if (min_cap == 0 || cap < min_cap) {
+		return 0;
+	}
+	while (index_cap < cap * 2) {
+		index_cap <<= 1;
+	}
+	return index_cap;
+}
+
+static void jsval_hash_index_put(uint32_t *index, size_t index_cap,
+		uint32_t hash, size_t entry_index)
+{
+	uint32_t mask = (uint32_t)(index_cap - 1);
+	uint32_t slot = hash & mask;
+
+	while (index[slot * 2 + 1] != 0) {
+		slot = (slot + 1) & mask;
+	}
+	index[slot * 2] = hash;
+	index[slot * 2 + 1] = (uint32_t)entry_index + 1;
+}
+
+/*
+ * Drop entry `entry_index` (hashed to `hash`) after the entries above
+ * it were shifted down by one: backward-shift the probe run past its
+ * slot, then renumber. Stored hashes make this rehash-free.
+ */
+static void jsval_hash_index_remove(uint32_t *index, size_t index_cap,
+		uint32_t hash, size_t entry_index)
+{
+	uint32_t mask = (uint32_t)(index_cap - 1);
+	uint32_t want = (uint32_t)entry_index + 1;
+	uint32_t hole = hash & mask;
+	uint32_t slot;
+
+	while (index[hole * 2 + 1] != want) {
+		if (index[hole * 2 + 1] == 0) {
+			return;
+		}
+		hole = (hole + 1) & mask;
+	}
+	for (slot = (hole + 1) & mask; index[slot * 2 + 1] != 0;
+			slot = (slot + 1) & mask) {
+		uint32_t home = index[slot * 2] & mask;
+
+		if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+			index[hole * 2] = index[slot * 2];
+			index[hole * 2 + 1] = index[slot * 2 + 1];
+			hole = slot;
+		}
+	}
+	index[hole * 2] = 0;
+	index[hole * 2 + 1] = 0;
+	for (slot = 0; slot <= mask; slot++) {
+		if (index[slot * 2 + 1] > want) {
+			index[slot * 2 + 1]--;
+		}
+	}
+}
+
+/*
+ * Native objects created with at least JSVAL_OBJECT_INDEX_MIN_CAP
+ * property slots (build with -DJSVAL_OBJECT_INDEX_MIN_CAP=N to tune;
+ * 0 disables) index their props by key.
+ */
+static size_t jsval_native_object_index_cap(size_t cap)
+{
+	return jsval_hash_index_cap(cap, JSVAL_OBJECT_INDEX_MIN_CAP);
+}
+
+static size_t jsval_native_object_bytes(size_t cap)
+{
+	return sizeof(jsval_native_object_t) + cap * sizeof(jsval_native_prop_t)
+			+ jsval_native_object_index_cap(cap) * 2 * sizeof(uint32_t);
+}
+
+static uint32_t *jsval_native_object_index(jsval_native_object_t *object)
+{
+	if (object->shape_off != 0
+			|| jsval_native_object_index_cap(object->cap) == 0) {
+		return NULL;
+	}
+	return (uint32_t *)(jsval_native_object_props(object) + object->cap);
+}
+
 static jsval_native_array_t *jsval_native_array(jsval_region_t *region, jsval_t value)
 {
 	if (value.repr != JSVAL_REPR_NATIVE || value.kind != JSVAL_KIND_ARRAY) {
@@ -2157,9 +2552,9 @@ static jsval_native_array_t *jsval_native_array(jsval_region_t *region, jsval_t
 	return (jsval_native_array_t *)jsval_region_ptr(region, value.off);
 }
 
-static jsval_t *jsval_native_array_values(jsval_native_array_t *array)
+static jsval_cell_t *jsval_native_array_values(jsval_native_array_t *array)
 {
-	return (jsval_t *)(array + 1);
+	return (jsval_cell_t *)(array + 1);
 }
 
 static jsval_native_set_t *jsval_native_set(jsval_region_t *region, jsval_t value)
@@ -2170,9 +2565,9 @@ static jsval_native_set_t *jsval_native_set(jsval_region_t *region, jsval_t valu
 	return (jsval_native_set_t *)jsval_region_ptr(region, value.off);
 }
 
-static jsval_t *jsval_native_set_values(jsval_native_set_t *set)
+static jsval_cell_t *jsval_native_set_values(jsval_native_set_t *set)
 {
-	return (jsval_t *)(set + 1);
+	return (jsval_cell_t *)(set + 1);
 }
 
 static jsval_native_map_t *jsval_native_map(jsval_region_t *region, jsval_t value)
@@ -2188,6 +2583,43 @@ static jsval_native_map_entry_t *jsval_native_map_entries(jsval_native_map_t *ma
 	return (jsval_native_map_entry_t *)(map + 1);
 }
 
+/*
+ * Sets and maps with at least JSVAL_COLLECTION_INDEX_MIN_CAP slots
+ * (tune with -D, 0 disables) index their keys under SameValueZero.
+ */
+static size_t jsval_collection_index_cap(size_t cap)
+{
+	return jsval_hash_index_cap(cap, JSVAL_COLLECTION_INDEX_MIN_CAP);
+}
+
+static size_t jsval_native_set_bytes(size_t cap)
+{
+	return sizeof(jsval_native_set_t) + cap * sizeof(jsval_cell_t)
+			+ jsval_collection_index_cap(cap) * 2 * sizeof(uint32_t);
+}
+
+static uint32_t *jsval_native_set_index(jsval_native_set_t *set)
+{
+	if (jsval_collection_index_cap(set->cap) == 0) {
+		return NULL;
+	}
+	return (uint32_t *)(jsval_native_set_values(set) + set->cap);
+}
+
+static size_t jsval_native_map_bytes(size_t cap)
+{
+	return sizeof(jsval_native_map_t) + cap * sizeof(jsval_native_map_entry_t)
+			+ jsval_collection_index_cap(cap) * 2 * sizeof(uint32_t);
+}
+
+static uint32_t *jsval_native_map_index(jsval_native_map_t *map)
+{
+	if (jsval_collection_index_cap(map->cap) == 0) {
+		return NULL;
+	}
+	return (uint32_t *)(jsval_native_map_entries(map) + map->cap);
+}
+
 static jsval_native_iterator_t *jsval_native_iterator(jsval_region_t *region,
 		jsval_t value)
 {
@@ -2886,6 +3318,371 @@ static jsval_native_named_group_t *jsval_native_regexp_named_groups(
 			regexp->named_groups_off);
 }
 
+static uint32_t jsval_key_hash_step(uint32_t hash, uint32_t codepoint)
+{
+	hash ^= codepoint;
+	hash *= 16777619u;
+	return hash;
+}
+
+/*
+ * Property key hashes for the native object index. Strings hash by
+ * code point, with invalid UTF-8 and lone surrogates read as U+FFFD as
+ * the comparisons do, so a UTF-16, JSSTR8 or JSON key hashes the same
+ * as an equal key in any other representation. Symbols all share one
+ * hash, which keeps region offsets out of the index so it survives
+ * compaction and region images unchanged.
+ */
+static uint32_t jsval_key_hash_utf8(const uint8_t *key, size_t key_len)
+{
+	const uint8_t *cursor = key;
+	const uint8_t *stop = key + key_len;
+	uint32_t hash = 2166136261u;
+
+	while (cursor < stop) {
+		uint32_t codepoint = 0;
+		int seq_len = 0;
+
+		UTF8_CHAR(cursor, stop, &codepoint, &seq_len);
+		if (seq_len == 0) {
+			break;
+		}
+		if (seq_len < 0) {
+			seq_len = -seq_len;
+			codepoint = 0xFFFD;
+		}
+		hash = jsval_key_hash_step(hash, codepoint);
+		cursor += seq_len;
+	}
+	return hash;
+}
+
+static uint32_t jsval_key_hash_utf16(const uint16_t *key, size_t key_len)
+{
+	const uint16_t *cursor = key;
+	const uint16_t *stop = key + key_len;
+	uint32_t hash = 2166136261u;
+
+	while (cursor < stop) {
+		uint32_t codepoint = 0;
+		int seq_len = 0;
+
+		UTF16_CHAR(cursor, stop, &codepoint, &seq_len);
+		if (seq_len == 0) {
+			break;
+		}
+		if (seq_len < 0) {
+			seq_len = -seq_len;
+			codepoint = 0xFFFD;
+		}
+		hash = jsval_key_hash_step(hash, codepoint);
+		cursor += seq_len;
+	}
+	return hash;
+}
+
+static int jsval_key_hash(jsval_region_t *region, jsval_t key,
+		uint32_t *hash_ptr)
+{
+	if (key.kind == JSVAL_KIND_SYMBOL) {
+		*hash_ptr = 0x9e3779b9u;
+		return 0;
+	}
+	if (key.kind == JSVAL_KIND_STRING_JSSTR8) {
+		jsval_native_string_jsstr8_t *s8 = jsval_native_string_jsstr8(region, key);
+
+		if (s8 == NULL) {
+			errno = EINVAL;
+			return -1;
+		}
+		*hash_ptr = jsval_key_hash_utf8(
+				jsval_native_string_jsstr8_bytes_inline(s8), s8->len);
+		return 0;
+	}
+	if (key.kind == JSVAL_KIND_STRING && key.repr == JSVAL_REPR_NATIVE) {
+		jsval_native_string_t *string = jsval_native_string(region, key);
+
+		if (string == NULL) {
+			errno = EINVAL;
+			return -1;
+		}
+		*hash_ptr = jsval_key_hash_utf16(jsval_native_string_units(string),
+				string->len);
+		return 0;
+	}
+
+	{
+		size_t len = 0;
+
+		if (jsval_string_copy_utf8(region, key, NULL, 0, &len) < 0) {
+			return -1;
+		}
+		{
+			uint8_t buf[len ? len : 1];
+
+			if (len > 0 && jsval_string_copy_utf8(region, key, buf, len,
+					NULL) < 0) {
+				return -1;
+			}
+			*hash_ptr = jsval_key_hash_utf8(buf, len);
+		}
+	}
+	return 0;
+}
+
+/*
+ * Region atom table: the interned JSSTR8 property names. Header
+ * {mask, count, previous table}, then (mask + 1) pairs {hash, string
+ * offset}, offset 0 meaning empty. It doubles into a fresh allocation
+ * at half load; the old one stays as it was, so a release that
+ * reclaims the new table falls back to it. Interning only saves copies
+ * and compares: lookups still compare contents when offsets differ,
+ * so forgetting an atom, or the whole table, is always safe.
+ */
+static uint32_t *jsval_atom_table(jsval_region_t *region)
+{
+	if (region->atoms_off == 0) {
+		return NULL;
+	}
+	return (uint32_t *)(region->base + region->atoms_off);
+}
+
+static size_t jsval_atom_table_bytes(size_t cap)
+{
+	return (JSVAL_ATOM_TABLE_HEAD + cap * 2) * sizeof(uint32_t);
+}
+
+static void jsval_atom_table_put(uint32_t *table, uint32_t hash,
+		jsval_off_t off)
+{
+	uint32_t *slots = table + JSVAL_ATOM_TABLE_HEAD;
+	uint32_t slot;
+
+	for (slot = hash & table[0]; slots[slot * 2 + 1] != 0;
+			slot = (slot + 1) & table[0]) {
+	}
+	slots[slot * 2] = hash;
+	slots[slot * 2 + 1] = off;
+}
+
+static int jsval_atom_find(jsval_region_t *region, const uint8_t *key,
+		size_t key_len, uint32_t hash, jsval_off_t *off_ptr)
+{
+	uint32_t *table = jsval_atom_table(region);
+	uint32_t *slots;
+	uint32_t slot;
+
+	if (table == NULL) {
+		return 0;
+	}
+	slots = table + JSVAL_ATOM_TABLE_HEAD;
+	for (slot = hash & table[0]; slots[slot * 2 + 1] != 0;
+			slot = (slot + 1) & table[0]) {
+		jsval_native_string_jsstr8_t *s8;
+
+		if (slots[slot * 2] != hash) {
+			continue;
+		}
+		s8 = (jsval_native_string_jsstr8_t *)(region->base
+				+ slots[slot * 2 + 1]);
+		if (s8->len == key_len && (key_len == 0 || memcmp(
+				jsval_native_string_jsstr8_bytes_inline(s8), key,
+				key_len) == 0)) {
+			*off_ptr = slots[slot * 2 + 1];
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int jsval_atom_table_grow(jsval_region_t *region)
+{
+	uint32_t *old = jsval_atom_table(region);
+	uint32_t *table;
+	jsval_off_t off;
+	size_t cap = old != NULL ? ((size_t)old[0] + 1) * 2
+			: JSVAL_ATOM_TABLE_MIN_CAP;
+	uint32_t i;
+
+	if (cap > UINT32_MAX / 4) {
+		errno = ENOMEM;
+		return -1;
+	}
+	if (jsval_region_reserve(region, jsval_atom_table_bytes(cap), JSVAL_ALIGN,
+			&off, (void **)&table) < 0) {
+		return -1;
+	}
+	memset(table, 0, jsval_atom_table_bytes(cap));
+	table[0] = (uint32_t)(cap - 1);
+	if (old != NULL) {
+		const uint32_t *slots = old + JSVAL_ATOM_TABLE_HEAD;
+
+		for (i = 0; i <= old[0]; i++) {
+			if (slots[i * 2 + 1] != 0) {
+				jsval_atom_table_put(table, slots[i * 2], slots[i * 2 + 1]);
+			}
+		}
+		table[1] = old[1];
+		table[2] = region->atoms_off;
+	}
+	region->atoms_off = off;
+	return 0;
+}
+
+/* The canonical JSSTR8 string for `key`, created on first use. */
+static int jsval_atom_intern(jsval_region_t *region, const uint8_t *key,
+		size_t key_len, uint32_t hash, jsval_t *atom_ptr)
+{
+	uint32_t *table;
+	jsval_off_t off;
+
+	if (jsval_atom_find(region, key, key_len, hash, &off)) {
+		*atom_ptr = jsval_undefined();
+		atom_ptr->kind = JSVAL_KIND_STRING_JSSTR8;
+		atom_ptr->repr = JSVAL_REPR_NATIVE;
+		atom_ptr->off = off;
+		return 0;
+	}
+	table = jsval_atom_table(region);
+	if ((table == NULL || ((size_t)table[1] + 1) * 2 > (size_t)table[0] + 1)
+			&& jsval_atom_table_grow(region) < 0) {
+		return -1;
+	}
+	if (jsval_string_jsstr8_new_bytes(region, key, key_len, atom_ptr) < 0) {
+		return -1;
+	}
+	table = jsval_atom_table(region);
+	jsval_atom_table_put(table, hash, atom_ptr->off);
+	table[1]++;
+	return 0;
+}
+
+/* Forget atoms at or above `used` (about to be reclaimed). */
+static void jsval_region_atoms_trim(jsval_region_t *region, size_t used)
+{
+	uint32_t *table = jsval_atom_table(region);
+	uint32_t *slots;
+	uint32_t start;
+	uint32_t i;
+
+	while (table != NULL && region->atoms_off >= used) {
+		region->atoms_off = table[2];
+		table = jsval_atom_table(region);
+	}
+	if (table == NULL) {
+		return;
+	}
+	slots = table + JSVAL_ATOM_TABLE_HEAD;
+	for (i = 0; i <= table[0]; i++) {
+		if (slots[i * 2 + 1] >= used) {
+			slots[i * 2 + 1] = 0;
+			table[1]--;
+		}
+	}
+	/* Re-seat the survivors so no probe run crosses a new hole. Starting
+	 * past an empty slot walks every run from its head, so a moved atom
+	 * only ever vacates a slot no earlier atom's run covers. */
+	for (start = 0; slots[start * 2 + 1] != 0; start++) {
+	}
+	for (i = 1; i <= table[0]; i++) {
+		uint32_t slot = (start + i) & table[0];
+		jsval_off_t off = slots[slot * 2 + 1];
+
+		if (off != 0) {
+			slots[slot * 2 + 1] = 0;
+			jsval_atom_table_put(table, slots[slot * 2], off);
+		}
+	}
+}
+
+/* Index the prop just stored at `prop_index`. */
+static int jsval_native_object_index_add(jsval_region_t *region,
+		jsval_native_object_t *native, size_t prop_index)
+{
+	uint32_t *index = jsval_native_object_index(native);
+	uint32_t hash;
+
+	if (index == NULL) {
+		return 0;
+	}
+	if (jsval_key_hash(region, jsval_cell_unpack(region,
+			jsval_native_object_props(native)[prop_index].name), &hash) < 0) {
+		return -1;
+	}
+	jsval_hash_index_put(index, jsval_native_object_index_cap(native->cap),
+			hash, prop_index);
+	return 0;
+}
+
+/* Deletes shift the props down, so re-index them all. */
+static int jsval_native_object_index_rebuild(jsval_region_t *region,
+		jsval_native_object_t *native)
+{
+	uint32_t *index = jsval_native_object_index(native);
+	size_t i;
+
+	if (index == NULL) {
+		return 0;
+	}
+	memset(index, 0, jsval_native_object_index_cap(native->cap) * 2
+			* sizeof(uint32_t));
+	for (i = 0; i < native->len; i++) {
+		if (jsval_native_object_index_add(region, native, i) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Move a shaped object to dictionary mode with room for `extra` more
+ * props (and as many again as it has, so later adds do not run out
+ * straight away). Returns the dictionary node; dictionaries are
+ * returned as is.
+ */
+static jsval_native_object_t *jsval_native_object_unshape(jsval_region_t *region,
+		jsval_t object, size_t extra)
+{
+	jsval_native_object_t *native = jsval_native_object(region, object);
+	jsval_native_object_t *shape;
+	jsval_native_object_t *dict_native;
+	jsval_native_prop_t *props;
+	jsval_t dict;
+	size_t i;
+
+	if (native == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if (native->shape_off == 0) {
+		return native;
+	}
+	/* Forwarding an older object into the scope would dangle on release. */
+	if (object.off < region->mark_floor) {
+		errno = EBUSY;
+		return NULL;
+	}
+	if (jsval_object_new(region, native->len * 2 + extra, &dict) < 0) {
+		return NULL;
+	}
+	shape = jsval_native_object_shape(region, native);
+	dict_native = (jsval_native_object_t *)jsval_region_ptr(region, dict.off);
+	props = jsval_native_object_props(dict_native);
+	for (i = 0; i < native->len; i++) {
+		props[i].name = jsval_native_object_props(shape)[i].name;
+		props[i].value = jsval_native_object_slots(native)[i];
+		if (jsval_native_object_index_add(region, dict_native, i) < 0) {
+			return NULL;
+		}
+	}
+	dict_native->len = native->len;
+	native->len = 0;
+	native->cap = 0;
+	native->shape_off = 0;
+	native->forward_off = dict.off;
+	return dict_native;
+}
+
 static int jsval_object_append_native_prop(jsval_region_t *region, jsval_t object,
 		jsval_t name, jsval_t value)
 {
@@ -2897,13 +3694,19 @@ static int jsval_object_append_native_prop(jsval_region_t *region, jsval_t objec
 		errno = EINVAL;
 		return -1;
 	}
+	if ((native = jsval_native_object_unshape(region, object, 1)) == NULL) {
+		return -1;
+	}
 	if (native->len >= native->cap) {
 		errno = ENOBUFS;
 		return -1;
 	}
 	props = jsval_native_object_props(native);
-	props[native->len].name = name;
-	props[native->len].value = value;
+	props[native->len].name = jsval_cell_pack(name);
+	props[native->len].value = jsval_cell_pack(value);
+	if (jsval_native_object_index_add(region, native, native->len) < 0) {
+		return -1;
+	}
 	native->len++;
 	return 0;
 }
@@ -2977,6 +3780,9 @@ static jsval_json_doc_t *jsval_json_doc(jsval_region_t *region, jsval_t value)
 
 static const uint8_t *jsval_json_doc_bytes(jsval_region_t *region, jsval_json_doc_t *doc)
 {
+	if (doc->borrowed != NULL) {
+		return doc->borrowed;
+	}
 	return (const uint8_t *)jsval_region_ptr(region, doc->json_off);
 }
 
@@ -2985,6 +3791,14 @@ static jsmntok_t *jsval_json_doc_tokens(jsval_region_t *region, jsval_json_doc_t
 	return (jsmntok_t *)jsval_region_ptr(region, doc->tokens_off);
 }
 
+static const uint32_t *jsval_json_doc_skip(jsval_region_t *region, jsval_json_doc_t *doc)
+{
+	if (doc->skip_off == 0) {
+		return NULL;
+	}
+	return (const uint32_t *)jsval_region_ptr(region, doc->skip_off);
+}
+
 static size_t jsval_utf16_units_for_codepoint(uint32_t codepoint)
 {
 	if (codepoint < 0x10000) {
@@ -3262,7 +4076,97 @@ static jsval_t jsval_json_value(jsval_region_t *region, jsval_t value, uint32_t
 	return out;
 }
 
-static int jsval_json_next(jsval_region_t *region, jsval_json_doc_t *doc, int index)
+#if JSMX_WITH_NAN_BOXING
+/*
+ * An 8-byte cell holds a number as its double, with every NaN stored
+ * as the positive quiet NaN. That frees the negative NaNs (sign and
+ * exponent bits all set, payload nonzero) to carry everything else:
+ *
+ *   JSON:   1 | doc off >> JSVAL_CELL_JSON_SHIFT | token index
+ *   other:  0 | 1 | kind:8 | repr:2 | off (native) or boolean:32
+ *
+ * A JSON cell drops the kind and reads it back from the token. Docs
+ * are JSVAL_ALIGN aligned, which leaves room for
+ * JSVAL_CELL_JSON_TOKENS_MAX tokens; jsval_json_doc_complete refuses
+ * larger documents.
+ */
+#define JSVAL_CELL_BOXED 0xfff0000000000000ull
+#define JSVAL_CELL_NAN 0x7ff8000000000000ull
+#define JSVAL_CELL_JSON (1ull << 51)
+#define JSVAL_CELL_TAG (1ull << 50)
+#define JSVAL_CELL_JSON_SHIFT (JSVAL_ALIGN >= 8 ? 3 : 2)
+#define JSVAL_CELL_JSON_INDEX_BITS (19 + JSVAL_CELL_JSON_SHIFT)
+#define JSVAL_CELL_JSON_TOKENS_MAX (1u << JSVAL_CELL_JSON_INDEX_BITS)
+#endif
+
+static jsval_cell_t jsval_cell_pack(jsval_t value)
+{
+#if JSMX_WITH_NAN_BOXING
+	uint64_t bits;
+
+	if (value.repr == JSVAL_REPR_INLINE && value.kind == JSVAL_KIND_NUMBER) {
+		if (value.as.number != value.as.number) {
+			return JSVAL_CELL_NAN;
+		}
+		memcpy(&bits, &value.as.number, sizeof(bits));
+		return bits;
+	}
+	if (value.repr == JSVAL_REPR_JSON) {
+		return JSVAL_CELL_BOXED | JSVAL_CELL_JSON
+				| ((uint64_t)(value.off >> JSVAL_CELL_JSON_SHIFT)
+					<< JSVAL_CELL_JSON_INDEX_BITS)
+				| value.as.index;
+	}
+	bits = JSVAL_CELL_BOXED | JSVAL_CELL_TAG | ((uint64_t)value.kind << 40)
+			| ((uint64_t)(value.repr & 3u) << 32);
+	return bits | (value.repr == JSVAL_REPR_INLINE
+			? (uint32_t)value.as.boolean : value.off);
+#else
+	return value;
+#endif
+}
+
+static jsval_t jsval_cell_unpack(jsval_region_t *region, jsval_cell_t cell)
+{
+#if JSMX_WITH_NAN_BOXING
+	jsval_t value = jsval_undefined();
+
+	if ((cell & JSVAL_CELL_BOXED) != JSVAL_CELL_BOXED
+			|| (cell & ~JSVAL_CELL_BOXED) == 0) {
+		double number;
+
+		memcpy(&number, &cell, sizeof(number));
+		return jsval_number(number);
+	}
+	if (cell & JSVAL_CELL_JSON) {
+		jsval_json_doc_t *doc;
+
+		value.repr = JSVAL_REPR_JSON;
+		value.off = (jsval_off_t)(((cell & ~(JSVAL_CELL_BOXED
+				| JSVAL_CELL_JSON)) >> JSVAL_CELL_JSON_INDEX_BITS)
+				<< JSVAL_CELL_JSON_SHIFT);
+		value.as.index = (uint32_t)(cell & (JSVAL_CELL_JSON_TOKENS_MAX - 1));
+		doc = jsval_json_doc(region, value);
+		if (doc != NULL) {
+			value.kind = jsval_json_token_kind(region, doc, value.as.index);
+		}
+		return value;
+	}
+	value.kind = (uint8_t)(cell >> 40);
+	value.repr = (uint8_t)((cell >> 32) & 3u);
+	if (value.repr == JSVAL_REPR_INLINE) {
+		value.as.boolean = (int)(uint32_t)cell;
+	} else {
+		value.off = (jsval_off_t)cell;
+	}
+	return value;
+#else
+	(void)region;
+	return cell;
+#endif
+}
+
+static int jsval_json_next_walk(jsval_region_t *region, jsval_json_doc_t *doc, int index)
 {
 	int next;
 	unsigned int i;
@@ -3279,7 +4183,7 @@ static int jsval_json_next(jsval_region_t *region, jsval_json_doc_t *doc, int in
 		return next;
 	case JSMN_ARRAY:
 		for (i = 0; i < (unsigned int)tokens[index].size; i++) {
-			next = jsval_json_next(region, doc, next);
+			next = jsval_json_next_walk(region, doc, next);
 			if (next < 0) {
 				return -1;
 			}
@@ -3287,11 +4191,11 @@ static int jsval_json_next(jsval_region_t *region, jsval_json_doc_t *doc, int in
 		return next;
 	case JSMN_OBJECT:
 		for (i = 0; i < (unsigned int)tokens[index].size; i++) {
-			next = jsval_json_next(region, doc, next);
+			next = jsval_json_next_walk(region, doc, next);
 			if (next < 0) {
 				return -1;
 			}
-			next = jsval_json_next(region, doc, next);
+			next = jsval_json_next_walk(region, doc, next);
 			if (next < 0) {
 				return -1;
 			}
@@ -3302,6 +4206,154 @@ static int jsval_json_next(jsval_region_t *region, jsval_json_doc_t *doc, int in
 	}
 }
 
+static int jsval_json_next(jsval_region_t *region, jsval_json_doc_t *doc, int index)
+{
+	const uint32_t *skip;
+
+	if (index < 0 || (unsigned int)index >= doc->tokused) {
+		return -1;
+	}
+
+	skip = jsval_json_doc_skip(region, doc);
+	if (skip == NULL) {
+		return jsval_json_next_walk(region, doc, index);
+	}
+	if (skip[index] == 0) {
+		return -1;
+	}
+	return (int)skip[index];
+}
+
+/*
+ * Fill `skip` with the subtree end of every token. Children always sit
+ * after their parent, so one reverse pass sees each child's entry
+ * before its container needs it; every token is stepped over exactly
+ * once by its parent, making the whole build O(tokused). Produces the
+ * same answers (including -1 for truncated subtrees) as
+ * jsval_json_next_walk.
+ */
+static void jsval_json_build_skip(const jsmntok_t *tokens, unsigned int tokused,
+		uint32_t *skip)
+{
+	unsigned int i = tokused;
+
+	while (i-- > 0) {
+		uint32_t next = (uint32_t)i + 1;
+		unsigned int steps;
+		unsigned int j;
+
+		switch (tokens[i].type) {
+		case JSMN_STRING:
+		case JSMN_PRIMITIVE:
+			skip[i] = next;
+			continue;
+		case JSMN_ARRAY:
+			steps = (unsigned int)tokens[i].size;
+			break;
+		case JSMN_OBJECT:
+			steps = (unsigned int)tokens[i].size * 2u;
+			break;
+		default:
+			skip[i] = 0;
+			continue;
+		}
+
+		for (j = 0; j < steps; j++) {
+			if (next >= tokused || skip[next] == 0) {
+				next = 0;
+				break;
+			}
+			next = skip[next];
+		}
+		skip[i] = next;
+	}
+}
+
+static jsval_off_t *jsval_json_doc_index_slots(jsval_region_t *region,
+		jsval_json_doc_t *doc, int create)
+{
+	jsval_off_t *slots;
+	jsval_off_t off;
+
+	if (doc->index_off != 0) {
+		return (jsval_off_t *)jsval_region_ptr(region, doc->index_off);
+	}
+	if (!create || doc->tokused == 0) {
+		return NULL;
+	}
+	/* Caching on a doc older than an active mark would dangle on release. */
+	if ((size_t)((uint8_t *)doc - region->base) < region->mark_floor) {
+		return NULL;
+	}
+	JSVAL_ALLOC_TAG(region, JSVAL_ALLOC_CLASS_JSON_INDEX);
+	if (jsval_region_reserve(region, doc->tokused * sizeof(jsval_off_t),
+			sizeof(jsval_off_t), &off, (void **)&slots) < 0) {
+		return NULL;
+	}
+	memset(slots, 0, doc->tokused * sizeof(jsval_off_t));
+	doc->index_off = off;
+	return slots;
+}
+
+/*
+ * Element-offset table for a JSON-backed array: entry i is the token
+ * index of element i. Built on the first indexed read of an array with
+ * at least JSVAL_JSON_INDEX_MIN_LEN elements, once the doc has opted in
+ * with jsval_json_index_arrays, and cached in the doc's index slots, so
+ * indexed loops over parsed arrays are O(1) per read. Returns NULL
+ * (leaving errno untouched) for short arrays, docs that have not opted
+ * in, or when the region has no room, in which case callers walk
+ * siblings instead.
+ */
+static const uint32_t *jsval_json_array_elements(jsval_region_t *region,
+		jsval_json_doc_t *doc, uint32_t array_index)
+{
+	jsmntok_t *tokens = jsval_json_doc_tokens(region, doc);
+	jsval_off_t *slots;
+	jsval_off_t off;
+	uint32_t *elements;
+	size_t len;
+	size_t i;
+	int cursor;
+	int saved_errno;
+
+	if (array_index >= doc->tokused || tokens[array_index].type != JSMN_ARRAY) {
+		return NULL;
+	}
+	len = (size_t)tokens[array_index].size;
+	if (len < JSVAL_JSON_INDEX_MIN_LEN) {
+		return NULL;
+	}
+
+	slots = jsval_json_doc_index_slots(region, doc, 0);
+	if (slots != NULL && slots[array_index] != 0) {
+		return (const uint32_t *)jsval_region_ptr(region, slots[array_index]);
+	}
+	if (!doc->index_arrays) {
+		return NULL;
+	}
+
+	saved_errno = errno;
+	slots = jsval_json_doc_index_slots(region, doc, 1);
+	JSVAL_ALLOC_TAG(region, JSVAL_ALLOC_CLASS_JSON_INDEX);
+	if (slots == NULL || jsval_region_reserve(region, len * sizeof(uint32_t),
+			sizeof(uint32_t), &off, (void **)&elements) < 0) {
+		errno = saved_errno;
+		return NULL;
+	}
+	cursor = (int)array_index + 1;
+	for (i = 0; i < len; i++) {
+		if (cursor < 0) {
+			errno = saved_errno;
+			return NULL;
+		}
+		elements[i] = (uint32_t)cursor;
+		cursor = jsval_json_next(region, doc, cursor);
+	}
+	slots[array_index] = off;
+	return elements;
+}
+
 static int jsval_json_bool_value(jsval_region_t *region, jsval_json_doc_t *doc, uint32_t index, int *boolean_ptr)
 {
 	const uint8_t *start;
@@ -3502,6 +4554,21 @@ static int jsval_json_string_copy_utf8_internal(jsval_region_t *region, jsval_js
 static int jsval_json_string_eq_utf8(jsval_region_t *region, jsval_json_doc_t *doc, uint32_t index, const uint8_t *key, size_t key_len)
 {
 	size_t len;
+	jsmntok_t *token;
+
+	if (doc == NULL || index >= doc->tokused) {
+		return 0;
+	}
+	token = &jsval_json_doc_tokens(region, doc)[index];
+	if (token->type == JSMN_STRING && !token->escaped) {
+		/* No backslash in the span: the source bytes (UTF-8, as JSON
+		 * requires) are already the decoded key. */
+		if ((size_t)(token->end - token->start) != key_len) {
+			return 0;
+		}
+		return key_len == 0 || memcmp(jsval_json_doc_bytes(region, doc)
+				+ token->start, key, key_len) == 0;
+	}
 
 	if (jsval_json_string_copy_utf8_internal(region, doc, index, NULL, 0, &len) < 0) {
 		return 0;
@@ -3519,12 +4586,234 @@ static int jsval_json_string_eq_utf8(jsval_region_t *region, jsval_json_doc_t *d
 	}
 }
 
+static uint32_t jsval_json_key_hash(const uint8_t *key, size_t key_len)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < key_len; i++) {
+		hash ^= key[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static int jsval_json_string_hash(jsval_region_t *region, jsval_json_doc_t *doc,
+		uint32_t index, uint32_t *hash_ptr)
+{
+	jsmntok_t *token = &jsval_json_doc_tokens(region, doc)[index];
+	size_t len;
+
+	if (token->type != JSMN_STRING) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (!token->escaped) {
+		*hash_ptr = jsval_json_key_hash(jsval_json_doc_bytes(region, doc)
+				+ token->start, (size_t)(token->end - token->start));
+		return 0;
+	}
+	if (jsval_json_string_copy_utf8_internal(region, doc, index, NULL, 0,
+			&len) < 0) {
+		return -1;
+	}
+	{
+		uint8_t buf[len ? len : 1];
+
+		if (jsval_json_string_copy_utf8_internal(region, doc, index, buf,
+				len, NULL) < 0) {
+			return -1;
+		}
+		*hash_ptr = jsval_json_key_hash(buf, len);
+	}
+	return 0;
+}
+
+/*
+ * Open-addressed key index for a JSON-backed object: a uint32_t mask
+ * followed by (mask + 1) {hash, key token} pairs, key token 0 marking
+ * an empty slot (a key can never be token 0). Keys are inserted in
+ * source order with linear probing, so the first of several duplicate
+ * keys is still the one found, matching the sequential scan. Built on
+ * the first lookup into an object with at least
+ * JSVAL_JSON_OBJECT_INDEX_MIN_LEN keys, once the doc has opted in with
+ * jsval_json_index_objects, and cached in the doc's index slots.
+ * Returns NULL (leaving errno untouched) for narrow objects, docs that
+ * have not opted in, or when the region has no room, in which case
+ * callers scan the keys.
+ */
+static const uint32_t *jsval_json_object_index(jsval_region_t *region,
+		jsval_json_doc_t *doc, uint32_t object_index)
+{
+	jsmntok_t *tokens = jsval_json_doc_tokens(region, doc);
+	jsval_off_t *slots;
+	jsval_off_t off;
+	uint32_t *table;
+	uint32_t *entries;
+	uint32_t mask;
+	size_t len;
+	size_t cap;
+	size_t i;
+	int cursor;
+	int saved_errno;
+
+	if (object_index >= doc->tokused || tokens[object_index].type != JSMN_OBJECT) {
+		return NULL;
+	}
+	len = (size_t)tokens[object_index].size;
+	if (len < JSVAL_JSON_OBJECT_INDEX_MIN_LEN) {
+		return NULL;
+	}
+
+	slots = jsval_json_doc_index_slots(region, doc, 0);
+	if (slots != NULL && slots[object_index] != 0) {
+		return (const uint32_t *)jsval_region_ptr(region, slots[object_index]);
+	}
+	if (!doc->index_objects) {
+		return NULL;
+	}
+
+	cap = 1;
+	while (cap < len * 2) {
+		cap <<= 1;
+	}
+	mask = (uint32_t)(cap - 1);
+	saved_errno = errno;
+	slots = jsval_json_doc_index_slots(region, doc, 1);
+	JSVAL_ALLOC_TAG(region, JSVAL_ALLOC_CLASS_JSON_INDEX);
+	if (slots == NULL || jsval_region_reserve(region,
+			(1 + cap * 2) * sizeof(uint32_t), sizeof(uint32_t), &off,
+			(void **)&table) < 0) {
+		errno = saved_errno;
+		return NULL;
+	}
+	table[0] = mask;
+	entries = table + 1;
+	memset(entries, 0, cap * 2 * sizeof(uint32_t));
+
+	cursor = (int)object_index + 1;
+	for (i = 0; i < len; i++) {
+		uint32_t hash;
+		uint32_t slot;
+		int value_index;
+
+		if (cursor < 0 || (value_index = jsval_json_next(region, doc, cursor)) < 0
+				|| jsval_json_string_hash(region, doc, (uint32_t)cursor,
+					&hash) < 0) {
+			errno = saved_errno;
+			return NULL;
+		}
+		slot = hash & mask;
+		while (entries[slot * 2 + 1] != 0) {
+			slot = (slot + 1) & mask;
+		}
+		entries[slot * 2] = hash;
+		entries[slot * 2 + 1] = (uint32_t)cursor;
+		cursor = jsval_json_next(region, doc, value_index);
+	}
+	slots[object_index] = off;
+	return table;
+}
+
+/*
+ * Find the value token for `key` in the JSON-backed object at
+ * `object_index`. Returns 1 and sets *value_index_ptr when found, 0
+ * otherwise.
+ */
+static int jsval_json_object_find_utf8(jsval_region_t *region,
+		jsval_json_doc_t *doc, uint32_t object_index, const uint8_t *key,
+		size_t key_len, uint32_t *value_index_ptr)
+{
+	jsmntok_t *tokens = jsval_json_doc_tokens(region, doc);
+	const uint32_t *table;
+	int cursor;
+	unsigned int i;
+
+	table = jsval_json_object_index(region, doc, object_index);
+	if (table != NULL) {
+		const uint32_t *entries = table + 1;
+		uint32_t mask = table[0];
+		uint32_t hash = jsval_json_key_hash(key, key_len);
+		uint32_t slot = hash & mask;
+
+		while (entries[slot * 2 + 1] != 0) {
+			uint32_t key_index = entries[slot * 2 + 1];
+
+			if (entries[slot * 2] == hash
+					&& jsval_json_string_eq_utf8(region, doc, key_index, key,
+						key_len)) {
+				/* Keys are strings, so the value token follows directly. */
+				*value_index_ptr = key_index + 1;
+				return 1;
+			}
+			slot = (slot + 1) & mask;
+		}
+		return 0;
+	}
+
+	cursor = (int)object_index + 1;
+	for (i = 0; i < (unsigned int)tokens[object_index].size; i++) {
+		int key_index = cursor;
+		int value_index = jsval_json_next(region, doc, key_index);
+
+		if (value_index < 0) {
+			break;
+		}
+		if (jsval_json_string_eq_utf8(region, doc, key_index, key, key_len)) {
+			*value_index_ptr = (uint32_t)value_index;
+			return 1;
+		}
+		cursor = jsval_json_next(region, doc, value_index);
+		if (cursor < 0) {
+			break;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Chunked mode: bytes before `skip` went out with earlier chunks and
+ * are only counted; the rest fill `buf` until it holds `cap` bytes,
+ * at which point the walk unwinds with ENOBUFS and `full` set.
+ */
+static int jsval_json_emit_append_chunked(jsval_json_emit_state_t *state,
+		const uint8_t *src, size_t len)
+{
+	size_t off = 0;
+	size_t room = state->cap - state->fill;
+
+	if (state->len < state->skip) {
+		off = state->skip - state->len;
+		if (off >= len) {
+			state->len += len;
+			return 0;
+		}
+	}
+	if (len - off > room) {
+		memcpy(state->buf + state->fill, src + off, room);
+		state->fill += room;
+		state->len += off + room;
+		state->full = 1;
+		state->resume_depth = 0;
+		state->leaf_pending = 0;
+		errno = ENOBUFS;
+		return -1;
+	}
+	memcpy(state->buf + state->fill, src + off, len - off);
+	state->fill += len - off;
+	state->len += len;
+	return 0;
+}
+
 static int jsval_json_emit_append(jsval_json_emit_state_t *state, const uint8_t *src, size_t len)
 {
 	if (SIZE_MAX - state->len < len) {
 		errno = EOVERFLOW;
 		return -1;
 	}
+	if (state->chunked) {
+		return jsval_json_emit_append_chunked(state, src, len);
+	}
 	if (state->buf != NULL) {
 		if (state->len + len > state->cap) {
 			errno = ENOBUFS;
@@ -3595,6 +4884,102 @@ static void jsval_json_emit_pop(jsval_json_emit_state_t *state, jsval_t value)
 	}
 }
 
+/*
+ * Called right after pushing a native container: on the first pass
+ * after a chunk filled, the container on the suspended path picks up
+ * at the recorded child and output offset instead of starting over.
+ */
+static int jsval_json_emit_resume(jsval_json_emit_state_t *state,
+		size_t *index_ptr, size_t *emitted_ptr)
+{
+	size_t d = state->depth - 1;
+	const jsval_json_emit_frame_t *frame;
+
+	if (!state->chunked || state->resume_next != d
+			|| d >= state->resume_depth) {
+		return 0;
+	}
+	frame = &state->resume[d];
+	state->resume_next++;
+	state->len = frame->len;
+	*index_ptr = frame->index;
+	if (emitted_ptr != NULL) {
+		*emitted_ptr = frame->emitted;
+	}
+	return 1;
+}
+
+/* Record where the innermost open container stood when a chunk filled. */
+static void jsval_json_emit_suspend(jsval_json_emit_state_t *state,
+		size_t index, size_t len, size_t emitted)
+{
+	size_t d;
+
+	if (!state->full || state->depth == 0) {
+		return;
+	}
+	d = state->depth - 1;
+	state->resume[d].index = index;
+	state->resume[d].len = len;
+	state->resume[d].emitted = emitted;
+	if (state->resume_depth < d + 1) {
+		state->resume_depth = d + 1;
+	}
+}
+
+/*
+ * Leaves can be far longer than a chunk. The one that starts at output
+ * offset `at` and was cut off by the previous chunk jumps to the source
+ * position recorded for it; bytes up to the new skip are only counted.
+ */
+static int jsval_json_emit_leaf_resume(jsval_json_emit_state_t *state,
+		size_t at, size_t *pos_ptr, uint8_t *in_string_ptr)
+{
+	if (!state->chunked || !state->leaf_pending || state->leaf_at != at) {
+		return 0;
+	}
+	state->leaf_pending = 0;
+	state->len = state->leaf_len;
+	*pos_ptr = state->leaf_pos;
+	if (in_string_ptr != NULL) {
+		*in_string_ptr = state->leaf_in_string;
+	}
+	return 1;
+}
+
+/* Record where the leaf at `at` stood when a chunk filled. */
+static void jsval_json_emit_leaf_suspend(jsval_json_emit_state_t *state,
+		size_t at, size_t pos, size_t len, uint8_t in_string)
+{
+	if (!state->full) {
+		return;
+	}
+	state->leaf_pending = 1;
+	state->leaf_in_string = in_string;
+	state->leaf_at = at;
+	state->leaf_pos = pos;
+	state->leaf_len = len;
+}
+
+/*
+ * Append the verbatim run [run, cursor) of a scanned leaf. In chunked
+ * mode runs are flushed at most a chunk long, so resuming at the start
+ * of the run that overflowed rescans no more than a chunk.
+ */
+static int jsval_json_emit_leaf_run(jsval_json_emit_state_t *state,
+		size_t at, const uint8_t *base, const uint8_t *run,
+		const uint8_t *cursor, uint8_t in_string)
+{
+	size_t len = state->len;
+
+	if (jsval_json_emit_append(state, run, (size_t)(cursor - run)) < 0) {
+		jsval_json_emit_leaf_suspend(state, at, (size_t)(run - base), len,
+				in_string);
+		return -1;
+	}
+	return 0;
+}
+
 static int jsval_json_emit_value(jsval_region_t *region, jsval_t value, jsval_json_emit_state_t *state);
 static int jsval_stringify_value_to_native(jsval_region_t *region, jsval_t value,
 		int require_object_coercible, jsval_t *string_value_ptr,
@@ -3603,20 +4988,27 @@ static int jsval_stringify_value_to_native(jsval_region_t *region, jsval_t value
 static int jsval_json_emit_jsstr8_string(jsval_region_t *region, jsval_t value, jsval_json_emit_state_t *state)
 {
 	jsval_native_string_jsstr8_t *string = jsval_native_string_jsstr8(region, value);
+	const uint8_t *base;
 	const uint8_t *cursor;
 	const uint8_t *stop;
 	const uint8_t *run;
+	size_t at = state->len;
+	size_t pos = 0;
+	size_t len;
 
 	if (string == NULL) {
 		errno = EINVAL;
 		return -1;
 	}
-	if (jsval_json_emit_byte(state, '"') < 0) {
+
+	base = (string->len > 0) ? jsval_native_string_jsstr8_bytes_inline(string) : NULL;
+	cursor = base;
+	stop = base + string->len;
+	if (jsval_json_emit_leaf_resume(state, at, &pos, NULL)) {
+		cursor += pos;
+	} else if (jsval_json_emit_byte(state, '"') < 0) {
 		return -1;
 	}
-
-	cursor = (string->len > 0) ? jsval_native_string_jsstr8_bytes_inline(string) : NULL;
-	stop = cursor + string->len;
 	run = cursor;
 	while (cursor < stop) {
 		uint8_t b = *cursor;
@@ -3624,6 +5016,13 @@ static int jsval_json_emit_jsstr8_string(jsval_region_t *region, jsval_t value,
 		uint8_t u_escape[6];
 		size_t u_len = 0;
 
+		if (state->chunked && (size_t)(cursor - run) >= state->cap) {
+			if (jsval_json_emit_leaf_run(state, at, base, run, cursor, 0) < 0) {
+				return -1;
+			}
+			run = cursor;
+		}
+
 		if (b == '"') {
 			escape = "\\\"";
 		} else if (b == '\\') {
@@ -3650,16 +5049,18 @@ static int jsval_json_emit_jsstr8_string(jsval_region_t *region, jsval_t value,
 		}
 
 		if (escape != NULL || u_len > 0) {
-			if (cursor > run && jsval_json_emit_append(state, run, (size_t)(cursor - run)) < 0) {
+			if (cursor > run && jsval_json_emit_leaf_run(state, at, base,
+					run, cursor, 0) < 0) {
 				return -1;
 			}
+			len = state->len;
 			if (escape != NULL) {
 				if (jsval_json_emit_ascii(state, escape) < 0) {
-					return -1;
+					goto suspend;
 				}
 			} else {
 				if (jsval_json_emit_append(state, u_escape, u_len) < 0) {
-					return -1;
+					goto suspend;
 				}
 			}
 			cursor++;
@@ -3668,33 +5069,50 @@ static int jsval_json_emit_jsstr8_string(jsval_region_t *region, jsval_t value,
 			cursor++;
 		}
 	}
-	if (cursor > run && jsval_json_emit_append(state, run, (size_t)(cursor - run)) < 0) {
+	if (cursor > run && jsval_json_emit_leaf_run(state, at, base, run,
+			cursor, 0) < 0) {
 		return -1;
 	}
 
-	return jsval_json_emit_byte(state, '"');
+	len = state->len;
+	if (jsval_json_emit_byte(state, '"') < 0) {
+		goto suspend;
+	}
+	return 0;
+suspend:
+	jsval_json_emit_leaf_suspend(state, at, (size_t)(cursor - base), len, 0);
+	return -1;
 }
 
 static int jsval_json_emit_native_string(jsval_region_t *region, jsval_t value, jsval_json_emit_state_t *state)
 {
 	jsval_native_string_t *string = jsval_native_string(region, value);
+	const uint16_t *base;
 	const uint16_t *cursor;
 	const uint16_t *stop;
+	size_t at = state->len;
+	size_t pos = 0;
+	size_t len;
 
 	if (string == NULL) {
 		errno = EINVAL;
 		return -1;
 	}
-	if (jsval_json_emit_byte(state, '"') < 0) {
+
+	base = jsval_native_string_units(string);
+	cursor = base;
+	stop = base + string->len;
+	if (jsval_json_emit_leaf_resume(state, at, &pos, NULL)) {
+		cursor += pos;
+	} else if (jsval_json_emit_byte(state, '"') < 0) {
 		return -1;
 	}
-
-	cursor = jsval_native_string_units(string);
-	stop = cursor + string->len;
 	while (cursor < stop) {
 		uint32_t codepoint = 0;
 		int seq_len = 0;
 
+		len = state->len;
+
 		UTF16_CHAR(cursor, stop, &codepoint, &seq_len);
 		if (seq_len == 0) {
 			break;
@@ -3707,43 +5125,43 @@ static int jsval_json_emit_native_string(jsval_region_t *region, jsval_t value,
 		switch (codepoint) {
 		case '"':
 			if (jsval_json_emit_ascii(state, "\\\"") < 0) {
-				return -1;
+				goto suspend;
 			}
 			break;
 		case '\\':
 			if (jsval_json_emit_ascii(state, "\\\\") < 0) {
-				return -1;
+				goto suspend;
 			}
 			break;
 		case '\b':
 			if (jsval_json_emit_ascii(state, "\\b") < 0) {
-				return -1;
+				goto suspend;
 			}
 			break;
 		case '\f':
 			if (jsval_json_emit_ascii(state, "\\f") < 0) {
-				return -1;
+				goto suspend;
 			}
 			break;
 		case '\n':
 			if (jsval_json_emit_ascii(state, "\\n") < 0) {
-				return -1;
+				goto suspend;
 			}
 			break;
 		case '\r':
 			if (jsval_json_emit_ascii(state, "\\r") < 0) {
-				return -1;
+				goto suspend;
 			}
 			break;
 		case '\t':
 			if (jsval_json_emit_ascii(state, "\\t") < 0) {
-				return -1;
+				goto suspend;
 			}
 			break;
 		default:
 			if (codepoint < 0x20) {
 				if (jsval_json_emit_u16_escape(state, (uint16_t)codepoint) < 0) {
-					return -1;
+					goto suspend;
 				}
 			} else {
 				uint8_t utf8[4];
@@ -3752,7 +5170,7 @@ static int jsval_json_emit_native_string(jsval_region_t *region, jsval_t value,
 
 				UTF8_ENCODE(&read, read + 1, &write, utf8 + sizeof(utf8));
 				if (jsval_json_emit_append(state, utf8, (size_t)(write - utf8)) < 0) {
-					return -1;
+					goto suspend;
 				}
 			}
 			break;
@@ -3761,7 +5179,107 @@ static int jsval_json_emit_native_string(jsval_region_t *region, jsval_t value,
 		cursor += seq_len;
 	}
 
-	return jsval_json_emit_byte(state, '"');
+	len = state->len;
+	if (jsval_json_emit_byte(state, '"') < 0) {
+		goto suspend;
+	}
+	return 0;
+suspend:
+	jsval_json_emit_leaf_suspend(state, at, (size_t)(cursor - base), len, 0);
+	return -1;
+}
+
+/*
+ * Whether the root span is exactly its tokens plus the brackets, commas
+ * and colons between them, i.e. carries no insignificant whitespace.
+ * Works from token sizes alone, without reading the source bytes.
+ */
+static int jsval_json_tokens_compact(const jsmntok_t *tokens,
+		unsigned int tokused)
+{
+	size_t span;
+	size_t covered = 0;
+	int root_end;
+	unsigned int i;
+
+	if (tokused == 0) {
+		return 1;
+	}
+	root_end = tokens[0].end;
+	span = (size_t)(tokens[0].end - tokens[0].start);
+	for (i = 0; i < tokused && tokens[i].start < root_end; i++) {
+		const jsmntok_t *token = &tokens[i];
+
+		switch (token->type) {
+		case JSMN_STRING:
+			covered += (size_t)(token->end - token->start) + 2;
+			break;
+		case JSMN_PRIMITIVE:
+			covered += (size_t)(token->end - token->start);
+			break;
+		case JSMN_OBJECT:
+			covered += (size_t)token->size;
+			/* fall through */
+		case JSMN_ARRAY:
+			covered += 2 + (token->size > 0 ? (size_t)token->size - 1 : 0);
+			break;
+		default:
+			return 0;
+		}
+	}
+	if (tokens[0].type == JSMN_STRING) {
+		span += 2;
+	}
+	return covered == span;
+}
+
+/* Copy a container span, dropping whitespace outside string literals. */
+static int jsval_json_emit_minified(jsval_json_emit_state_t *state,
+		const uint8_t *start, const uint8_t *stop)
+{
+	const uint8_t *run = start;
+	const uint8_t *cursor = start;
+	size_t at = state->len;
+	size_t pos = 0;
+	uint8_t in_string = 0;
+	uint8_t run_in_string = 0;
+
+	if (jsval_json_emit_leaf_resume(state, at, &pos, &in_string)) {
+		cursor += pos;
+		run = cursor;
+		run_in_string = in_string;
+	}
+	while (cursor < stop) {
+		uint8_t c = *cursor;
+
+		if (state->chunked && (size_t)(cursor - run) >= state->cap) {
+			if (jsval_json_emit_leaf_run(state, at, start, run, cursor,
+					run_in_string) < 0) {
+				return -1;
+			}
+			run = cursor;
+			run_in_string = in_string;
+		}
+		if (in_string) {
+			if (c == '\\') {
+				cursor++;
+			} else if (c == '"') {
+				in_string = 0;
+			}
+		} else if (c == '"') {
+			in_string = 1;
+		} else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+			if (jsval_json_emit_leaf_run(state, at, start, run, cursor,
+					run_in_string) < 0) {
+				return -1;
+			}
+			run = cursor + 1;
+			run_in_string = 0;
+		}
+		cursor++;
+	}
+	return jsval_json_emit_leaf_run(state, at, start, run, stop,
+			run_in_string);
 }
 
 static int jsval_json_emit_json_value(jsval_region_t *region, jsval_t value, jsval_json_emit_state_t *state)
@@ -3787,7 +5305,12 @@ static int jsval_json_emit_json_value(jsval_region_t *region, jsval_t value, jsv
 		}
 		return jsval_json_emit_byte(state, '"');
 	}
+	if (!doc->compact && (value.kind == JSVAL_KIND_OBJECT
+			|| value.kind == JSVAL_KIND_ARRAY)) {
+		return jsval_json_emit_minified(state, start, stop);
+	}
 
+	/* Unmodified subtree: its source span is already the output. */
 	return jsval_json_emit_append(state, start, (size_t)(stop - start));
 }
 
@@ -3823,7 +5346,9 @@ static int jsval_json_emit_value(jsval_region_t *region, jsval_t value, jsval_js
 	case JSVAL_KIND_ARRAY:
 	{
 		jsval_native_array_t *array = jsval_native_array(region, value);
-		jsval_t *values;
+		jsval_cell_t *values;
+		size_t start = 0;
+		size_t at;
 
 		if (array == NULL) {
 			errno = EINVAL;
@@ -3832,31 +5357,41 @@ static int jsval_json_emit_value(jsval_region_t *region, jsval_t value, jsval_js
 		if (jsval_json_emit_push(state, value) < 0) {
 			return -1;
 		}
-		if (jsval_json_emit_byte(state, '[') < 0) {
+		if (!jsval_json_emit_resume(state, &start, NULL)
+				&& jsval_json_emit_byte(state, '[') < 0) {
 			jsval_json_emit_pop(state, value);
 			return -1;
 		}
 
 		values = jsval_native_array_values(array);
-		for (i = 0; i < array->len; i++) {
+		for (i = start; i < array->len; i++) {
+			at = state->len;
 			if (i > 0 && jsval_json_emit_byte(state, ',') < 0) {
-				jsval_json_emit_pop(state, value);
-				return -1;
+				goto array_suspend;
 			}
-			if (jsval_json_emit_value(region, values[i], state) < 0) {
-				jsval_json_emit_pop(state, value);
-				return -1;
+			if (jsval_json_emit_value(region,
+					jsval_cell_unpack(region, values[i]), state) < 0) {
+				goto array_suspend;
 			}
 		}
+		at = state->len;
+		if (jsval_json_emit_byte(state, ']') < 0) {
+			goto array_suspend;
+		}
 
 		jsval_json_emit_pop(state, value);
-		return jsval_json_emit_byte(state, ']');
+		return 0;
+array_suspend:
+		jsval_json_emit_suspend(state, i, at, 0);
+		jsval_json_emit_pop(state, value);
+		return -1;
 	}
 	case JSVAL_KIND_OBJECT:
 	{
 		jsval_native_object_t *object = jsval_native_object(region, value);
-		jsval_native_prop_t *props;
-		int emitted = 0;
+		size_t emitted = 0;
+		size_t start = 0;
+		size_t at;
 
 		if (object == NULL) {
 			errno = EINVAL;
@@ -3865,14 +5400,14 @@ static int jsval_json_emit_value(jsval_region_t *region, jsval_t value, jsval_js
 		if (jsval_json_emit_push(state, value) < 0) {
 			return -1;
 		}
-		if (jsval_json_emit_byte(state, '{') < 0) {
+		if (!jsval_json_emit_resume(state, &start, &emitted)
+				&& jsval_json_emit_byte(state, '{') < 0) {
 			jsval_json_emit_pop(state, value);
 			return -1;
 		}
 
-		props = jsval_native_object_props(object);
-		for (i = 0; i < object->len; i++) {
-			jsval_t name = props[i].name;
+		for (i = start; i < object->len; i++) {
+			jsval_t name = jsval_native_object_name_at(region, object, i);
 
 			if (name.kind == JSVAL_KIND_SYMBOL) {
 				continue;
@@ -3882,32 +5417,37 @@ static int jsval_json_emit_value(jsval_region_t *region, jsval_t value, jsval_js
 				errno = EINVAL;
 				return -1;
 			}
+			at = state->len;
 			if (emitted > 0 && jsval_json_emit_byte(state, ',') < 0) {
-				jsval_json_emit_pop(state, value);
-				return -1;
+				goto object_suspend;
 			}
 			if (name.kind == JSVAL_KIND_STRING_JSSTR8) {
 				if (jsval_json_emit_jsstr8_string(region, name, state) < 0) {
-					jsval_json_emit_pop(state, value);
-					return -1;
+					goto object_suspend;
 				}
 			} else if (jsval_json_emit_native_string(region, name, state) < 0) {
-				jsval_json_emit_pop(state, value);
-				return -1;
+				goto object_suspend;
 			}
 			if (jsval_json_emit_byte(state, ':') < 0) {
-				jsval_json_emit_pop(state, value);
-				return -1;
+				goto object_suspend;
 			}
-			if (jsval_json_emit_value(region, props[i].value, state) < 0) {
-				jsval_json_emit_pop(state, value);
-				return -1;
+			if (jsval_json_emit_value(region, jsval_cell_unpack(region,
+					*jsval_native_object_value_at(object, i)), state) < 0) {
+				goto object_suspend;
 			}
 			emitted++;
 		}
+		at = state->len;
+		if (jsval_json_emit_byte(state, '}') < 0) {
+			goto object_suspend;
+		}
 
 		jsval_json_emit_pop(state, value);
-		return jsval_json_emit_byte(state, '}');
+		return 0;
+object_suspend:
+		jsval_json_emit_suspend(state, i, at, emitted);
+		jsval_json_emit_pop(state, value);
+		return -1;
 	}
 	case JSVAL_KIND_REGEXP:
 	case JSVAL_KIND_MATCH_ITERATOR:
@@ -3991,6 +5531,7 @@ static int jsval_string_reserve_utf16(jsval_region_t *region, size_t cap,
 	}
 
 	bytes_len = sizeof(*string) + units_cap * sizeof(uint16_t);
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_STRING);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&string) < 0) {
 		return -1;
@@ -6548,6 +8089,7 @@ void jsval_region_init(jsval_region_t *region, void *buf, size_t len)
 	region->microtask_count = 0;
 	region->microtask_draining = 0;
 	region->fetch_waitlist_enabled = 0;
+	region->readonly = 0;
 	memset(region->reserved, 0, sizeof(region->reserved));
 	memset(&region->scheduler, 0, sizeof(region->scheduler));
 	region->fetch_transport = NULL;
@@ -6556,6 +8098,13 @@ void jsval_region_init(jsval_region_t *region, void *buf, size_t len)
 	region->fetch_waitlist_tail = 0;
 	region->fetch_waitlist_count = 0;
 	region->promise_combinator_head = 0;
+	region->mark_floor = 0;
+	region->grow = NULL;
+	region->grow_ctx = NULL;
+	memset(region->node_free, 0, sizeof(region->node_free));
+	region->alloc_tag = JSVAL_ALLOC_CLASS_OTHER;
+	region->stats = NULL;
+	region->atoms_off = 0;
 
 	if (buf == NULL || len < head_size || len > UINT32_MAX) {
 		return;
@@ -6584,6 +8133,7 @@ void jsval_region_rebase(jsval_region_t *region, void *buf, size_t len)
 	region->microtask_count = 0;
 	region->microtask_draining = 0;
 	region->fetch_waitlist_enabled = 0;
+	region->readonly = 0;
 	memset(region->reserved, 0, sizeof(region->reserved));
 	memset(&region->scheduler, 0, sizeof(region->scheduler));
 	region->fetch_transport = NULL;
@@ -6592,6 +8142,13 @@ void jsval_region_rebase(jsval_region_t *region, void *buf, size_t len)
 	region->fetch_waitlist_tail = 0;
 	region->fetch_waitlist_count = 0;
 	region->promise_combinator_head = 0;
+	region->mark_floor = 0;
+	region->grow = NULL;
+	region->grow_ctx = NULL;
+	memset(region->node_free, 0, sizeof(region->node_free));
+	region->alloc_tag = JSVAL_ALLOC_CLASS_OTHER;
+	region->stats = NULL;
+	region->atoms_off = 0;
 
 	if (buf == NULL || len < sizeof(jsval_pages_t)) {
 		return;
@@ -6625,6 +8182,39 @@ void jsval_region_set_scheduler(jsval_region_t *region,
 	region->scheduler = *scheduler;
 }
 
+void jsval_region_set_grow(jsval_region_t *region, jsval_region_grow_fn grow,
+		void *ctx)
+{
+	if (region == NULL) {
+		return;
+	}
+	region->grow = grow;
+	region->grow_ctx = grow ? ctx : NULL;
+}
+
+int jsval_region_set_stats(jsval_region_t *region,
+		jsval_region_stats_t *stats)
+{
+#if JSMX_WITH_ALLOC_STATS
+	if (!jsval_region_valid(region)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (stats != NULL) {
+		memset(stats, 0, sizeof(*stats));
+		stats->high_water = region->pages->used_len;
+	}
+	region->stats = stats;
+	region->alloc_tag = JSVAL_ALLOC_CLASS_OTHER;
+	return 0;
+#else
+	(void)region;
+	(void)stats;
+	errno = ENOTSUP;
+	return -1;
+#endif
+}
+
 void jsval_region_set_fetch_transport(jsval_region_t *region,
 		const jsval_fetch_transport_t *transport, void *userdata)
 {
@@ -6755,6 +8345,10 @@ int jsval_region_set_root(jsval_region_t *region, jsval_t value)
 		errno = EINVAL;
 		return -1;
 	}
+	if (region->readonly) {
+		errno = EROFS;
+		return -1;
+	}
 
 	region->pages->root = value;
 	return 0;
@@ -6806,6 +8400,7 @@ int jsval_string_new_utf8(jsval_region_t *region, const uint8_t *str, size_t len
 
 	utf16_len = jsval_utf8_utf16len(str, len);
 	bytes_len = sizeof(*string) + utf16_len * sizeof(uint16_t);
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_STRING);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off, (void **)&string) < 0) {
 		return -1;
 	}
@@ -6857,6 +8452,7 @@ int jsval_string_jsstr8_new_bytes(jsval_region_t *region,
 		return -1;
 	}
 	total = sizeof(*string) + len;
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_STRING_JSSTR8);
 	if (jsval_region_reserve(region, total, JSVAL_ALIGN, &off,
 			(void **)&string) < 0) {
 		return -1;
@@ -6937,6 +8533,7 @@ int jsval_symbol_new(jsval_region_t *region, int have_description,
 			return -1;
 		}
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_SYMBOL);
 	if (jsval_region_reserve(region, sizeof(*symbol), JSVAL_ALIGN, &off,
 			(void **)&symbol) < 0) {
 		return -1;
@@ -6990,6 +8587,7 @@ int jsval_function_new(jsval_region_t *region, jsval_native_function_fn fn,
 			return -1;
 		}
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_FUNCTION);
 	if (jsval_region_reserve(region, sizeof(*native), JSVAL_ALIGN, &off,
 			(void **)&native) < 0) {
 		return -1;
@@ -7452,6 +9050,7 @@ jsval_date_alloc(jsval_region_t *region, double time_ms, jsval_t *value_ptr)
 	if (jsval_date_time_clip(time_ms, &clipped) < 0) {
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_DATE);
 	if (jsval_region_reserve(region, sizeof(*native), JSVAL_ALIGN, &off,
 			(void **)&native) < 0) {
 		return -1;
@@ -8582,6 +10181,7 @@ jsval_array_buffer_new(jsval_region_t *region, size_t byte_length,
 		return -1;
 	}
 	total_len = sizeof(*buffer) + byte_length;
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_ARRAY_BUFFER);
 	if (jsval_region_reserve(region, total_len, JSVAL_ALIGN, &off,
 			(void **)&buffer) < 0) {
 		return -1;
@@ -8688,6 +10288,7 @@ jsval_typed_array_new(jsval_region_t *region, jsval_typed_array_kind_t kind,
 	if (jsval_array_buffer_new(region, byte_length, &buffer) < 0) {
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_TYPED_ARRAY);
 	if (jsval_region_alloc(region, sizeof(*typed_array),
 			_Alignof(jsval_native_typed_array_t), &ptr) < 0) {
 		return -1;
@@ -8954,6 +10555,7 @@ jsval_dom_exception_new(jsval_region_t *region, jsval_t name_value,
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_DOM_EXCEPTION);
 	if (jsval_region_alloc(region, sizeof(*native),
 			_Alignof(jsval_native_dom_exception_t), &ptr) < 0) {
 		return -1;
@@ -9091,6 +10693,7 @@ jsval_subtle_crypto_new(jsval_region_t *region, jsval_t *value_ptr)
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_SUBTLE_CRYPTO);
 	if (jsval_region_alloc(region, sizeof(*native),
 			_Alignof(jsval_native_subtle_crypto_t), &ptr) < 0) {
 		return -1;
@@ -9112,6 +10715,7 @@ jsval_crypto_new(jsval_region_t *region, jsval_t *value_ptr)
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_CRYPTO);
 	if (jsval_region_alloc(region, sizeof(*native),
 			_Alignof(jsval_native_crypto_t), &ptr) < 0) {
 		return -1;
@@ -10456,6 +12060,7 @@ jsval_crypto_key_new_internal(jsval_region_t *region,
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_CRYPTO_KEY);
 	if (jsval_region_alloc(region, sizeof(*native),
 			_Alignof(jsval_native_crypto_key_t), &ptr) < 0) {
 		return -1;
@@ -10463,6 +12068,7 @@ jsval_crypto_key_new_internal(jsval_region_t *region,
 	native = (jsval_native_crypto_key_t *)ptr;
 	memset(native, 0, sizeof(*native));
 	if (key_byte_length > 0) {
+		JSVAL_ALLOC_TAG(region, JSVAL_KIND_CRYPTO_KEY);
 		if (jsval_region_alloc(region, key_byte_length, 1, &bytes_ptr) < 0) {
 			return -1;
 		}
@@ -11158,6 +12764,7 @@ jsval_subtle_crypto_new_aes_gcm_task(jsval_region_t *region,
 		return -1;
 	}
 	bytes_len = sizeof(*task) + data_len + iv_len + aad_len;
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_SUBTLE_AES_GCM);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&task) < 0) {
 		return -1;
@@ -11204,6 +12811,7 @@ jsval_subtle_crypto_new_aes_ctr_task(jsval_region_t *region,
 		return -1;
 	}
 	bytes_len = sizeof(*task) + data_len + counter_len;
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_SUBTLE_AES_CTR);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&task) < 0) {
 		return -1;
@@ -11248,6 +12856,7 @@ jsval_subtle_crypto_new_aes_cbc_task(jsval_region_t *region,
 		return -1;
 	}
 	bytes_len = sizeof(*task) + data_len + iv_len;
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_SUBTLE_AES_CBC);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&task) < 0) {
 		return -1;
@@ -11290,6 +12899,7 @@ jsval_subtle_crypto_new_aes_kw_task(jsval_region_t *region,
 		return -1;
 	}
 	bytes_len = sizeof(*task) + data_len;
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_SUBTLE_AES_KW);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&task) < 0) {
 		return -1;
@@ -11334,6 +12944,7 @@ jsval_subtle_crypto_new_ecdsa_task(jsval_region_t *region,
 		return -1;
 	}
 	bytes_len = sizeof(*task) + data_len + signature_len;
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_SUBTLE_ECDSA);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&task) < 0) {
 		return -1;
@@ -11381,6 +12992,7 @@ jsval_subtle_crypto_new_rsassa_pkcs1_v1_5_task(jsval_region_t *region,
 		return -1;
 	}
 	bytes_len = sizeof(*task) + data_len + signature_len;
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_SUBTLE_RSASSA_PKCS1_V1_5);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&task) < 0) {
 		return -1;
@@ -11429,6 +13041,7 @@ jsval_subtle_crypto_new_rsa_pss_task(jsval_region_t *region,
 		return -1;
 	}
 	bytes_len = sizeof(*task) + data_len + signature_len;
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_SUBTLE_RSA_PSS);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&task) < 0) {
 		return -1;
@@ -11476,6 +13089,7 @@ jsval_subtle_crypto_new_ed25519_task(jsval_region_t *region,
 		return -1;
 	}
 	bytes_len = sizeof(*task) + data_len + signature_len;
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_SUBTLE_ED25519);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&task) < 0) {
 		return -1;
@@ -11521,6 +13135,7 @@ jsval_subtle_crypto_new_pbkdf2_task(jsval_region_t *region,
 		return -1;
 	}
 	bytes_len = sizeof(*task) + data_len;
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_SUBTLE_PBKDF2);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&task) < 0) {
 		return -1;
@@ -11570,6 +13185,7 @@ jsval_subtle_crypto_new_hkdf_task(jsval_region_t *region,
 		return -1;
 	}
 	bytes_len = sizeof(*task) + data_len + extra_len;
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_SUBTLE_HKDF);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&task) < 0) {
 		return -1;
@@ -13522,6 +15138,7 @@ jsval_subtle_crypto_new_hmac_task(jsval_region_t *region,
 		return -1;
 	}
 	bytes_len = sizeof(*task) + data_len + extra_len;
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_SUBTLE_HMAC);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&task) < 0) {
 		return -1;
@@ -16121,6 +17738,7 @@ jsval_subtle_crypto_enqueue_digest(jsval_region_t *region,
 		return -1;
 	}
 	bytes_len = sizeof(*task) + input_len;
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_SUBTLE_DIGEST);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&task) < 0) {
 		return -1;
@@ -20315,7 +21933,8 @@ int jsval_microtask_enqueue(jsval_region_t *region, jsval_t function,
 		return -1;
 	}
 	bytes_len = sizeof(*task) + argc * sizeof(*argv);
-	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_FUNCTION_CALL);
+	if (jsval_region_node_alloc(region, bytes_len, &off,
 			(void **)&task) < 0) {
 		return -1;
 	}
@@ -20397,7 +22016,8 @@ static int jsval_promise_enqueue_reaction(jsval_region_t *region,
 		errno = EINVAL;
 		return -1;
 	}
-	if (jsval_region_reserve(region, sizeof(*task), JSVAL_ALIGN, &off,
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_PROMISE_REACTION);
+	if (jsval_region_node_alloc(region, sizeof(*task), &off,
 			(void **)&task) < 0) {
 		return -1;
 	}
@@ -20473,7 +22093,14 @@ static int jsval_promise_settle(jsval_region_t *region, jsval_t promise_value,
 		}
 	}
 
-	return jsval_promise_schedule_reactions(region, promise_value);
+	if (jsval_promise_schedule_reactions(region, promise_value) < 0) {
+		return -1;
+	}
+	/* Each queued reaction task now owns its reaction node. */
+	promise = jsval_native_promise(region, promise_value);
+	promise->reactions_head = 0;
+	promise->reactions_tail = 0;
+	return 0;
 }
 
 static int jsval_promise_reject_from_error(jsval_region_t *region,
@@ -20512,7 +22139,8 @@ static int jsval_promise_reaction_add(jsval_region_t *region,
 		errno = EINVAL;
 		return -1;
 	}
-	if (jsval_region_reserve(region, sizeof(*reaction), JSVAL_ALIGN, &off,
+	JSVAL_ALLOC_TAG(region, JSVAL_ALLOC_CLASS_PROMISE_REACTION);
+	if (jsval_region_node_alloc(region, sizeof(*reaction), &off,
 			(void **)&reaction) < 0) {
 		return -1;
 	}
@@ -20523,6 +22151,10 @@ static int jsval_promise_reaction_add(jsval_region_t *region,
 	reaction->passthrough = passthrough;
 	reaction->mode = (uint8_t)mode;
 	reaction->passthrough_state = (uint8_t)passthrough_state;
+	promise = jsval_native_promise(region, source_promise);
+	if ((jsval_promise_state_t)promise->state != JSVAL_PROMISE_STATE_PENDING) {
+		return jsval_promise_enqueue_reaction(region, source_promise, off);
+	}
 	if (promise->reactions_tail == 0) {
 		promise->reactions_head = off;
 		promise->reactions_tail = off;
@@ -20537,9 +22169,6 @@ static int jsval_promise_reaction_add(jsval_region_t *region,
 		tail->next_off = off;
 		promise->reactions_tail = off;
 	}
-	if ((jsval_promise_state_t)promise->state != JSVAL_PROMISE_STATE_PENDING) {
-		return jsval_promise_enqueue_reaction(region, source_promise, off);
-	}
 	return 0;
 }
 
@@ -21005,6 +22634,8 @@ int jsval_microtask_drain(jsval_region_t *region, jsmethod_error_t *error)
 				region->microtask_draining = 0;
 				return -1;
 			}
+			jsval_region_node_free(region, off, sizeof(*call_task)
+					+ call_task->argc * sizeof(jsval_t));
 			break;
 		}
 		case JSVAL_MICROTASK_KIND_PROMISE_REACTION:
@@ -21013,12 +22644,16 @@ int jsval_microtask_drain(jsval_region_t *region, jsmethod_error_t *error)
 				(jsval_native_microtask_promise_reaction_t *)task;
 			jsval_t promise_value =
 				jsval_promise_value(reaction_task->promise_off);
+			jsval_off_t reaction_off = reaction_task->reaction_off;
 
 			if (jsval_promise_run_reaction(region, promise_value,
-					reaction_task->reaction_off) < 0) {
+					reaction_off) < 0) {
 				region->microtask_draining = 0;
 				return -1;
 			}
+			jsval_region_node_free(region, reaction_off,
+					sizeof(jsval_native_promise_reaction_t));
+			jsval_region_node_free(region, off, sizeof(*reaction_task));
 			break;
 		}
 		case JSVAL_MICROTASK_KIND_SUBTLE_DIGEST:
@@ -21185,6 +22820,7 @@ int jsval_microtask_drain(jsval_region_t *region, jsmethod_error_t *error)
 				region->microtask_draining = 0;
 				return -1;
 			}
+			jsval_region_node_free(region, off, sizeof(*pump_task));
 			break;
 		}
 		case JSVAL_MICROTASK_KIND_WRITABLE_STREAM_PUMP:
@@ -21196,6 +22832,7 @@ int jsval_microtask_drain(jsval_region_t *region, jsmethod_error_t *error)
 				region->microtask_draining = 0;
 				return -1;
 			}
+			jsval_region_node_free(region, off, sizeof(*pump_task));
 			break;
 		}
 		case JSVAL_MICROTASK_KIND_STREAM_PIPE_PUMP:
@@ -21257,6 +22894,7 @@ int jsval_promise_new(jsval_region_t *region, jsval_t *value_ptr)
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_PROMISE);
 	if (jsval_region_alloc(region, sizeof(*native),
 			_Alignof(jsval_native_promise_t), &ptr) < 0) {
 		return -1;
@@ -21976,19 +23614,28 @@ int jsval_object_new(jsval_region_t *region, size_t cap, jsval_t *value_ptr)
 {
 	jsval_native_object_t *object;
 	jsval_off_t off;
-	size_t bytes_len = sizeof(*object) + cap * sizeof(jsval_native_prop_t);
+	size_t bytes_len = jsval_native_object_bytes(cap);
+	uint32_t *index;
 	size_t i;
 
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_OBJECT);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off, (void **)&object) < 0) {
 		return -1;
 	}
 
 	object->len = 0;
 	object->cap = cap;
+	object->shape_off = 0;
+	object->forward_off = 0;
 	for (i = 0; i < cap; i++) {
 		jsval_native_prop_t *prop = &jsval_native_object_props(object)[i];
-		prop->name = jsval_undefined();
-		prop->value = jsval_undefined();
+		prop->name = jsval_cell_pack(jsval_undefined());
+		prop->value = jsval_cell_pack(jsval_undefined());
+	}
+	index = jsval_native_object_index(object);
+	if (index != NULL) {
+		memset(index, 0, jsval_native_object_index_cap(cap) * 2
+				* sizeof(uint32_t));
 	}
 
 	*value_ptr = jsval_undefined();
@@ -21998,13 +23645,164 @@ int jsval_object_new(jsval_region_t *region, size_t cap, jsval_t *value_ptr)
 	return 0;
 }
 
+/* The shape's dictionary node: keys are its props, in slot order. */
+static jsval_native_object_t *jsval_native_shape(jsval_region_t *region,
+		jsval_shape_t shape)
+{
+	jsval_native_object_t *native;
+
+	if (shape.off == 0) {
+		return NULL;
+	}
+	native = (jsval_native_object_t *)jsval_region_ptr(region, shape.off);
+	if (native == NULL || native->shape_off != 0 || native->forward_off != 0) {
+		return NULL;
+	}
+	return native;
+}
+
+int jsval_shape_new_utf8(jsval_region_t *region, const uint8_t *const *keys,
+		const size_t *key_lens, size_t len, jsval_shape_t *shape_ptr)
+{
+	jsval_t shape;
+	size_t i;
+
+	if (region == NULL || shape_ptr == NULL
+			|| (len > 0 && (keys == NULL || key_lens == NULL))) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (jsval_object_new(region, len, &shape) < 0) {
+		return -1;
+	}
+	for (i = 0; i < len; i++) {
+		int has;
+
+		if (jsval_object_has_own_utf8(region, shape, keys[i], key_lens[i],
+				&has) < 0) {
+			return -1;
+		}
+		if (has) {
+			errno = EINVAL;
+			return -1;
+		}
+		if (jsval_object_set_utf8(region, shape, keys[i], key_lens[i],
+				jsval_number((double)i)) < 0) {
+			return -1;
+		}
+	}
+	shape_ptr->off = shape.off;
+	return 0;
+}
+
+int jsval_object_new_shaped(jsval_region_t *region, jsval_shape_t shape,
+		jsval_t *value_ptr)
+{
+	jsval_native_object_t *shape_native = jsval_native_shape(region, shape);
+	jsval_native_object_t *object;
+	jsval_off_t off;
+	size_t len;
+	size_t i;
+
+	if (shape_native == NULL || value_ptr == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	len = shape_native->len;
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_OBJECT);
+	if (jsval_region_reserve(region, sizeof(*object) + len * sizeof(jsval_cell_t),
+			JSVAL_ALIGN, &off, (void **)&object) < 0) {
+		return -1;
+	}
+	object->len = len;
+	object->cap = len;
+	object->shape_off = shape.off;
+	object->forward_off = 0;
+	for (i = 0; i < len; i++) {
+		jsval_native_object_slots(object)[i] = jsval_cell_pack(jsval_undefined());
+	}
+
+	*value_ptr = jsval_undefined();
+	value_ptr->kind = JSVAL_KIND_OBJECT;
+	value_ptr->repr = JSVAL_REPR_NATIVE;
+	value_ptr->off = off;
+	return 0;
+}
+
+int jsval_object_get_slot(jsval_region_t *region, jsval_t object,
+		jsval_shape_t shape, size_t slot, jsval_t *value_ptr)
+{
+	jsval_native_object_t *shape_native;
+
+	if (value_ptr == NULL || object.kind != JSVAL_KIND_OBJECT) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (object.repr == JSVAL_REPR_NATIVE) {
+		jsval_native_object_t *native = jsval_native_object(region, object);
+
+		if (native == NULL) {
+			errno = EINVAL;
+			return -1;
+		}
+		if (shape.off != 0 && native->shape_off == shape.off
+				&& slot < native->len) {
+			*value_ptr = jsval_cell_unpack(region,
+					jsval_native_object_slots(native)[slot]);
+			return 0;
+		}
+	}
+
+	/* Dictionary mode, another shape, or a JSON object. */
+	shape_native = jsval_native_shape(region, shape);
+	if (shape_native == NULL || slot >= shape_native->len) {
+		errno = EINVAL;
+		return -1;
+	}
+	return jsval_object_get_key(region, object, jsval_cell_unpack(region,
+			jsval_native_object_props(shape_native)[slot].name), value_ptr);
+}
+
+int jsval_object_set_slot(jsval_region_t *region, jsval_t object,
+		jsval_shape_t shape, size_t slot, jsval_t value)
+{
+	jsval_native_object_t *shape_native;
+
+	if (object.kind != JSVAL_KIND_OBJECT) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (object.repr == JSVAL_REPR_NATIVE) {
+		jsval_native_object_t *native = jsval_native_object(region, object);
+
+		if (native == NULL) {
+			errno = EINVAL;
+			return -1;
+		}
+		if (shape.off != 0 && native->shape_off == shape.off
+				&& slot < native->len) {
+			jsval_native_object_slots(native)[slot] = jsval_cell_pack(value);
+			return 0;
+		}
+	}
+
+	shape_native = jsval_native_shape(region, shape);
+	if (shape_native == NULL || slot >= shape_native->len) {
+		errno = EINVAL;
+		return -1;
+	}
+	return jsval_object_set_key(region, object, jsval_cell_unpack(region,
+			jsval_native_object_props(shape_native)[slot].name), value);
+}
+
 int jsval_array_new(jsval_region_t *region, size_t cap, jsval_t *value_ptr)
 {
 	jsval_native_array_t *array;
 	jsval_off_t off;
-	size_t bytes_len = sizeof(*array) + cap * sizeof(jsval_t);
+	size_t bytes_len = sizeof(*array) + cap * sizeof(jsval_cell_t);
 	size_t i;
 
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_ARRAY);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off, (void **)&array) < 0) {
 		return -1;
 	}
@@ -22012,7 +23810,7 @@ int jsval_array_new(jsval_region_t *region, size_t cap, jsval_t *value_ptr)
 	array->len = 0;
 	array->cap = cap;
 	for (i = 0; i < cap; i++) {
-		jsval_native_array_values(array)[i] = jsval_undefined();
+		jsval_native_array_values(array)[i] = jsval_cell_pack(jsval_undefined());
 	}
 
 	*value_ptr = jsval_undefined();
@@ -22044,17 +23842,165 @@ static int jsval_same_value_zero(jsval_region_t *region, jsval_t left,
 	return jsval_strict_eq(region, left, right);
 }
 
+static uint32_t jsval_hash_mix(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x45d9f3bu;
+	h ^= h >> 16;
+	return h;
+}
+
+/*
+ * Hash consistent with jsval_same_value_zero: numbers by value (all
+ * NaNs alike, -0 as +0), strings by content, symbols and objects by
+ * identity. BigInts hash by kind alone and fall back to the compare.
+ */
+static int jsval_same_value_zero_hash(jsval_region_t *region, jsval_t value,
+		uint32_t *hash_ptr)
+{
+	uint32_t hash = value.kind;
+
+	switch (value.kind) {
+	case JSVAL_KIND_UNDEFINED:
+	case JSVAL_KIND_NULL:
+	case JSVAL_KIND_BIGINT:
+		break;
+	case JSVAL_KIND_BOOL:
+		hash ^= (uint32_t)jsval_truthy(region, value) << 8;
+		break;
+	case JSVAL_KIND_NUMBER:
+	{
+		double number;
+		uint64_t bits;
+
+		if (jsval_to_number(region, value, &number) < 0) {
+			return -1;
+		}
+		if (number != number) {
+			bits = 0x7ff8000000000000ull;
+		} else {
+			if (number == 0) {
+				number = 0;
+			}
+			memcpy(&bits, &number, sizeof(bits));
+		}
+		hash ^= (uint32_t)bits ^ (uint32_t)(bits >> 32);
+		break;
+	}
+	case JSVAL_KIND_STRING:
+	case JSVAL_KIND_STRING_JSSTR8:
+		if (jsval_key_hash(region, value, &hash) < 0) {
+			return -1;
+		}
+		hash ^= value.kind;
+		break;
+	default:
+		hash ^= value.repr << 8;
+		hash ^= value.off;
+		if (value.repr == JSVAL_REPR_JSON) {
+			hash ^= value.as.index * 0x9e3779b9u;
+		}
+		break;
+	}
+	*hash_ptr = jsval_hash_mix(hash);
+	return 0;
+}
+
+/*
+ * Look `key` up among `len` keys spaced `stride` cells apart, through
+ * `index` when the collection has one. Returns 1 with *entry_index_ptr
+ * set, 0 if absent, -1 on error; *hash_ptr receives the key's hash
+ * whenever there is an index.
+ */
+static int jsval_collection_find(jsval_region_t *region, const jsval_cell_t *keys,
+		size_t stride, size_t len, const uint32_t *index, size_t index_cap,
+		jsval_t key, size_t *entry_index_ptr, uint32_t *hash_ptr)
+{
+	size_t i;
+
+	if (index != NULL) {
+		uint32_t mask = (uint32_t)(index_cap - 1);
+		uint32_t hash;
+		uint32_t slot;
+
+		if (jsval_same_value_zero_hash(region, key, &hash) < 0) {
+			return -1;
+		}
+		*hash_ptr = hash;
+		for (slot = hash & mask; index[slot * 2 + 1] != 0;
+				slot = (slot + 1) & mask) {
+			i = index[slot * 2 + 1] - 1;
+			if (index[slot * 2] == hash
+					&& jsval_same_value_zero(region,
+						jsval_cell_unpack(region, keys[i * stride]), key)) {
+				*entry_index_ptr = i;
+				return 1;
+			}
+		}
+		return 0;
+	}
+	for (i = 0; i < len; i++) {
+		if (jsval_same_value_zero(region,
+				jsval_cell_unpack(region, keys[i * stride]), key)) {
+			*entry_index_ptr = i;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Re-index every key, e.g. after a clone or compaction. */
+static int jsval_collection_reindex(jsval_region_t *region,
+		const jsval_cell_t *keys, size_t stride, size_t len, uint32_t *index,
+		size_t index_cap)
+{
+	size_t i;
+
+	if (index == NULL) {
+		return 0;
+	}
+	memset(index, 0, index_cap * 2 * sizeof(uint32_t));
+	for (i = 0; i < len; i++) {
+		uint32_t hash;
+
+		if (jsval_same_value_zero_hash(region,
+				jsval_cell_unpack(region, keys[i * stride]), &hash) < 0) {
+			return -1;
+		}
+		jsval_hash_index_put(index, index_cap, hash, i);
+	}
+	return 0;
+}
+
+static int jsval_native_set_reindex(jsval_region_t *region,
+		jsval_native_set_t *set)
+{
+	return jsval_collection_reindex(region, jsval_native_set_values(set), 1,
+			set->len, jsval_native_set_index(set),
+			jsval_collection_index_cap(set->cap));
+}
+
+static int jsval_native_map_reindex(jsval_region_t *region,
+		jsval_native_map_t *map)
+{
+	return jsval_collection_reindex(region,
+			&jsval_native_map_entries(map)->key, 2, map->len,
+			jsval_native_map_index(map), jsval_collection_index_cap(map->cap));
+}
+
 int jsval_set_new(jsval_region_t *region, size_t cap, jsval_t *value_ptr)
 {
 	jsval_native_set_t *set;
 	jsval_off_t off;
-	size_t bytes_len = sizeof(*set) + cap * sizeof(jsval_t);
+	size_t bytes_len = jsval_native_set_bytes(cap);
+	uint32_t *index;
 	size_t i;
 
 	if (value_ptr == NULL) {
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_SET);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&set) < 0) {
 		return -1;
@@ -22063,7 +24009,12 @@ int jsval_set_new(jsval_region_t *region, size_t cap, jsval_t *value_ptr)
 	set->len = 0;
 	set->cap = cap;
 	for (i = 0; i < cap; i++) {
-		jsval_native_set_values(set)[i] = jsval_undefined();
+		jsval_native_set_values(set)[i] = jsval_cell_pack(jsval_undefined());
+	}
+	index = jsval_native_set_index(set);
+	if (index != NULL) {
+		memset(index, 0, jsval_collection_index_cap(cap) * 2
+				* sizeof(uint32_t));
 	}
 
 	*value_ptr = jsval_undefined();
@@ -22078,8 +24029,8 @@ int jsval_set_clone(jsval_region_t *region, jsval_t src, size_t capacity,
 {
 	jsval_native_set_t *native;
 	jsval_t out;
-	jsval_t *src_values;
-	jsval_t *dst_values;
+	jsval_cell_t *src_values;
+	jsval_cell_t *dst_values;
 	size_t i;
 
 	if (region == NULL || value_ptr == NULL || src.kind != JSVAL_KIND_SET) {
@@ -22110,6 +24061,9 @@ int jsval_set_clone(jsval_region_t *region, jsval_t src, size_t capacity,
 		dst_values[i] = src_values[i];
 	}
 	jsval_native_set(region, out)->len = native->len;
+	if (jsval_native_set_reindex(region, jsval_native_set(region, out)) < 0) {
+		return -1;
+	}
 	*value_ptr = out;
 	return 0;
 }
@@ -22140,8 +24094,9 @@ int jsval_set_has(jsval_region_t *region, jsval_t set, jsval_t key,
 		int *has_ptr)
 {
 	jsval_native_set_t *native;
-	jsval_t *values;
 	size_t i;
+	uint32_t hash;
+	int found;
 
 	if (has_ptr == NULL || set.kind != JSVAL_KIND_SET) {
 		errno = EINVAL;
@@ -22157,22 +24112,24 @@ int jsval_set_has(jsval_region_t *region, jsval_t set, jsval_t key,
 		errno = EINVAL;
 		return -1;
 	}
-	values = jsval_native_set_values(native);
-	for (i = 0; i < native->len; i++) {
-		if (jsval_same_value_zero(region, values[i], key)) {
-			*has_ptr = 1;
-			return 0;
-		}
+	found = jsval_collection_find(region, jsval_native_set_values(native), 1,
+			native->len, jsval_native_set_index(native),
+			jsval_collection_index_cap(native->cap), key, &i, &hash);
+	if (found < 0) {
+		return -1;
 	}
-	*has_ptr = 0;
+	*has_ptr = found;
 	return 0;
 }
 
 int jsval_set_add(jsval_region_t *region, jsval_t set, jsval_t key)
 {
 	jsval_native_set_t *native;
-	jsval_t *values;
+	jsval_cell_t *values;
+	uint32_t *index;
 	size_t i;
+	uint32_t hash;
+	int found;
 
 	if (set.kind != JSVAL_KIND_SET) {
 		errno = EINVAL;
@@ -22189,16 +24146,21 @@ int jsval_set_add(jsval_region_t *region, jsval_t set, jsval_t key)
 		return -1;
 	}
 	values = jsval_native_set_values(native);
-	for (i = 0; i < native->len; i++) {
-		if (jsval_same_value_zero(region, values[i], key)) {
-			return 0;
-		}
+	index = jsval_native_set_index(native);
+	found = jsval_collection_find(region, values, 1, native->len, index,
+			jsval_collection_index_cap(native->cap), key, &i, &hash);
+	if (found != 0) {
+		return found < 0 ? -1 : 0;
 	}
 	if (native->len >= native->cap) {
 		errno = ENOBUFS;
 		return -1;
 	}
-	values[native->len++] = key;
+	if (index != NULL) {
+		jsval_hash_index_put(index, jsval_collection_index_cap(native->cap),
+				hash, native->len);
+	}
+	values[native->len++] = jsval_cell_pack(key);
 	return 0;
 }
 
@@ -22206,8 +24168,11 @@ int jsval_set_delete(jsval_region_t *region, jsval_t set, jsval_t key,
 		int *deleted_ptr)
 {
 	jsval_native_set_t *native;
-	jsval_t *values;
+	jsval_cell_t *values;
+	uint32_t *index;
 	size_t i;
+	uint32_t hash;
+	int found;
 
 	if (deleted_ptr == NULL || set.kind != JSVAL_KIND_SET) {
 		errno = EINVAL;
@@ -22224,26 +24189,33 @@ int jsval_set_delete(jsval_region_t *region, jsval_t set, jsval_t key,
 		return -1;
 	}
 	values = jsval_native_set_values(native);
-	for (i = 0; i < native->len; i++) {
-		if (jsval_same_value_zero(region, values[i], key)) {
-			if (i + 1 < native->len) {
-				memmove(values + i, values + i + 1,
-						(native->len - i - 1) * sizeof(*values));
-			}
-			native->len--;
-			values[native->len] = jsval_undefined();
-			*deleted_ptr = 1;
-			return 0;
+	index = jsval_native_set_index(native);
+	found = jsval_collection_find(region, values, 1, native->len, index,
+			jsval_collection_index_cap(native->cap), key, &i, &hash);
+	if (found <= 0) {
+		if (found == 0) {
+			*deleted_ptr = 0;
 		}
+		return found;
+	}
+	if (i + 1 < native->len) {
+		memmove(values + i, values + i + 1,
+				(native->len - i - 1) * sizeof(*values));
+	}
+	native->len--;
+	values[native->len] = jsval_cell_pack(jsval_undefined());
+	if (index != NULL) {
+		jsval_hash_index_remove(index,
+				jsval_collection_index_cap(native->cap), hash, i);
 	}
-	*deleted_ptr = 0;
+	*deleted_ptr = 1;
 	return 0;
 }
 
 int jsval_set_clear(jsval_region_t *region, jsval_t set)
 {
 	jsval_native_set_t *native;
-	jsval_t *values;
+	jsval_cell_t *values;
 	size_t i;
 
 	if (set.kind != JSVAL_KIND_SET) {
@@ -22262,23 +24234,25 @@ int jsval_set_clear(jsval_region_t *region, jsval_t set)
 	}
 	values = jsval_native_set_values(native);
 	for (i = 0; i < native->len; i++) {
-		values[i] = jsval_undefined();
+		values[i] = jsval_cell_pack(jsval_undefined());
 	}
 	native->len = 0;
-	return 0;
+	return jsval_native_set_reindex(region, native);
 }
 
 int jsval_map_new(jsval_region_t *region, size_t cap, jsval_t *value_ptr)
 {
 	jsval_native_map_t *map;
 	jsval_off_t off;
-	size_t bytes_len = sizeof(*map) + cap * sizeof(jsval_native_map_entry_t);
+	size_t bytes_len = jsval_native_map_bytes(cap);
+	uint32_t *index;
 	size_t i;
 
 	if (value_ptr == NULL) {
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_MAP);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&map) < 0) {
 		return -1;
@@ -22288,8 +24262,13 @@ int jsval_map_new(jsval_region_t *region, size_t cap, jsval_t *value_ptr)
 	map->cap = cap;
 	for (i = 0; i < cap; i++) {
 		jsval_native_map_entry_t *entry = &jsval_native_map_entries(map)[i];
-		entry->key = jsval_undefined();
-		entry->value = jsval_undefined();
+		entry->key = jsval_cell_pack(jsval_undefined());
+		entry->value = jsval_cell_pack(jsval_undefined());
+	}
+	index = jsval_native_map_index(map);
+	if (index != NULL) {
+		memset(index, 0, jsval_collection_index_cap(cap) * 2
+				* sizeof(uint32_t));
 	}
 
 	*value_ptr = jsval_undefined();
@@ -22336,6 +24315,9 @@ int jsval_map_clone(jsval_region_t *region, jsval_t src, size_t capacity,
 		dst_entries[i] = src_entries[i];
 	}
 	jsval_native_map(region, out)->len = native->len;
+	if (jsval_native_map_reindex(region, jsval_native_map(region, out)) < 0) {
+		return -1;
+	}
 	*value_ptr = out;
 	return 0;
 }
@@ -22366,8 +24348,9 @@ int jsval_map_has(jsval_region_t *region, jsval_t map, jsval_t key,
 		int *has_ptr)
 {
 	jsval_native_map_t *native;
-	jsval_native_map_entry_t *entries;
 	size_t i;
+	uint32_t hash;
+	int found;
 
 	if (has_ptr == NULL || map.kind != JSVAL_KIND_MAP) {
 		errno = EINVAL;
@@ -22383,14 +24366,13 @@ int jsval_map_has(jsval_region_t *region, jsval_t map, jsval_t key,
 		errno = EINVAL;
 		return -1;
 	}
-	entries = jsval_native_map_entries(native);
-	for (i = 0; i < native->len; i++) {
-		if (jsval_same_value_zero(region, entries[i].key, key)) {
-			*has_ptr = 1;
-			return 0;
-		}
+	found = jsval_collection_find(region, &jsval_native_map_entries(native)->key,
+			2, native->len, jsval_native_map_index(native),
+			jsval_collection_index_cap(native->cap), key, &i, &hash);
+	if (found < 0) {
+		return -1;
 	}
-	*has_ptr = 0;
+	*has_ptr = found;
 	return 0;
 }
 
@@ -22400,6 +24382,8 @@ int jsval_map_get(jsval_region_t *region, jsval_t map, jsval_t key,
 	jsval_native_map_t *native;
 	jsval_native_map_entry_t *entries;
 	size_t i;
+	uint32_t hash;
+	int found;
 
 	if (value_ptr == NULL || map.kind != JSVAL_KIND_MAP) {
 		errno = EINVAL;
@@ -22416,13 +24400,14 @@ int jsval_map_get(jsval_region_t *region, jsval_t map, jsval_t key,
 		return -1;
 	}
 	entries = jsval_native_map_entries(native);
-	for (i = 0; i < native->len; i++) {
-		if (jsval_same_value_zero(region, entries[i].key, key)) {
-			*value_ptr = entries[i].value;
-			return 0;
-		}
+	found = jsval_collection_find(region, &entries->key, 2, native->len,
+			jsval_native_map_index(native),
+			jsval_collection_index_cap(native->cap), key, &i, &hash);
+	if (found < 0) {
+		return -1;
 	}
-	*value_ptr = jsval_undefined();
+	*value_ptr = found ? jsval_cell_unpack(region, entries[i].value)
+			: jsval_undefined();
 	return 0;
 }
 
@@ -22431,7 +24416,10 @@ int jsval_map_set(jsval_region_t *region, jsval_t map, jsval_t key,
 {
 	jsval_native_map_t *native;
 	jsval_native_map_entry_t *entries;
+	uint32_t *index;
 	size_t i;
+	uint32_t hash;
+	int found;
 
 	if (map.kind != JSVAL_KIND_MAP) {
 		errno = EINVAL;
@@ -22448,18 +24436,26 @@ int jsval_map_set(jsval_region_t *region, jsval_t map, jsval_t key,
 		return -1;
 	}
 	entries = jsval_native_map_entries(native);
-	for (i = 0; i < native->len; i++) {
-		if (jsval_same_value_zero(region, entries[i].key, key)) {
-			entries[i].value = value;
-			return 0;
-		}
+	index = jsval_native_map_index(native);
+	found = jsval_collection_find(region, &entries->key, 2, native->len,
+			index, jsval_collection_index_cap(native->cap), key, &i, &hash);
+	if (found < 0) {
+		return -1;
+	}
+	if (found) {
+		entries[i].value = jsval_cell_pack(value);
+		return 0;
 	}
 	if (native->len >= native->cap) {
 		errno = ENOBUFS;
 		return -1;
 	}
-	entries[native->len].key = key;
-	entries[native->len].value = value;
+	if (index != NULL) {
+		jsval_hash_index_put(index, jsval_collection_index_cap(native->cap),
+				hash, native->len);
+	}
+	entries[native->len].key = jsval_cell_pack(key);
+	entries[native->len].value = jsval_cell_pack(value);
 	native->len++;
 	return 0;
 }
@@ -22469,7 +24465,10 @@ int jsval_map_delete(jsval_region_t *region, jsval_t map, jsval_t key,
 {
 	jsval_native_map_t *native;
 	jsval_native_map_entry_t *entries;
+	uint32_t *index;
 	size_t i;
+	uint32_t hash;
+	int found;
 
 	if (deleted_ptr == NULL || map.kind != JSVAL_KIND_MAP) {
 		errno = EINVAL;
@@ -22486,20 +24485,27 @@ int jsval_map_delete(jsval_region_t *region, jsval_t map, jsval_t key,
 		return -1;
 	}
 	entries = jsval_native_map_entries(native);
-	for (i = 0; i < native->len; i++) {
-		if (jsval_same_value_zero(region, entries[i].key, key)) {
-			if (i + 1 < native->len) {
-				memmove(entries + i, entries + i + 1,
-						(native->len - i - 1) * sizeof(*entries));
-			}
-			native->len--;
-			entries[native->len].key = jsval_undefined();
-			entries[native->len].value = jsval_undefined();
-			*deleted_ptr = 1;
-			return 0;
+	index = jsval_native_map_index(native);
+	found = jsval_collection_find(region, &entries->key, 2, native->len,
+			index, jsval_collection_index_cap(native->cap), key, &i, &hash);
+	if (found <= 0) {
+		if (found == 0) {
+			*deleted_ptr = 0;
 		}
+		return found;
+	}
+	if (i + 1 < native->len) {
+		memmove(entries + i, entries + i + 1,
+				(native->len - i - 1) * sizeof(*entries));
+	}
+	native->len--;
+	entries[native->len].key = jsval_cell_pack(jsval_undefined());
+	entries[native->len].value = jsval_cell_pack(jsval_undefined());
+	if (index != NULL) {
+		jsval_hash_index_remove(index,
+				jsval_collection_index_cap(native->cap), hash, i);
 	}
-	*deleted_ptr = 0;
+	*deleted_ptr = 1;
 	return 0;
 }
 
@@ -22525,11 +24531,11 @@ int jsval_map_clear(jsval_region_t *region, jsval_t map)
 	}
 	entries = jsval_native_map_entries(native);
 	for (i = 0; i < native->len; i++) {
-		entries[i].key = jsval_undefined();
-		entries[i].value = jsval_undefined();
+		entries[i].key = jsval_cell_pack(jsval_undefined());
+		entries[i].value = jsval_cell_pack(jsval_undefined());
 	}
 	native->len = 0;
-	return 0;
+	return jsval_native_map_reindex(region, native);
 }
 
 int jsval_map_key_at(jsval_region_t *region, jsval_t map, size_t index,
@@ -22555,7 +24561,8 @@ int jsval_map_key_at(jsval_region_t *region, jsval_t map, size_t index,
 		*key_ptr = jsval_undefined();
 		return 0;
 	}
-	*key_ptr = jsval_native_map_entries(native)[index].key;
+	*key_ptr = jsval_cell_unpack(region,
+			jsval_native_map_entries(native)[index].key);
 	return 0;
 }
 
@@ -22582,13 +24589,15 @@ int jsval_map_value_at(jsval_region_t *region, jsval_t map, size_t index,
 		*value_ptr = jsval_undefined();
 		return 0;
 	}
-	*value_ptr = jsval_native_map_entries(native)[index].value;
+	*value_ptr = jsval_cell_unpack(region,
+			jsval_native_map_entries(native)[index].value);
 	return 0;
 }
 
 static int jsval_iterator_mode_is_entry(jsval_iterator_mode_t mode)
 {
 	return mode == JSVAL_ITERATOR_MODE_ARRAY_ENTRIES
+			|| mode == JSVAL_ITERATOR_MODE_JSON_ARRAY_ENTRIES
 			|| mode == JSVAL_ITERATOR_MODE_SET_ENTRIES
 			|| mode == JSVAL_ITERATOR_MODE_MAP_ENTRIES
 			|| mode == JSVAL_ITERATOR_MODE_STRING_ENTRIES;
@@ -22638,6 +24647,7 @@ static int jsval_iterator_new(jsval_region_t *region,
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_ITERATOR);
 	if (jsval_region_reserve(region, sizeof(*iterator), JSVAL_ALIGN, &off,
 			(void **)&iterator) < 0) {
 		return -1;
@@ -22647,6 +24657,11 @@ static int jsval_iterator_new(jsval_region_t *region,
 	iterator->mode = (uint8_t)mode;
 	iterator->done = 0;
 	memset(iterator->reserved, 0, sizeof(iterator->reserved));
+	iterator->token = 0;
+	if (mode == JSVAL_ITERATOR_MODE_JSON_ARRAY_VALUES
+			|| mode == JSVAL_ITERATOR_MODE_JSON_ARRAY_ENTRIES) {
+		iterator->token = source_value.as.index + 1;
+	}
 
 	*value_ptr = jsval_undefined();
 	value_ptr->kind = JSVAL_KIND_ITERATOR;
@@ -22704,6 +24719,13 @@ int jsval_get_iterator(jsval_region_t *region, jsval_t iterable,
 			errno = EINVAL;
 			return -1;
 		}
+		if (iterable.repr == JSVAL_REPR_JSON) {
+			if (mode == JSVAL_ITERATOR_MODE_ARRAY_VALUES) {
+				mode = JSVAL_ITERATOR_MODE_JSON_ARRAY_VALUES;
+			} else if (mode == JSVAL_ITERATOR_MODE_ARRAY_ENTRIES) {
+				mode = JSVAL_ITERATOR_MODE_JSON_ARRAY_ENTRIES;
+			}
+		}
 		return jsval_iterator_new(region, mode, iterable, value_ptr);
 	case JSVAL_KIND_SET:
 		if (iterable.repr != JSVAL_REPR_NATIVE
@@ -22837,13 +24859,53 @@ static int jsval_iterator_next_native(jsval_region_t *region,
 		*value_ptr = element;
 		return 0;
 	}
+	case JSVAL_ITERATOR_MODE_JSON_ARRAY_VALUES:
+	case JSVAL_ITERATOR_MODE_JSON_ARRAY_ENTRIES:
+	{
+		size_t index = iterator->cursor;
+		size_t len = jsval_array_length(region, iterator->source_value);
+		jsval_json_doc_t *doc = jsval_json_doc(region, iterator->source_value);
+		jsval_t element;
+		int next;
+
+		if (doc == NULL) {
+			errno = EINVAL;
+			return -1;
+		}
+		if (index >= len) {
+			iterator->done = 1;
+			*done_ptr = 1;
+			if (key_ptr != NULL) {
+				*key_ptr = jsval_undefined();
+			}
+			*value_ptr = jsval_undefined();
+			return 0;
+		}
+		if (iterator->token >= doc->tokused) {
+			errno = EINVAL;
+			return -1;
+		}
+		element = jsval_json_value(region, iterator->source_value,
+				iterator->token);
+		next = jsval_json_next(region, doc, (int)iterator->token);
+		iterator->token = next < 0 ? doc->tokused : (uint32_t)next;
+		iterator->cursor++;
+		*done_ptr = 0;
+		if (mode == JSVAL_ITERATOR_MODE_JSON_ARRAY_VALUES) {
+			*value_ptr = element;
+			return 0;
+		}
+		*key_ptr = jsval_number((double)index);
+		*value_ptr = element;
+		return 0;
+	}
 	case JSVAL_ITERATOR_MODE_SET_VALUES:
 	case JSVAL_ITERATOR_MODE_SET_KEYS:
 	case JSVAL_ITERATOR_MODE_SET_ENTRIES:
 	{
 		jsval_native_set_t *set = jsval_native_set(region,
 				iterator->source_value);
-		jsval_t *values;
+		jsval_cell_t *values;
 		jsval_t element;
 
 		if (set == NULL) {
@@ -22860,7 +24922,7 @@ static int jsval_iterator_next_native(jsval_region_t *region,
 			return 0;
 		}
 		values = jsval_native_set_values(set);
-		element = values[iterator->cursor++];
+		element = jsval_cell_unpack(region, values[iterator->cursor++]);
 		*done_ptr = 0;
 		if (mode == JSVAL_ITERATOR_MODE_SET_ENTRIES) {
 			*key_ptr = element;
@@ -22896,15 +24958,15 @@ static int jsval_iterator_next_native(jsval_region_t *region,
 		entry = entries[iterator->cursor++];
 		*done_ptr = 0;
 		if (mode == JSVAL_ITERATOR_MODE_MAP_KEYS) {
-			*value_ptr = entry.key;
+			*value_ptr = jsval_cell_unpack(region, entry.key);
 			return 0;
 		}
 		if (mode == JSVAL_ITERATOR_MODE_MAP_VALUES) {
-			*value_ptr = entry.value;
+			*value_ptr = jsval_cell_unpack(region, entry.value);
 			return 0;
 		}
-		*key_ptr = entry.key;
-		*value_ptr = entry.value;
+		*key_ptr = jsval_cell_unpack(region, entry.key);
+		*value_ptr = jsval_cell_unpack(region, entry.value);
 		return 0;
 	}
 	case JSVAL_ITERATOR_MODE_STRING_VALUES:
@@ -23164,6 +25226,7 @@ jsval_regexp_new_from_utf16(jsval_region_t *region, const uint16_t *pattern,
 		return -1;
 	}
 	if (compiled.named_group_count > 0) {
+		JSVAL_ALLOC_TAG(region, JSVAL_KIND_REGEXP);
 		if (jsval_region_reserve(region,
 				(size_t)compiled.named_group_count * sizeof(*named_groups),
 				JSVAL_ALIGN, &named_groups_off, (void **)&named_groups) < 0) {
@@ -23217,6 +25280,7 @@ jsval_regexp_new_from_utf16(jsval_region_t *region, const uint16_t *pattern,
 			named_groups[j] = entry;
 		}
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_REGEXP);
 	if (jsval_region_reserve(region, sizeof(*regexp), JSVAL_ALIGN, &off,
 			(void **)&regexp) < 0) {
 		jsregex_release(&compiled);
@@ -24631,6 +26695,7 @@ jsval_match_iterator_new(jsval_region_t *region,
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_MATCH_ITERATOR);
 	if (jsval_region_reserve(region, sizeof(*iterator), JSVAL_ALIGN, &off,
 			(void **)&iterator) < 0) {
 		return -1;
@@ -30105,13 +32170,65 @@ jsval_method_string_replace_regex_fn(jsval_region_t *region,
 }
 #endif
 
-int jsval_json_parse(jsval_region_t *region, const uint8_t *json, size_t len, unsigned int token_cap, jsval_t *value_ptr)
+/*
+ * Finish a doc whose source and token fields are already set: build
+ * the skip index over the `tokused` parsed tokens and, if `set_root`,
+ * make the root value the region root.
+ */
+static int jsval_json_doc_complete(jsval_region_t *region,
+		jsval_json_doc_t *doc, jsval_off_t doc_off, unsigned int tokused,
+		int set_root, jsval_t *value_ptr)
+{
+	jsval_off_t skip_off;
+	uint32_t *skip;
+
+#if JSMX_WITH_NAN_BOXING
+	/* Token indexes must fit a JSON cell. */
+	if (tokused > JSVAL_CELL_JSON_TOKENS_MAX) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+#endif
+	JSVAL_ALLOC_TAG(region, JSVAL_ALLOC_CLASS_JSON_TOKENS);
+	if (jsval_region_reserve(region, (tokused ? tokused : 1) * sizeof(uint32_t),
+			sizeof(uint32_t), &skip_off, (void **)&skip) < 0) {
+		return -1;
+	}
+	jsval_json_build_skip(jsval_json_doc_tokens(region, doc), tokused, skip);
+
+	doc->tokused = tokused;
+	doc->root_i = 0;
+	doc->skip_off = skip_off;
+	doc->index_off = 0;
+	doc->compact = (uint8_t)jsval_json_tokens_compact(
+			jsval_json_doc_tokens(region, doc), tokused);
+	doc->index_objects = 0;
+	doc->index_arrays = 0;
+	memset(doc->reserved, 0, sizeof(doc->reserved));
+
+	*value_ptr = jsval_undefined();
+	value_ptr->repr = JSVAL_REPR_JSON;
+	value_ptr->off = doc_off;
+	value_ptr->as.index = 0;
+	value_ptr->kind = jsval_json_token_kind(region, doc, 0);
+	if (set_root) {
+		jsval_region_set_root(region, *value_ptr);
+	}
+	return 0;
+}
+
+#define JSVAL_JSON_PARSE_BORROW 1u
+#define JSVAL_JSON_PARSE_NO_ROOT 2u
+
+static int jsval_json_parse_internal(jsval_region_t *region,
+		const uint8_t *json, size_t len, unsigned int token_cap,
+		unsigned int flags, jsval_t *value_ptr)
 {
 	jsval_json_doc_t *doc;
 	jsval_off_t doc_off;
-	jsval_off_t json_off;
+	jsval_off_t json_off = 0;
 	jsval_off_t tokens_off;
-	uint8_t *json_copy;
+	const uint8_t *source;
 	jsmntok_t *tokens;
 	jsmn_parser parser;
 	int rc;
@@ -30120,18 +32237,29 @@ int jsval_json_parse(jsval_region_t *region, const uint8_t *json, size_t len, un
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_ALLOC_CLASS_JSON_DOC);
 	if (jsval_region_reserve(region, sizeof(*doc), JSVAL_ALIGN, &doc_off, (void **)&doc) < 0) {
 		return -1;
 	}
-	if (jsval_region_reserve(region, len + 1, 1, &json_off, (void **)&json_copy) < 0) {
-		return -1;
+	if (flags & JSVAL_JSON_PARSE_BORROW) {
+		source = json;
+	} else {
+		uint8_t *json_copy;
+
+		JSVAL_ALLOC_TAG(region, JSVAL_ALLOC_CLASS_JSON_SOURCE);
+		if (jsval_region_reserve(region, len + 1, 1, &json_off,
+				(void **)&json_copy) < 0) {
+			return -1;
+		}
+		memcpy(json_copy, json, len);
+		json_copy[len] = '\0';
+		source = json_copy;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_ALLOC_CLASS_JSON_TOKENS);
 	if (jsval_region_reserve(region, token_cap * sizeof(jsmntok_t), JSVAL_ALIGN, &tokens_off, (void **)&tokens) < 0) {
 		return -1;
 	}
 
-	memcpy(json_copy, json, len);
-	json_copy[len] = '\0';
 	/* No memset of the token pool: jsmn_alloc_token (jsmn.c) writes
 	 * every field of each token it allocates, and jsmn never reads
 	 * tokens beyond parser->toknext. Zeroing 256 * sizeof(jsmntok_t)
@@ -30139,7 +32267,7 @@ int jsval_json_parse(jsval_region_t *region, const uint8_t *json, size_t len, un
 	 * callgrind. */
 
 	jsmn_init(&parser);
-	rc = jsmn_parse(&parser, (const char *)json_copy, len, tokens, token_cap);
+	rc = jsmn_parse(&parser, (const char *)source, len, tokens, token_cap);
 	if (rc < 0) {
 		return rc;
 	}
@@ -30148,18 +32276,884 @@ int jsval_json_parse(jsval_region_t *region, const uint8_t *json, size_t len, un
 	doc->json_len = len;
 	doc->tokens_off = tokens_off;
 	doc->tokcap = token_cap;
-	doc->tokused = parser.toknext;
-	doc->root_i = 0;
+	doc->borrowed = (flags & JSVAL_JSON_PARSE_BORROW) ? json : NULL;
+	return jsval_json_doc_complete(region, doc, doc_off, parser.toknext,
+			!(flags & JSVAL_JSON_PARSE_NO_ROOT), value_ptr);
+}
 
-	*value_ptr = jsval_undefined();
-	value_ptr->repr = JSVAL_REPR_JSON;
-	value_ptr->off = doc_off;
-	value_ptr->as.index = 0;
-	value_ptr->kind = jsval_json_token_kind(region, doc, 0);
-	jsval_region_set_root(region, *value_ptr);
+int jsval_json_parse(jsval_region_t *region, const uint8_t *json, size_t len, unsigned int token_cap, jsval_t *value_ptr)
+{
+	return jsval_json_parse_internal(region, json, len, token_cap, 0,
+			value_ptr);
+}
+
+int jsval_json_measure_tokens(const uint8_t *json, size_t len,
+		unsigned int *token_count_ptr)
+{
+	jsmn_parser parser;
+	int rc;
+
+	if (token_count_ptr == NULL || (json == NULL && len > 0)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (json == NULL) {
+		json = (const uint8_t *)"";
+	}
+	/* jsmn's counting mode (tokens == NULL) walks the same scanner as a
+	 * real parse but writes nothing, and counts exactly the tokens a
+	 * parse of the same bytes allocates. */
+	jsmn_init(&parser);
+	rc = jsmn_parse(&parser, (const char *)json, len, NULL, 0);
+	if (rc < 0) {
+		return rc;
+	}
+	*token_count_ptr = (unsigned int)rc;
+	return 0;
+}
+
+int jsval_json_parse_auto(jsval_region_t *region, const uint8_t *json,
+		size_t len, jsval_t *value_ptr)
+{
+	unsigned int token_count;
+	int rc;
+
+	rc = jsval_json_measure_tokens(json, len, &token_count);
+	if (rc < 0) {
+		return rc;
+	}
+	return jsval_json_parse_internal(region, json, len,
+			token_count ? token_count : 1, 0, value_ptr);
+}
+
+int jsval_json_parse_borrowed(jsval_region_t *region, const uint8_t *json,
+		size_t len, unsigned int token_cap, jsval_t *value_ptr)
+{
+	if (json == NULL && len > 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (json == NULL) {
+		json = (const uint8_t *)"";
+	}
+	return jsval_json_parse_internal(region, json, len, token_cap,
+			JSVAL_JSON_PARSE_BORROW, value_ptr);
+}
+
+int jsval_json_rebind_borrowed(jsval_region_t *region, jsval_t value,
+		const uint8_t *json, size_t len)
+{
+	jsval_json_doc_t *doc;
+
+	if (region == NULL || json == NULL || value.repr != JSVAL_REPR_JSON) {
+		errno = EINVAL;
+		return -1;
+	}
+	doc = jsval_json_doc(region, value);
+	if (doc == NULL || doc->borrowed == NULL || doc->json_len != len) {
+		errno = EINVAL;
+		return -1;
+	}
+	doc->borrowed = json;
+	return 0;
+}
+
+/* Set one of the doc's index opt-in flags. */
+static int jsval_json_doc_opt_in(jsval_region_t *region, jsval_t value,
+		int arrays)
+{
+	jsval_json_doc_t *doc;
+	uint8_t *flag;
+
+	if (region == NULL || value.repr != JSVAL_REPR_JSON) {
+		errno = EINVAL;
+		return -1;
+	}
+	doc = jsval_json_doc(region, value);
+	if (doc == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	flag = arrays ? &doc->index_arrays : &doc->index_objects;
+	if (*flag) {
+		return 0;
+	}
+	if (region->readonly) {
+		errno = EROFS;
+		return -1;
+	}
+	*flag = 1;
+	return 0;
+}
+
+int jsval_json_index_objects(jsval_region_t *region, jsval_t value)
+{
+	return jsval_json_doc_opt_in(region, value, 0);
+}
+
+int jsval_json_index_arrays(jsval_region_t *region, jsval_t value)
+{
+	return jsval_json_doc_opt_in(region, value, 1);
+}
+
+/* Bytes that end a JSON primitive. */
+static int jsval_json_is_delimiter(uint8_t c)
+{
+	switch (c) {
+	case ' ': case '\t': case '\r': case '\n':
+	case ',': case ':': case '[': case ']': case '{': case '}': case '"':
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+int jsval_json_path_compile(const char *path, size_t len,
+		jsval_json_path_t *path_ptr)
+{
+	size_t pos = 0;
+	size_t count = 0;
+
+	if (path_ptr == NULL || (path == NULL && len > 0)) {
+		errno = EINVAL;
+		return -1;
+	}
+	memset(path_ptr, 0, sizeof(*path_ptr));
+	while (pos < len) {
+		jsval_json_path_segment_t *segment;
+
+		if (count == JSVAL_JSON_PATH_MAX_SEGMENTS) {
+			errno = ENOBUFS;
+			return -1;
+		}
+		segment = &path_ptr->segments[count];
+		if (path[pos] == '[') {
+			size_t index = 0;
+			size_t digits = 0;
+
+			pos++;
+			if (pos < len && path[pos] == '*') {
+				segment->kind = JSVAL_JSON_PATH_ANY;
+				path_ptr->wildcard = 1;
+				pos++;
+			} else {
+				while (pos < len && path[pos] >= '0' && path[pos] <= '9') {
+					if (index > (UINT32_MAX - 9) / 10) {
+						errno = EINVAL;
+						return -1;
+					}
+					index = index * 10 + (size_t)(path[pos] - '0');
+					digits++;
+					pos++;
+				}
+				if (digits == 0) {
+					errno = EINVAL;
+					return -1;
+				}
+				segment->kind = JSVAL_JSON_PATH_INDEX;
+				segment->index = (uint32_t)index;
+			}
+			if (pos >= len || path[pos] != ']') {
+				errno = EINVAL;
+				return -1;
+			}
+			pos++;
+		} else {
+			size_t start;
+
+			if (count > 0) {
+				if (path[pos] != '.') {
+					errno = EINVAL;
+					return -1;
+				}
+				pos++;
+			}
+			start = pos;
+			while (pos < len && path[pos] != '.' && path[pos] != '[') {
+				pos++;
+			}
+			if (pos == start) {
+				errno = EINVAL;
+				return -1;
+			}
+			segment->kind = JSVAL_JSON_PATH_KEY;
+			segment->key = (const uint8_t *)path + start;
+			segment->key_len = pos - start;
+		}
+		count++;
+	}
+	path_ptr->segment_count = count;
 	return 0;
 }
 
+typedef struct jsval_json_project_state_s {
+	jsval_region_t *region;
+	const uint8_t *json;
+	size_t len;
+	const jsval_json_path_t *paths;
+	size_t path_count;
+	jsval_t *values;
+	uint64_t found;
+} jsval_json_project_state_t;
+
+static size_t jsval_json_scan_space(const uint8_t *json, size_t len,
+		size_t pos)
+{
+	while (pos < len && (json[pos] == ' ' || json[pos] == '\t'
+			|| json[pos] == '\r' || json[pos] == '\n')) {
+		pos++;
+	}
+	return pos;
+}
+
+/* `pos` is at the opening quote; *end_ptr lands just past the closing one. */
+static int jsval_json_scan_string(const uint8_t *json, size_t len,
+		size_t pos, size_t *end_ptr)
+{
+	for (pos++; pos < len; pos++) {
+		if (json[pos] == '\\') {
+			pos++;
+		} else if (json[pos] == '"') {
+			*end_ptr = pos + 1;
+			return 0;
+		}
+	}
+	errno = EINVAL;
+	return -1;
+}
+
+/*
+ * Skip one value by balancing brackets and quotes only; the bytes in
+ * between are not validated or tokenized.
+ */
+static int jsval_json_scan_skip(const uint8_t *json, size_t len, size_t pos,
+		size_t *end_ptr)
+{
+	size_t depth = 0;
+
+	if (pos >= len) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (json[pos] != '{' && json[pos] != '[' && json[pos] != '"') {
+		size_t start = pos;
+
+		while (pos < len && !jsval_json_is_delimiter(json[pos])) {
+			pos++;
+		}
+		/* A comma or closer where a value should start. */
+		if (pos == start) {
+			errno = EINVAL;
+			return -1;
+		}
+		*end_ptr = pos;
+		return 0;
+	}
+	while (pos < len) {
+		switch (json[pos]) {
+		case '"':
+			if (jsval_json_scan_string(json, len, pos, &pos) < 0) {
+				return -1;
+			}
+			if (depth == 0) {
+				*end_ptr = pos;
+				return 0;
+			}
+			continue;
+		case '{': case '[':
+			depth++;
+			break;
+		case '}': case ']':
+			if (depth == 0) {
+				errno = EINVAL;
+				return -1;
+			}
+			if (--depth == 0) {
+				*end_ptr = pos + 1;
+				return 0;
+			}
+			break;
+		default:
+			break;
+		}
+		pos++;
+	}
+	errno = EINVAL;
+	return -1;
+}
+
+static size_t jsval_json_utf8_encode(uint32_t cp, uint8_t *out)
+{
+	if (cp < 0x80) {
+		out[0] = (uint8_t)cp;
+		return 1;
+	}
+	if (cp < 0x800) {
+		out[0] = (uint8_t)(0xC0 | (cp >> 6));
+		out[1] = (uint8_t)(0x80 | (cp & 0x3F));
+		return 2;
+	}
+	if (cp < 0x10000) {
+		out[0] = (uint8_t)(0xE0 | (cp >> 12));
+		out[1] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+		out[2] = (uint8_t)(0x80 | (cp & 0x3F));
+		return 3;
+	}
+	out[0] = (uint8_t)(0xF0 | (cp >> 18));
+	out[1] = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+	out[2] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+	out[3] = (uint8_t)(0x80 | (cp & 0x3F));
+	return 4;
+}
+
+static int jsval_json_hex4(const uint8_t *p, size_t avail, uint32_t *out)
+{
+	uint32_t v = 0;
+	size_t i;
+
+	if (avail < 4) {
+		return -1;
+	}
+	for (i = 0; i < 4; i++) {
+		uint8_t c = p[i];
+
+		v <<= 4;
+		if (c >= '0' && c <= '9') {
+			v |= (uint32_t)(c - '0');
+		} else if (c >= 'a' && c <= 'f') {
+			v |= (uint32_t)(c - 'a' + 10);
+		} else if (c >= 'A' && c <= 'F') {
+			v |= (uint32_t)(c - 'A' + 10);
+		} else {
+			return -1;
+		}
+	}
+	*out = v;
+	return 0;
+}
+
+/* Compare the raw (still escaped) body of a JSON string to a UTF-8 key. */
+static int jsval_json_raw_key_eq(const uint8_t *raw, size_t raw_len,
+		const uint8_t *key, size_t key_len)
+{
+	size_t i = 0;
+	size_t k = 0;
+
+	if (memchr(raw, '\\', raw_len) == NULL) {
+		return raw_len == key_len && memcmp(raw, key, key_len) == 0;
+	}
+	while (i < raw_len) {
+		uint8_t unit[4];
+		size_t unit_len = 1;
+
+		if (raw[i] != '\\') {
+			unit[0] = raw[i++];
+		} else if (i + 1 >= raw_len) {
+			return 0;
+		} else {
+			uint8_t c = raw[i + 1];
+
+			i += 2;
+			switch (c) {
+			case 'b': unit[0] = '\b'; break;
+			case 'f': unit[0] = '\f'; break;
+			case 'n': unit[0] = '\n'; break;
+			case 'r': unit[0] = '\r'; break;
+			case 't': unit[0] = '\t'; break;
+			case 'u':
+			{
+				uint32_t cp;
+				uint32_t low;
+
+				if (jsval_json_hex4(raw + i, raw_len - i, &cp) < 0) {
+					return 0;
+				}
+				i += 4;
+				if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < raw_len
+						&& raw[i] == '\\' && raw[i + 1] == 'u'
+						&& jsval_json_hex4(raw + i + 2, raw_len - i - 2,
+							&low) == 0
+						&& low >= 0xDC00 && low <= 0xDFFF) {
+					cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+					i += 6;
+				}
+				unit_len = jsval_json_utf8_encode(cp, unit);
+				break;
+			}
+			default:
+				unit[0] = c;
+				break;
+			}
+		}
+		if (key_len - k < unit_len || memcmp(key + k, unit, unit_len) != 0) {
+			return 0;
+		}
+		k += unit_len;
+	}
+	return k == key_len;
+}
+
+static int jsval_json_project_match(jsval_json_project_state_t *state,
+		size_t path_i, size_t start, size_t end)
+{
+	jsval_region_t *region = state->region;
+	jsval_t value;
+	jsval_t *slot = &state->values[path_i];
+	unsigned int token_count;
+	int rc;
+
+	if (!state->paths[path_i].wildcard && (state->found & ((uint64_t)1 << path_i))) {
+		/* Duplicate key: the first occurrence wins, as in lookups. */
+		return 0;
+	}
+	rc = jsval_json_measure_tokens(state->json + start, end - start,
+			&token_count);
+	if (rc == 0) {
+		rc = jsval_json_parse_internal(region, state->json + start,
+				end - start, token_count ? token_count : 1,
+				JSVAL_JSON_PARSE_NO_ROOT, &value);
+	}
+	if (rc < 0) {
+		if (rc != -1) {
+			errno = EINVAL;
+		}
+		return -1;
+	}
+	state->found |= (uint64_t)1 << path_i;
+	if (!state->paths[path_i].wildcard) {
+		*slot = value;
+		return 0;
+	}
+	if (slot->kind != JSVAL_KIND_ARRAY) {
+		if (jsval_array_new(region, 4, slot) < 0) {
+			return -1;
+		}
+	} else {
+		jsval_native_array_t *native = jsval_native_array(region, *slot);
+
+		if (native->len == native->cap
+				&& jsval_array_clone_dense(region, *slot, native->cap * 2,
+					slot) < 0) {
+			return -1;
+		}
+	}
+	return jsval_array_push(region, *slot, value);
+}
+
+/*
+ * Walk the value at `pos` (already past leading blanks) at `depth`.
+ * `mask` holds the paths whose first `depth` segments lead here; the
+ * walk only descends while one of them continues, and everything else
+ * is skipped without tokenizing.
+ */
+static int jsval_json_project_value(jsval_json_project_state_t *state,
+		size_t pos, size_t depth, uint64_t mask, size_t *end_ptr)
+{
+	const uint8_t *json = state->json;
+	size_t len = state->len;
+	size_t start = pos;
+	uint64_t deeper = 0;
+	size_t i;
+
+	for (i = 0; i < state->path_count; i++) {
+		if ((mask & ((uint64_t)1 << i))
+				&& state->paths[i].segment_count > depth) {
+			deeper |= (uint64_t)1 << i;
+		}
+	}
+
+	if (deeper != 0 && pos < len && (json[pos] == '{' || json[pos] == '[')) {
+		int is_object = json[pos] == '{';
+		uint8_t close = is_object ? '}' : ']';
+		uint32_t index = 0;
+
+		pos = jsval_json_scan_space(json, len, pos + 1);
+		if (pos < len && json[pos] == close) {
+			pos++;
+		} else {
+			for (;;) {
+				uint64_t child = 0;
+				size_t key_start = 0;
+				size_t key_end = 0;
+
+				if (is_object) {
+					if (pos >= len || json[pos] != '"'
+							|| jsval_json_scan_string(json, len, pos,
+								&key_end) < 0) {
+						errno = EINVAL;
+						return -1;
+					}
+					key_start = pos + 1;
+					pos = jsval_json_scan_space(json, len, key_end);
+					if (pos >= len || json[pos] != ':') {
+						errno = EINVAL;
+						return -1;
+					}
+					pos = jsval_json_scan_space(json, len, pos + 1);
+				}
+				for (i = 0; i < state->path_count; i++) {
+					const jsval_json_path_segment_t *segment;
+
+					if (!(deeper & ((uint64_t)1 << i))) {
+						continue;
+					}
+					segment = &state->paths[i].segments[depth];
+					if (is_object ? (segment->kind == JSVAL_JSON_PATH_KEY
+							&& jsval_json_raw_key_eq(json + key_start,
+								key_end - 1 - key_start, segment->key,
+								segment->key_len))
+							: (segment->kind == JSVAL_JSON_PATH_ANY
+							|| (segment->kind == JSVAL_JSON_PATH_INDEX
+								&& segment->index == index))) {
+						child |= (uint64_t)1 << i;
+					}
+				}
+				if (child != 0) {
+					if (jsval_json_project_value(state, pos, depth + 1, child,
+							&pos) < 0) {
+						return -1;
+					}
+				} else if (jsval_json_scan_skip(json, len, pos, &pos) < 0) {
+					return -1;
+				}
+				index++;
+				pos = jsval_json_scan_space(json, len, pos);
+				if (pos < len && json[pos] == ',') {
+					pos = jsval_json_scan_space(json, len, pos + 1);
+					continue;
+				}
+				if (pos < len && json[pos] == close) {
+					pos++;
+					break;
+				}
+				errno = EINVAL;
+				return -1;
+			}
+		}
+	} else if (jsval_json_scan_skip(json, len, pos, &pos) < 0) {
+		return -1;
+	}
+
+	for (i = 0; i < state->path_count; i++) {
+		if ((mask & ((uint64_t)1 << i))
+				&& state->paths[i].segment_count == depth
+				&& jsval_json_project_match(state, i, start, pos) < 0) {
+			return -1;
+		}
+	}
+	*end_ptr = pos;
+	return 0;
+}
+
+int jsval_json_project(jsval_region_t *region, const uint8_t *json,
+		size_t len, const jsval_json_path_t *paths, size_t path_count,
+		jsval_t *values)
+{
+	jsval_json_project_state_t state;
+	size_t pos;
+	size_t i;
+
+	if (region == NULL || (json == NULL && len > 0)
+			|| (path_count > 0 && (paths == NULL || values == NULL))
+			|| path_count > 64) {
+		errno = EINVAL;
+		return -1;
+	}
+	for (i = 0; i < path_count; i++) {
+		values[i] = jsval_undefined();
+	}
+	if (path_count == 0) {
+		return 0;
+	}
+	state.region = region;
+	state.json = json;
+	state.len = len;
+	state.paths = paths;
+	state.path_count = path_count;
+	state.values = values;
+	state.found = 0;
+
+	pos = jsval_json_scan_space(json, len, 0);
+	if (pos >= len) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (jsval_json_project_value(&state, pos, 0,
+			path_count == 64 ? UINT64_MAX
+				: (((uint64_t)1 << path_count) - 1), &pos) < 0) {
+		return -1;
+	}
+	pos = jsval_json_scan_space(json, len, pos);
+	if (pos < len && json[pos] != '\0') {
+		errno = EINVAL;
+		return -1;
+	}
+	for (i = 0; i < path_count; i++) {
+		if (paths[i].wildcard && values[i].kind != JSVAL_KIND_ARRAY
+				&& jsval_array_new(region, 0, &values[i]) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int jsval_region_mark(jsval_region_t *region, jsval_region_mark_t *mark_ptr)
+{
+	if (!jsval_region_valid(region) || mark_ptr == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	mark_ptr->used = region->pages->used_len;
+	mark_ptr->floor = region->mark_floor;
+	mark_ptr->root = region->pages->root;
+	region->mark_floor = mark_ptr->used;
+	return 0;
+}
+
+int jsval_region_release(jsval_region_t *region,
+		const jsval_region_mark_t *mark)
+{
+	jsval_off_t off;
+
+	if (!jsval_region_valid(region) || mark == NULL
+			|| mark->used < jsval_pages_head_size_aligned()
+			|| mark->used > region->pages->used_len
+			|| mark->floor > mark->used) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (region->readonly) {
+		errno = EROFS;
+		return -1;
+	}
+
+	/* Queued nodes from inside the scope would be reclaimed under the
+	 * scheduler; older nodes stay valid. */
+	for (off = region->microtask_head; off != 0; ) {
+		jsval_native_microtask_t *task;
+
+		if (off >= mark->used) {
+			errno = EBUSY;
+			return -1;
+		}
+		task = jsval_native_microtask(region, off);
+		if (task == NULL) {
+			errno = EINVAL;
+			return -1;
+		}
+		off = task->next_off;
+	}
+	for (off = region->fetch_waitlist_head; off != 0; ) {
+		jsval_native_fetch_waitlist_entry_t *entry;
+
+		if (off >= mark->used) {
+			errno = EBUSY;
+			return -1;
+		}
+		entry = (jsval_native_fetch_waitlist_entry_t *)jsval_region_ptr(
+				region, off);
+		if (entry == NULL) {
+			errno = EINVAL;
+			return -1;
+		}
+		off = entry->next_off;
+	}
+	for (off = region->promise_combinator_head; off != 0; ) {
+		jsval_promise_combinator_coord_t *coord;
+
+		if (off >= mark->used) {
+			errno = EBUSY;
+			return -1;
+		}
+		coord = (jsval_promise_combinator_coord_t *)(region->base + off);
+		off = coord->next;
+	}
+
+	jsval_region_node_trim(region, mark->used);
+	jsval_region_atoms_trim(region, mark->used);
+	region->pages->used_len = mark->used;
+	region->used = mark->used;
+	region->pages->root = mark->root;
+	region->mark_floor = mark->floor;
+	return 0;
+}
+
+int jsval_region_snapshot(jsval_region_t *region,
+		jsval_region_snapshot_t *snapshot_ptr)
+{
+	if (!jsval_region_valid(region) || snapshot_ptr == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (region->microtask_head != 0 || region->fetch_waitlist_head != 0
+			|| region->promise_combinator_head != 0) {
+		errno = EBUSY;
+		return -1;
+	}
+	memcpy(&snapshot_ptr->pages, region->pages, sizeof(jsval_pages_t));
+	region->mark_floor = region->pages->used_len;
+	return 0;
+}
+
+int jsval_region_restore(jsval_region_t *region,
+		const jsval_region_snapshot_t *snapshot)
+{
+	uint32_t total_len;
+
+	if (!jsval_region_valid(region) || snapshot == NULL
+			|| snapshot->pages.magic != JSVAL_PAGES_MAGIC
+			|| snapshot->pages.version != JSVAL_PAGES_VERSION
+			|| snapshot->pages.header_size != sizeof(jsval_pages_t)
+			|| snapshot->pages.used_len < jsval_pages_head_size_aligned()
+			|| snapshot->pages.used_len > region->pages->used_len) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (region->readonly) {
+		errno = EROFS;
+		return -1;
+	}
+	/* A grown region keeps its pages. */
+	total_len = region->pages->total_len;
+	memcpy(region->pages, &snapshot->pages, sizeof(jsval_pages_t));
+	region->pages->total_len = total_len;
+	region->used = region->pages->used_len;
+	region->microtask_head = 0;
+	region->microtask_tail = 0;
+	region->microtask_count = 0;
+	region->fetch_waitlist_head = 0;
+	region->fetch_waitlist_tail = 0;
+	region->fetch_waitlist_count = 0;
+	region->promise_combinator_head = 0;
+	region->mark_floor = snapshot->pages.used_len;
+	jsval_region_node_trim(region, region->used);
+	jsval_region_atoms_trim(region, region->used);
+	return 0;
+}
+
+void jsval_ndjson_reader_init(jsval_ndjson_reader_t *reader,
+		const jsval_body_source_vtable_t *vtable, void *userdata,
+		uint8_t *buf, size_t cap)
+{
+	memset(reader, 0, sizeof(*reader));
+	reader->vtable = vtable;
+	reader->userdata = userdata;
+	reader->buf = buf;
+	reader->cap = cap;
+}
+
+/* Parse one line in place, hand it to the callback, and roll the region
+ * back to where it was before the line. */
+static int jsval_ndjson_deliver(jsval_region_t *region,
+		jsval_ndjson_reader_t *reader, const uint8_t *line, size_t len,
+		jsval_ndjson_record_fn record, void *ctx)
+{
+	jsval_region_mark_t mark;
+	unsigned int token_count;
+	jsval_t value;
+	int rc;
+
+	reader->line_no++;
+	while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == ' '
+			|| line[len - 1] == '\t')) {
+		len--;
+	}
+	if (len == 0) {
+		return 0;
+	}
+	if (jsval_region_mark(region, &mark) < 0) {
+		return -1;
+	}
+	rc = jsval_json_measure_tokens(line, len, &token_count);
+	if (rc == 0) {
+		rc = jsval_json_parse_internal(region, line, len,
+				token_count ? token_count : 1,
+				JSVAL_JSON_PARSE_BORROW | JSVAL_JSON_PARSE_NO_ROOT, &value);
+	}
+	if (rc < 0) {
+		if (rc != -1) {
+			errno = EINVAL;
+		}
+		(void)jsval_region_release(region, &mark);
+		return -1;
+	}
+	if (record(region, ctx, value, reader->line_no) < 0
+			|| jsval_region_release(region, &mark) < 0) {
+		/* Abandon the scope: keep its bytes, lift the index floor. */
+		region->mark_floor = mark.floor;
+		return -1;
+	}
+	return 0;
+}
+
+int jsval_ndjson_reader_run(jsval_region_t *region,
+		jsval_ndjson_reader_t *reader, jsval_ndjson_record_fn record,
+		void *ctx)
+{
+	if (!jsval_region_valid(region) || reader == NULL || record == NULL
+			|| reader->vtable == NULL || reader->vtable->read == NULL
+			|| reader->buf == NULL || reader->cap == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	for (;;) {
+		jsval_body_source_status_t status = JSVAL_BODY_SOURCE_STATUS_ERROR;
+		size_t start = 0;
+		size_t n = 0;
+		const uint8_t *newline;
+		int rc;
+
+		/* memchr is the vectorized newline scan on mainstream libcs. */
+		rc = 0;
+		while (rc == 0 && (newline = memchr(reader->buf + start, '\n',
+				reader->len - start)) != NULL) {
+			size_t end = (size_t)(newline - reader->buf);
+
+			rc = jsval_ndjson_deliver(region, reader, reader->buf + start,
+					end - start, record, ctx);
+			/* Consumed either way: a failing line is not redelivered. */
+			start = end + 1;
+		}
+		if (start > 0) {
+			memmove(reader->buf, reader->buf + start, reader->len - start);
+			reader->len -= start;
+		}
+		if (rc != 0) {
+			return rc;
+		}
+		if (reader->eof) {
+			if (reader->len > 0) {
+				size_t len = reader->len;
+
+				reader->len = 0;
+				rc = jsval_ndjson_deliver(region, reader, reader->buf, len,
+						record, ctx);
+				if (rc != 0) {
+					return rc;
+				}
+			}
+			return 1;
+		}
+		if (reader->len == reader->cap) {
+			errno = ENOBUFS;
+			return -1;
+		}
+		if (reader->vtable->read(reader->userdata, reader->buf + reader->len,
+				reader->cap - reader->len, &n, &status) < 0
+				|| status == JSVAL_BODY_SOURCE_STATUS_ERROR) {
+			errno = EIO;
+			return -1;
+		}
+		reader->len += n;
+		if (status == JSVAL_BODY_SOURCE_STATUS_EOF) {
+			reader->eof = 1;
+		} else if (n == 0) {
+			/* PENDING, or a READY that made no progress: yield. */
+			return 0;
+		}
+	}
+}
+
 int jsval_copy_json(jsval_region_t *region, jsval_t value, uint8_t *buf, size_t cap, size_t *len_ptr)
 {
 	jsval_json_emit_state_t state;
@@ -30176,6 +33170,76 @@ int jsval_copy_json(jsval_region_t *region, jsval_t value, uint8_t *buf, size_t
 	return 0;
 }
 
+void jsval_json_sink_stream_init(jsval_json_sink_stream_t *stream,
+		jsval_t value, const jsval_underlying_sink_vtable_t *vtable,
+		void *userdata, uint8_t *chunk, size_t chunk_cap)
+{
+	memset(stream, 0, sizeof(*stream));
+	stream->vtable = vtable;
+	stream->userdata = userdata;
+	stream->value = value;
+	stream->state.buf = chunk;
+	stream->state.cap = chunk_cap;
+	stream->state.chunked = 1;
+}
+
+int jsval_json_sink_stream_run(jsval_region_t *region,
+		jsval_json_sink_stream_t *stream, jsval_t *error_value)
+{
+	jsval_json_emit_state_t *state = &stream->state;
+
+	if (stream->vtable == NULL || stream->vtable->write == NULL
+			|| state->buf == NULL || state->cap == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	for (;;) {
+		while (stream->sent < state->fill) {
+			jsval_underlying_sink_status_t status;
+			size_t accepted = 0;
+			jsval_t error = jsval_undefined();
+
+			status = stream->vtable->write(region, stream->userdata,
+					state->buf + stream->sent, state->fill - stream->sent,
+					&accepted, &error);
+			if (status == JSVAL_UNDERLYING_SINK_STATUS_ERROR) {
+				if (error_value != NULL) {
+					*error_value = error;
+				}
+				errno = EIO;
+				return -1;
+			}
+			if (status == JSVAL_UNDERLYING_SINK_STATUS_PENDING
+					|| accepted == 0) {
+				return 0;
+			}
+			if (accepted > state->fill - stream->sent) {
+				accepted = state->fill - stream->sent;
+			}
+			stream->sent += accepted;
+		}
+		if (stream->done) {
+			return 1;
+		}
+
+		/* Emit the next chunk, starting where the last one ended. */
+		state->skip += state->fill;
+		state->fill = 0;
+		state->len = 0;
+		state->depth = 0;
+		state->full = 0;
+		state->resume_next = 0;
+		stream->sent = 0;
+		if (jsval_json_emit_value(region, stream->value, state) < 0) {
+			if (!state->full) {
+				return -1;
+			}
+		} else {
+			stream->done = 1;
+		}
+	}
+}
+
 int jsval_string_copy_utf8(jsval_region_t *region, jsval_t value, uint8_t *buf, size_t cap, size_t *len_ptr)
 {
 	if (value.kind == JSVAL_KIND_STRING_JSSTR8) {
@@ -30642,48 +33706,74 @@ size_t jsval_array_length(jsval_region_t *region, jsval_t array)
 	return 0;
 }
 
-static int jsval_native_object_find_utf8(jsval_region_t *region,
+/* Same native node: an interned key, or the same symbol. */
+static int jsval_native_object_name_is(jsval_cell_t name, jsval_cell_t key)
+{
+#if JSMX_WITH_NAN_BOXING
+	return name == key;
+#else
+	return name.repr == JSVAL_REPR_NATIVE && key.repr == JSVAL_REPR_NATIVE
+			&& name.kind == key.kind && name.off == key.off;
+#endif
+}
+
+static int jsval_native_object_name_eq_utf8(jsval_region_t *region,
+		jsval_t name, const uint8_t *key, size_t key_len)
+{
+	if (name.kind == JSVAL_KIND_STRING_JSSTR8) {
+		jsval_native_string_jsstr8_t *s8 = jsval_native_string_jsstr8(region, name);
+
+		return s8 != NULL && s8->len == key_len && (key_len == 0
+				|| memcmp(jsval_native_string_jsstr8_bytes_inline(s8), key,
+					key_len) == 0);
+	}
+	return name.kind == JSVAL_KIND_STRING
+			&& jsval_native_string_eq_utf8(region, name, key, key_len);
+}
+
+/* `hash_ptr` carries a precomputed jsval_key_hash_utf8 of `key`, or is
+ * NULL to hash only when the object is indexed. */
+static int jsval_native_object_find_utf8_hashed(jsval_region_t *region,
 		jsval_native_object_t *native, const uint8_t *key, size_t key_len,
-		size_t *index_ptr)
+		const uint32_t *hash_ptr, size_t *index_ptr)
 {
 	size_t i;
 	jsval_native_prop_t *props;
+	uint32_t *index;
 
 	if (native == NULL) {
 		errno = EINVAL;
 		return -1;
 	}
+	if (native->shape_off != 0) {
+		/* Slot i holds the shape's prop i. */
+		native = jsval_native_object_shape(region, native);
+	}
 
 	props = jsval_native_object_props(native);
-	for (i = 0; i < native->len; i++) {
-		jsval_t name = props[i].name;
-
-		if (name.kind == JSVAL_KIND_STRING_JSSTR8) {
-			jsval_native_string_jsstr8_t *s8 = jsval_native_string_jsstr8(region, name);
-			const uint8_t *bytes;
-
-			if (s8 == NULL || s8->len != key_len) {
-				continue;
-			}
-			if (key_len == 0) {
-				if (index_ptr != NULL) {
-					*index_ptr = i;
-				}
-				return 1;
-			}
-			bytes = jsval_native_string_jsstr8_bytes_inline(s8);
-			if (memcmp(bytes, key, key_len) == 0) {
+	index = jsval_native_object_index(native);
+	if (index != NULL) {
+		uint32_t mask = (uint32_t)(jsval_native_object_index_cap(native->cap) - 1);
+		uint32_t hash = hash_ptr != NULL ? *hash_ptr
+				: jsval_key_hash_utf8(key, key_len);
+		uint32_t slot;
+
+		for (slot = hash & mask; index[slot * 2 + 1] != 0;
+				slot = (slot + 1) & mask) {
+			if (index[slot * 2] == hash && jsval_native_object_name_eq_utf8(
+					region, jsval_cell_unpack(region,
+						props[index[slot * 2 + 1] - 1].name), key, key_len)) {
 				if (index_ptr != NULL) {
-					*index_ptr = i;
+					*index_ptr = index[slot * 2 + 1] - 1;
 				}
 				return 1;
 			}
-			continue;
-		}
-		if (name.kind != JSVAL_KIND_STRING) {
-			continue;
 		}
-		if (jsval_native_string_eq_utf8(region, name, key, key_len)) {
+		return 0;
+	}
+	for (i = 0; i < native->len; i++) {
+		if (jsval_native_object_name_eq_utf8(region,
+				jsval_cell_unpack(region, props[i].name), key, key_len)) {
 			if (index_ptr != NULL) {
 				*index_ptr = i;
 			}
@@ -30694,21 +33784,69 @@ static int jsval_native_object_find_utf8(jsval_region_t *region,
 	return 0;
 }
 
+static int jsval_native_object_find_utf8(jsval_region_t *region,
+		jsval_native_object_t *native, const uint8_t *key, size_t key_len,
+		size_t *index_ptr)
+{
+	return jsval_native_object_find_utf8_hashed(region, native, key, key_len,
+			NULL, index_ptr);
+}
+
 static int
 jsval_native_object_find_key(jsval_region_t *region, jsval_native_object_t *native,
 		jsval_t key, size_t *index_ptr)
 {
 	size_t i;
 	jsval_native_prop_t *props;
+	jsval_cell_t key_cell;
+	uint32_t *index;
 
 	if (native == NULL || !jsval_key_is_property_name(key)) {
 		errno = EINVAL;
 		return -1;
 	}
+	key_cell = jsval_cell_pack(key);
+	if (native->shape_off != 0) {
+		native = jsval_native_object_shape(region, native);
+	}
 
 	props = jsval_native_object_props(native);
+	index = jsval_native_object_index(native);
+	if (index != NULL) {
+		uint32_t mask = (uint32_t)(jsval_native_object_index_cap(native->cap) - 1);
+		uint32_t hash;
+		uint32_t slot;
+
+		if (jsval_key_hash(region, key, &hash) < 0) {
+			return -1;
+		}
+		for (slot = hash & mask; index[slot * 2 + 1] != 0;
+				slot = (slot + 1) & mask) {
+			jsval_cell_t name = props[index[slot * 2 + 1] - 1].name;
+
+			if (index[slot * 2] == hash && (jsval_native_object_name_is(name,
+					key_cell) || jsval_strict_eq(region,
+						jsval_cell_unpack(region, name), key) == 1)) {
+				if (index_ptr != NULL) {
+					*index_ptr = index[slot * 2 + 1] - 1;
+				}
+				return 1;
+			}
+		}
+		return 0;
+	}
+	/* An atom key matches its own prop by offset; try that first. */
+	for (i = 0; i < native->len; i++) {
+		if (jsval_native_object_name_is(props[i].name, key_cell)) {
+			if (index_ptr != NULL) {
+				*index_ptr = i;
+			}
+			return 1;
+		}
+	}
 	for (i = 0; i < native->len; i++) {
-		if (jsval_strict_eq(region, props[i].name, key) == 1) {
+		if (jsval_strict_eq(region, jsval_cell_unpack(region, props[i].name),
+				key) == 1) {
 			if (index_ptr != NULL) {
 				*index_ptr = i;
 			}
@@ -30814,30 +33952,11 @@ int jsval_object_has_own_utf8(jsval_region_t *region, jsval_t object,
 	}
 
 	if (object.repr == JSVAL_REPR_JSON) {
-		int cursor;
-		unsigned int i;
-		jsval_json_doc_t *doc = jsval_json_doc(region, object);
-		jsmntok_t *tokens = jsval_json_doc_tokens(region, doc);
-
-		cursor = (int)object.as.index + 1;
-		for (i = 0; i < (unsigned int)tokens[object.as.index].size; i++) {
-			int key_index = cursor;
-			int value_index = jsval_json_next(region, doc, key_index);
-
-			if (value_index < 0) {
-				break;
-			}
-			if (jsval_json_string_eq_utf8(region, doc, key_index, key, key_len)) {
-				*has_ptr = 1;
-				return 0;
-			}
-			cursor = jsval_json_next(region, doc, value_index);
-			if (cursor < 0) {
-				break;
-			}
-		}
+		uint32_t value_index;
 
-		*has_ptr = 0;
+		*has_ptr = jsval_json_object_find_utf8(region,
+				jsval_json_doc(region, object), object.as.index, key, key_len,
+				&value_index);
 		return 0;
 	}
 
@@ -30845,7 +33964,9 @@ int jsval_object_has_own_utf8(jsval_region_t *region, jsval_t object,
 	return -1;
 }
 
-int jsval_object_get_utf8(jsval_region_t *region, jsval_t object, const uint8_t *key, size_t key_len, jsval_t *value_ptr)
+static int jsval_object_get_utf8_internal(jsval_region_t *region,
+		jsval_t object, const uint8_t *key, size_t key_len,
+		const uint32_t *hash_ptr, jsval_t *value_ptr)
 {
 	if (value_ptr == NULL) {
 		errno = EINVAL;
@@ -30858,17 +33979,17 @@ int jsval_object_get_utf8(jsval_region_t *region, jsval_t object, const uint8_t
 
 	if (object.repr == JSVAL_REPR_NATIVE) {
 		jsval_native_object_t *native = jsval_native_object(region, object);
-		jsval_native_prop_t *props;
 		size_t index;
 		int found;
 
-		found = jsval_native_object_find_utf8(region, native, key, key_len, &index);
+		found = jsval_native_object_find_utf8_hashed(region, native, key,
+				key_len, hash_ptr, &index);
 		if (found < 0) {
 			return -1;
 		}
-		props = jsval_native_object_props(native);
 		if (found) {
-			*value_ptr = props[index].value;
+			*value_ptr = jsval_cell_unpack(region,
+					*jsval_native_object_value_at(native, index));
 			return 0;
 		}
 
@@ -30877,26 +33998,12 @@ int jsval_object_get_utf8(jsval_region_t *region, jsval_t object, const uint8_t
 	}
 
 	if (object.repr == JSVAL_REPR_JSON) {
-		int cursor;
-		unsigned int i;
-		jsval_json_doc_t *doc = jsval_json_doc(region, object);
-		jsmntok_t *tokens = jsval_json_doc_tokens(region, doc);
+		uint32_t value_index;
 
-		cursor = (int)object.as.index + 1;
-		for (i = 0; i < (unsigned int)tokens[object.as.index].size; i++) {
-			int key_index = cursor;
-			int value_index = jsval_json_next(region, doc, key_index);
-			if (value_index < 0) {
-				break;
-			}
-			if (jsval_json_string_eq_utf8(region, doc, key_index, key, key_len)) {
-				*value_ptr = jsval_json_value(region, object, (uint32_t)value_index);
-				return 0;
-			}
-			cursor = jsval_json_next(region, doc, value_index);
-			if (cursor < 0) {
-				break;
-			}
+		if (jsval_json_object_find_utf8(region, jsval_json_doc(region, object),
+				object.as.index, key, key_len, &value_index)) {
+			*value_ptr = jsval_json_value(region, object, value_index);
+			return 0;
 		}
 
 		*value_ptr = jsval_undefined();
@@ -30907,6 +34014,37 @@ int jsval_object_get_utf8(jsval_region_t *region, jsval_t object, const uint8_t
 	return -1;
 }
 
+int jsval_object_get_utf8(jsval_region_t *region, jsval_t object, const uint8_t *key, size_t key_len, jsval_t *value_ptr)
+{
+	return jsval_object_get_utf8_internal(region, object, key, key_len, NULL,
+			value_ptr);
+}
+
+int jsval_object_get_utf8_hashed(jsval_region_t *region, jsval_t object,
+		const uint8_t *key, size_t key_len, uint32_t hash,
+		jsval_t *value_ptr)
+{
+	return jsval_object_get_utf8_internal(region, object, key, key_len, &hash,
+			value_ptr);
+}
+
+int jsval_atom_utf8(jsval_region_t *region, const uint8_t *key,
+		size_t key_len, jsval_t *atom_ptr)
+{
+	if (!jsval_region_valid(region) || atom_ptr == NULL
+			|| (key_len > 0 && key == NULL)) {
+		errno = EINVAL;
+		return -1;
+	}
+	return jsval_atom_intern(region, key, key_len,
+			jsval_key_hash_utf8(key, key_len), atom_ptr);
+}
+
+uint32_t jsval_atom_hash(const uint8_t *key, size_t key_len)
+{
+	return jsval_key_hash_utf8(key, key_len);
+}
+
 int jsval_object_has_own_key(jsval_region_t *region, jsval_t object,
 		jsval_t key, int *has_ptr)
 {
@@ -30973,7 +34111,6 @@ int jsval_object_get_key(jsval_region_t *region, jsval_t object, jsval_t key,
 
 	if (object.repr == JSVAL_REPR_NATIVE) {
 		jsval_native_object_t *native = jsval_native_object(region, object);
-		jsval_native_prop_t *props;
 		size_t index;
 		int found;
 
@@ -30985,8 +34122,8 @@ int jsval_object_get_key(jsval_region_t *region, jsval_t object, jsval_t key,
 			*value_ptr = jsval_undefined();
 			return 0;
 		}
-		props = jsval_native_object_props(native);
-		*value_ptr = props[index].value;
+		*value_ptr = jsval_cell_unpack(region,
+				*jsval_native_object_value_at(native, index));
 		return 0;
 	}
 
@@ -31033,8 +34170,6 @@ int jsval_object_key_at(jsval_region_t *region, jsval_t object, size_t index,
 
 	if (object.repr == JSVAL_REPR_NATIVE) {
 		jsval_native_object_t *native = jsval_native_object(region, object);
-		jsval_native_prop_t *props;
-		jsval_t key = jsval_undefined();
 
 		if (native == NULL) {
 			errno = EINVAL;
@@ -31044,9 +34179,7 @@ int jsval_object_key_at(jsval_region_t *region, jsval_t object, size_t index,
 			*key_ptr = jsval_undefined();
 			return 0;
 		}
-		props = jsval_native_object_props(native);
-		key = props[index].name;
-		*key_ptr = key;
+		*key_ptr = jsval_native_object_name_at(region, native, index);
 		return 0;
 	}
 
@@ -31097,7 +34230,6 @@ int jsval_object_value_at(jsval_region_t *region, jsval_t object, size_t index,
 
 	if (object.repr == JSVAL_REPR_NATIVE) {
 		jsval_native_object_t *native = jsval_native_object(region, object);
-		jsval_native_prop_t *props;
 
 		if (native == NULL) {
 			errno = EINVAL;
@@ -31107,8 +34239,8 @@ int jsval_object_value_at(jsval_region_t *region, jsval_t object, size_t index,
 			*value_ptr = jsval_undefined();
 			return 0;
 		}
-		props = jsval_native_object_props(native);
-		*value_ptr = props[index].value;
+		*value_ptr = jsval_cell_unpack(region,
+				*jsval_native_object_value_at(native, index));
 		return 0;
 	}
 
@@ -31179,6 +34311,7 @@ jsval_object_copy_own(jsval_region_t *region, jsval_t dst, jsval_t src)
 	dst_len = dst_native->len;
 	src_len = jsval_object_size(region, src);
 	if (src_len > 0) {
+		JSVAL_ALLOC_TAG(region, JSVAL_KIND_OBJECT);
 		if (jsval_region_reserve(region, src_len * sizeof(*actions),
 				JSVAL_ALIGN, NULL, (void **)&actions) < 0) {
 			return -1;
@@ -31223,6 +34356,10 @@ jsval_object_copy_own(jsval_region_t *region, jsval_t dst, jsval_t src)
 		actions[i].name = jsval_undefined();
 	}
 
+	if (append_count > 0 && (dst_native = jsval_native_object_unshape(region,
+			dst, append_count)) == NULL) {
+		return -1;
+	}
 	if (dst_len + append_count > dst_native->cap) {
 		errno = ENOBUFS;
 		return -1;
@@ -31241,9 +34378,14 @@ jsval_object_copy_own(jsval_region_t *region, jsval_t dst, jsval_t src)
 	dst_props = jsval_native_object_props(dst_native);
 	for (i = 0; i < src_len; i++) {
 		if (actions[i].append) {
-			dst_props[actions[i].index].name = actions[i].name;
+			dst_props[actions[i].index].name = jsval_cell_pack(actions[i].name);
+			if (jsval_native_object_index_add(region, dst_native,
+					actions[i].index) < 0) {
+				return -1;
+			}
 		}
-		dst_props[actions[i].index].value = actions[i].value;
+		*jsval_native_object_value_at(dst_native, actions[i].index) =
+				jsval_cell_pack(actions[i].value);
 	}
 	dst_native->len = dst_len + append_count;
 	return 0;
@@ -31306,16 +34448,18 @@ int jsval_object_set_key(jsval_region_t *region, jsval_t object, jsval_t key,
 		return -1;
 	}
 
-	props = jsval_native_object_props(native);
 	found = jsval_native_object_find_key(region, native, key, &index);
 	if (found < 0) {
 		return -1;
 	}
 	if (found) {
-		props[index].value = value;
+		*jsval_native_object_value_at(native, index) = jsval_cell_pack(value);
 		return 0;
 	}
 
+	if ((native = jsval_native_object_unshape(region, object, 1)) == NULL) {
+		return -1;
+	}
 	if (native->len >= native->cap) {
 		errno = ENOBUFS;
 		return -1;
@@ -31323,8 +34467,12 @@ int jsval_object_set_key(jsval_region_t *region, jsval_t object, jsval_t key,
 	if (jsval_object_key_to_native(region, key, &name) < 0) {
 		return -1;
 	}
-	props[native->len].name = name;
-	props[native->len].value = value;
+	props = jsval_native_object_props(native);
+	props[native->len].name = jsval_cell_pack(name);
+	props[native->len].value = jsval_cell_pack(value);
+	if (jsval_native_object_index_add(region, native, native->len) < 0) {
+		return -1;
+	}
 	native->len++;
 	return 0;
 }
@@ -31332,6 +34480,7 @@ int jsval_object_set_key(jsval_region_t *region, jsval_t object, jsval_t key,
 int jsval_object_set_utf8(jsval_region_t *region, jsval_t object, const uint8_t *key, size_t key_len, jsval_t value)
 {
 	size_t index;
+	uint32_t hash;
 	jsval_native_object_t *native;
 	jsval_native_prop_t *props;
 	int found;
@@ -31347,16 +34496,20 @@ int jsval_object_set_utf8(jsval_region_t *region, jsval_t object, const uint8_t
 		return -1;
 	}
 
-	props = jsval_native_object_props(native);
-	found = jsval_native_object_find_utf8(region, native, key, key_len, &index);
+	hash = jsval_key_hash_utf8(key, key_len);
+	found = jsval_native_object_find_utf8_hashed(region, native, key, key_len,
+			&hash, &index);
 	if (found < 0) {
 		return -1;
 	}
 	if (found) {
-		props[index].value = value;
+		*jsval_native_object_value_at(native, index) = jsval_cell_pack(value);
 		return 0;
 	}
 
+	if ((native = jsval_native_object_unshape(region, object, 1)) == NULL) {
+		return -1;
+	}
 	if (native->len >= native->cap) {
 		errno = ENOBUFS;
 		return -1;
@@ -31364,11 +34517,15 @@ int jsval_object_set_utf8(jsval_region_t *region, jsval_t object, const uint8_t
 
 	{
 		jsval_t name;
-		if (jsval_string_jsstr8_new_bytes(region, key, key_len, &name) < 0) {
+		if (jsval_atom_intern(region, key, key_len, hash, &name) < 0) {
+			return -1;
+		}
+		props = jsval_native_object_props(native);
+		props[native->len].name = jsval_cell_pack(name);
+		props[native->len].value = jsval_cell_pack(value);
+		if (jsval_native_object_index_add(region, native, native->len) < 0) {
 			return -1;
 		}
-		props[native->len].name = name;
-		props[native->len].value = value;
 		native->len++;
 	}
 
@@ -31419,14 +34576,20 @@ int jsval_object_delete_key(jsval_region_t *region, jsval_t object,
 		*deleted_ptr = 0;
 		return 0;
 	}
+	if ((native = jsval_native_object_unshape(region, object, 0)) == NULL) {
+		return -1;
+	}
 
 	props = jsval_native_object_props(native);
 	for (i = index + 1; i < native->len; i++) {
 		props[i - 1] = props[i];
 	}
-	props[native->len - 1].name = jsval_undefined();
-	props[native->len - 1].value = jsval_undefined();
+	props[native->len - 1].name = jsval_cell_pack(jsval_undefined());
+	props[native->len - 1].value = jsval_cell_pack(jsval_undefined());
 	native->len--;
+	if (jsval_native_object_index_rebuild(region, native) < 0) {
+		return -1;
+	}
 	*deleted_ptr = 1;
 	return 0;
 }
@@ -31467,14 +34630,20 @@ int jsval_object_delete_utf8(jsval_region_t *region, jsval_t object,
 		*deleted_ptr = 0;
 		return 0;
 	}
+	if ((native = jsval_native_object_unshape(region, object, 0)) == NULL) {
+		return -1;
+	}
 
 	props = jsval_native_object_props(native);
 	for (i = index + 1; i < native->len; i++) {
 		props[i - 1] = props[i];
 	}
-	props[native->len - 1].name = jsval_undefined();
-	props[native->len - 1].value = jsval_undefined();
+	props[native->len - 1].name = jsval_cell_pack(jsval_undefined());
+	props[native->len - 1].value = jsval_cell_pack(jsval_undefined());
 	native->len--;
+	if (jsval_native_object_index_rebuild(region, native) < 0) {
+		return -1;
+	}
 	*deleted_ptr = 1;
 	return 0;
 }
@@ -31536,7 +34705,8 @@ int jsval_array_get(jsval_region_t *region, jsval_t array, size_t index, jsval_t
 			*value_ptr = jsval_undefined();
 			return 0;
 		}
-		*value_ptr = jsval_native_array_values(native)[index];
+		*value_ptr = jsval_cell_unpack(region,
+				jsval_native_array_values(native)[index]);
 		return 0;
 	}
 
@@ -31545,12 +34715,22 @@ int jsval_array_get(jsval_region_t *region, jsval_t array, size_t index, jsval_t
 		size_t i;
 		jsval_json_doc_t *doc = jsval_json_doc(region, array);
 		jsmntok_t *tokens = jsval_json_doc_tokens(region, doc);
+		const uint32_t *elements;
 
 		if (index >= (size_t)tokens[array.as.index].size) {
 			*value_ptr = jsval_undefined();
 			return 0;
 		}
 
+		if (index > 0) {
+			elements = jsval_json_array_elements(region, doc,
+					array.as.index);
+			if (elements != NULL) {
+				*value_ptr = jsval_json_value(region, array, elements[index]);
+				return 0;
+			}
+		}
+
 		cursor = (int)array.as.index + 1;
 		for (i = 0; i < index; i++) {
 			cursor = jsval_json_next(region, doc, cursor);
@@ -31572,7 +34752,7 @@ int jsval_array_set(jsval_region_t *region, jsval_t array, size_t index, jsval_t
 {
 	size_t i;
 	jsval_native_array_t *native;
-	jsval_t *values;
+	jsval_cell_t *values;
 
 	if (array.kind != JSVAL_KIND_ARRAY || array.repr != JSVAL_REPR_NATIVE) {
 		errno = ENOTSUP;
@@ -31591,9 +34771,9 @@ int jsval_array_set(jsval_region_t *region, jsval_t array, size_t index, jsval_t
 
 	values = jsval_native_array_values(native);
 	for (i = native->len; i < index; i++) {
-		values[i] = jsval_undefined();
+		values[i] = jsval_cell_pack(jsval_undefined());
 	}
-	values[index] = value;
+	values[index] = jsval_cell_pack(value);
 	if (index >= native->len) {
 		native->len = index + 1;
 	}
@@ -31622,7 +34802,7 @@ int jsval_array_splice_dense(jsval_region_t *region, jsval_t array, size_t start
 		jsval_t *removed_ptr)
 {
 	jsval_native_array_t *native;
-	jsval_t *values;
+	jsval_cell_t *values;
 	jsval_t removed;
 	size_t len;
 	size_t effective_start;
@@ -31675,7 +34855,7 @@ int jsval_array_splice_dense(jsval_region_t *region, jsval_t array, size_t start
 	values = jsval_native_array_values(native);
 	for (i = 0; i < effective_delete_count; i++) {
 		if (jsval_array_set(region, removed, i,
-				values[effective_start + i]) < 0) {
+				jsval_cell_unpack(region, values[effective_start + i])) < 0) {
 			return -1;
 		}
 	}
@@ -31687,11 +34867,11 @@ int jsval_array_splice_dense(jsval_region_t *region, jsval_t array, size_t start
 				suffix_count * sizeof(*values));
 	}
 	for (i = 0; i < insert_count; i++) {
-		values[effective_start + i] = inserts[i];
+		values[effective_start + i] = jsval_cell_pack(inserts[i]);
 	}
 	if (new_len < len) {
 		for (i = new_len; i < len; i++) {
-			values[i] = jsval_undefined();
+			values[i] = jsval_cell_pack(jsval_undefined());
 		}
 	}
 
@@ -31703,7 +34883,7 @@ int jsval_array_splice_dense(jsval_region_t *region, jsval_t array, size_t start
 int jsval_array_pop(jsval_region_t *region, jsval_t array, jsval_t *value_ptr)
 {
 	jsval_native_array_t *native;
-	jsval_t *values;
+	jsval_cell_t *values;
 	size_t index;
 
 	if (value_ptr == NULL) {
@@ -31731,8 +34911,8 @@ int jsval_array_pop(jsval_region_t *region, jsval_t array, jsval_t *value_ptr)
 
 	index = native->len - 1;
 	values = jsval_native_array_values(native);
-	*value_ptr = values[index];
-	values[index] = jsval_undefined();
+	*value_ptr = jsval_cell_unpack(region, values[index]);
+	values[index] = jsval_cell_pack(jsval_undefined());
 	native->len = index;
 	return 0;
 }
@@ -31740,7 +34920,7 @@ int jsval_array_pop(jsval_region_t *region, jsval_t array, jsval_t *value_ptr)
 int jsval_array_shift(jsval_region_t *region, jsval_t array, jsval_t *value_ptr)
 {
 	jsval_native_array_t *native;
-	jsval_t *values;
+	jsval_cell_t *values;
 
 	if (value_ptr == NULL) {
 		errno = EINVAL;
@@ -31766,19 +34946,19 @@ int jsval_array_shift(jsval_region_t *region, jsval_t array, jsval_t *value_ptr)
 	}
 
 	values = jsval_native_array_values(native);
-	*value_ptr = values[0];
+	*value_ptr = jsval_cell_unpack(region, values[0]);
 	if (native->len > 1) {
 		memmove(values, values + 1, (native->len - 1) * sizeof(*values));
 	}
 	native->len--;
-	values[native->len] = jsval_undefined();
+	values[native->len] = jsval_cell_pack(jsval_undefined());
 	return 0;
 }
 
 int jsval_array_unshift(jsval_region_t *region, jsval_t array, jsval_t value)
 {
 	jsval_native_array_t *native;
-	jsval_t *values;
+	jsval_cell_t *values;
 
 	if (array.kind != JSVAL_KIND_ARRAY) {
 		errno = EINVAL;
@@ -31803,7 +34983,7 @@ int jsval_array_unshift(jsval_region_t *region, jsval_t array, jsval_t value)
 	if (native->len > 0) {
 		memmove(values + 1, values, native->len * sizeof(*values));
 	}
-	values[0] = value;
+	values[0] = jsval_cell_pack(value);
 	native->len++;
 	return 0;
 }
@@ -31811,7 +34991,7 @@ int jsval_array_unshift(jsval_region_t *region, jsval_t array, jsval_t value)
 int jsval_array_set_length(jsval_region_t *region, jsval_t array, size_t new_len)
 {
 	jsval_native_array_t *native;
-	jsval_t *values;
+	jsval_cell_t *values;
 	size_t i;
 
 	if (array.kind != JSVAL_KIND_ARRAY) {
@@ -31836,11 +35016,11 @@ int jsval_array_set_length(jsval_region_t *region, jsval_t array, size_t new_len
 	values = jsval_native_array_values(native);
 	if (new_len < native->len) {
 		for (i = new_len; i < native->len; i++) {
-			values[i] = jsval_undefined();
+			values[i] = jsval_cell_pack(jsval_undefined());
 		}
 	} else if (new_len > native->len) {
 		for (i = native->len; i < new_len; i++) {
-			values[i] = jsval_undefined();
+			values[i] = jsval_cell_pack(jsval_undefined());
 		}
 	}
 	native->len = new_len;
@@ -31911,6 +35091,7 @@ static int jsval_url_attach_search_params(jsval_region_t *region,
 		}
 		return 0;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_URL_SEARCH_PARAMS);
 	if (jsval_region_alloc(region, sizeof(*params_native),
 			_Alignof(jsval_native_url_search_params_t), &ptr) < 0) {
 		return -1;
@@ -31942,6 +35123,7 @@ static int jsval_url_alloc_native(jsval_region_t *region,
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_URL);
 	if (jsval_region_alloc(region, sizeof(*native),
 			_Alignof(jsval_native_url_t), &ptr) < 0) {
 		return -1;
@@ -31987,6 +35169,7 @@ static int jsval_url_search_params_alloc_detached(jsval_region_t *region,
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_URL_SEARCH_PARAMS);
 	if (jsval_region_alloc(region, sizeof(*native),
 			_Alignof(jsval_native_url_search_params_t), &ptr) < 0) {
 		return -1;
@@ -34311,6 +37494,7 @@ int jsval_add(jsval_region_t *region, jsval_t left, jsval_t right, jsval_t *valu
 		}
 
 		total_len = left_len + right_len;
+		JSVAL_ALLOC_TAG(region, JSVAL_KIND_STRING);
 		if (jsval_region_reserve(region, sizeof(*string) + total_len * sizeof(uint16_t), JSVAL_ALIGN, &off, (void **)&string) < 0) {
 			return -1;
 		}
@@ -35445,12 +38629,32 @@ jsval_method_string_search_regex(jsval_region_t *region,
 }
 #endif
 
+/* Reserve what jsval_atom_intern takes for a new key, against the
+ * simulated table size in *count_ptr / *cap_ptr. */
+static int jsval_atom_measure(const jsval_region_t *region, size_t *used_ptr,
+		size_t key_len, size_t *count_ptr, size_t *cap_ptr)
+{
+	if (*cap_ptr == 0 || (*count_ptr + 1) * 2 > *cap_ptr) {
+		size_t cap = *cap_ptr != 0 ? *cap_ptr * 2 : JSVAL_ATOM_TABLE_MIN_CAP;
+
+		if (jsval_region_measure_reserve(region, used_ptr,
+				jsval_atom_table_bytes(cap), JSVAL_ALIGN) < 0) {
+			return -1;
+		}
+		*cap_ptr = cap;
+	}
+	(*count_ptr)++;
+	return jsval_string_measure_jsstr8(region, used_ptr, key_len);
+}
+
 int jsval_promote_object_shallow_measure(jsval_region_t *region, jsval_t object,
 		size_t prop_cap, size_t *bytes_ptr)
 {
 	size_t start_used;
 	size_t used;
 	size_t len;
+	size_t atom_count;
+	size_t atom_cap;
 
 	if (!jsval_region_valid(region) || bytes_ptr == NULL) {
 		errno = EINVAL;
@@ -35488,7 +38692,7 @@ int jsval_promote_object_shallow_measure(jsval_region_t *region, jsval_t object,
 	}
 
 	if (prop_cap > (SIZE_MAX - sizeof(jsval_native_object_t)) /
-			sizeof(jsval_native_prop_t)) {
+			(sizeof(jsval_native_prop_t) + 8 * sizeof(uint32_t))) {
 		errno = EOVERFLOW;
 		return -1;
 	}
@@ -35496,10 +38700,15 @@ int jsval_promote_object_shallow_measure(jsval_region_t *region, jsval_t object,
 	used = region->pages->used_len;
 	start_used = used;
 	if (jsval_region_measure_reserve(region, &used,
-			sizeof(jsval_native_object_t) + prop_cap * sizeof(jsval_native_prop_t),
-			JSVAL_ALIGN) < 0) {
+			jsval_native_object_bytes(prop_cap), JSVAL_ALIGN) < 0) {
 		return -1;
 	}
+	{
+		uint32_t *table = jsval_atom_table(region);
+
+		atom_count = table != NULL ? table[1] : 0;
+		atom_cap = table != NULL ? (size_t)table[0] + 1 : 0;
+	}
 
 	{
 		int cursor;
@@ -35517,15 +38726,32 @@ int jsval_promote_object_shallow_measure(jsval_region_t *region, jsval_t object,
 				errno = EINVAL;
 				return -1;
 			}
-			/* Match the in_place path: keys land as JSSTR8 via
+			/* Match the in_place path: keys land as JSSTR8 atoms via
 			 * jsval_object_set_utf8 (post JSSTR8 transpilation),
-			 * not as UTF-16 native strings. */
+			 * not as UTF-16 native strings. Keys already interned
+			 * cost nothing; a repeated key inside the object is
+			 * counted twice, which only overestimates. */
 			if (jsval_json_string_copy_utf8_internal(region, doc,
 					(uint32_t)key_index, NULL, 0, &key_utf8_len) < 0) {
 				return -1;
 			}
-			if (jsval_string_measure_jsstr8(region, &used, key_utf8_len) < 0) {
-				return -1;
+			{
+				uint8_t key_buf[key_utf8_len ? key_utf8_len : 1];
+				jsval_off_t atom_off;
+
+				if (key_utf8_len > 0
+						&& jsval_json_string_copy_utf8_internal(region, doc,
+							(uint32_t)key_index, key_buf, key_utf8_len,
+							NULL) < 0) {
+					return -1;
+				}
+				if (!jsval_atom_find(region, key_buf, key_utf8_len,
+						jsval_key_hash_utf8(key_buf, key_utf8_len),
+						&atom_off)
+						&& jsval_atom_measure(region, &used, key_utf8_len,
+							&atom_count, &atom_cap) < 0) {
+					return -1;
+				}
 			}
 
 			cursor = jsval_json_next(region, doc, value_index);
@@ -35690,7 +38916,8 @@ int jsval_promote_array_shallow_measure(jsval_region_t *region, jsval_t array,
 		errno = EINVAL;
 		return -1;
 	}
-	if (elem_cap > (SIZE_MAX - sizeof(jsval_native_array_t)) / sizeof(jsval_t)) {
+	if (elem_cap > (SIZE_MAX - sizeof(jsval_native_array_t))
+			/ sizeof(jsval_cell_t)) {
 		errno = EOVERFLOW;
 		return -1;
 	}
@@ -35698,7 +38925,7 @@ int jsval_promote_array_shallow_measure(jsval_region_t *region, jsval_t array,
 	used = region->pages->used_len;
 	start_used = used;
 	if (jsval_region_measure_reserve(region, &used,
-			sizeof(jsval_native_array_t) + elem_cap * sizeof(jsval_t),
+			sizeof(jsval_native_array_t) + elem_cap * sizeof(jsval_cell_t),
 			JSVAL_ALIGN) < 0) {
 		return -1;
 	}
@@ -35749,7 +38976,9 @@ int jsval_promote_array_shallow(jsval_region_t *region, jsval_t array,
 	{
 		size_t needed;
 		size_t i;
+		int cursor;
 		jsval_t out;
+		jsval_json_doc_t *doc = jsval_json_doc(region, array);
 
 		if (jsval_promote_array_shallow_measure(region, array, elem_cap,
 				&needed) < 0) {
@@ -35759,12 +38988,16 @@ int jsval_promote_array_shallow(jsval_region_t *region, jsval_t array,
 		if (jsval_array_new(region, elem_cap, &out) < 0) {
 			return -1;
 		}
+		cursor = (int)array.as.index + 1;
 		for (i = 0; i < len; i++) {
 			jsval_t child;
 
-			if (jsval_array_get(region, array, i, &child) < 0) {
+			if (cursor < 0) {
+				errno = EINVAL;
 				return -1;
 			}
+			child = jsval_json_value(region, array, (uint32_t)cursor);
+			cursor = jsval_json_next(region, doc, cursor);
 			if (jsval_array_set(region, out, i, child) < 0) {
 				return -1;
 			}
@@ -35839,18 +39072,23 @@ int jsval_promote(jsval_region_t *region, jsval_t value, jsval_t *value_ptr)
 	{
 		size_t len = jsval_array_length(region, value);
 		size_t i;
+		int cursor;
 		jsval_t array;
 
 		if (jsval_array_new(region, len, &array) < 0) {
 			return -1;
 		}
+		cursor = (int)value.as.index + 1;
 		for (i = 0; i < len; i++) {
 			jsval_t child;
 			jsval_t promoted;
 
-			if (jsval_array_get(region, value, i, &child) < 0) {
+			if (cursor < 0) {
+				errno = EINVAL;
 				return -1;
 			}
+			child = jsval_json_value(region, value, (uint32_t)cursor);
+			cursor = jsval_json_next(region, doc, cursor);
 			if (jsval_promote(region, child, &promoted) < 0) {
 				return -1;
 			}
@@ -35953,6 +39191,636 @@ int jsval_region_promote_root(jsval_region_t *region, jsval_t *value_ptr)
 	return 0;
 }
 
+/*
+ * Evacuating compaction.
+ *
+ * Reachable nodes are copied breadth-first into dst. A forwarding
+ * table (insertion-ordered entries plus an open-addressed index keyed
+ * by source offset) lives in a scratch block at the top of dst, which
+ * is fenced off by lowering dst's total_len while the copy runs; the
+ * entries double as the Cheney scan queue, so tracing needs no
+ * recursion. src is only read.
+ */
+typedef struct jsval_compact_entry_s {
+	jsval_off_t src_off;
+	jsval_off_t dst_off;
+	uint8_t kind;
+	uint8_t repr;
+	uint8_t reserved[2];
+} jsval_compact_entry_t;
+
+typedef struct jsval_compact_s {
+	jsval_region_t *src;
+	jsval_region_t *dst;
+	size_t top;
+	uint32_t *slots;
+	jsval_compact_entry_t *entries;
+	size_t cap;
+	size_t count;
+	int image;
+} jsval_compact_t;
+
+#define JSVAL_COMPACT_INITIAL_CAP 64u
+
+static size_t jsval_compact_block_size(size_t cap)
+{
+	return cap * 2 * sizeof(uint32_t) + cap * sizeof(jsval_compact_entry_t);
+}
+
+static uint32_t jsval_compact_hash(jsval_off_t off)
+{
+	uint32_t h = off >> 2;
+
+	h ^= h >> 16;
+	h *= 0x45d9f3bu;
+	h ^= h >> 16;
+	return h;
+}
+
+static void jsval_compact_index(jsval_compact_t *compact, size_t i)
+{
+	uint32_t mask = (uint32_t)(compact->cap * 2 - 1);
+	uint32_t slot = jsval_compact_hash(compact->entries[i].src_off) & mask;
+
+	while (compact->slots[slot] != 0) {
+		slot = (slot + 1) & mask;
+	}
+	compact->slots[slot] = (uint32_t)i + 1;
+}
+
+/* Place a table of `cap` entries at the top of dst, moving any
+ * existing entries into it. */
+static int jsval_compact_grow(jsval_compact_t *compact, size_t cap)
+{
+	size_t need = jsval_compact_block_size(cap);
+	size_t used = compact->dst->pages->used_len;
+	size_t old_lo = compact->dst->pages->total_len;
+	size_t lo;
+	size_t final_lo;
+	uint32_t *slots;
+	jsval_compact_entry_t *entries;
+	size_t i;
+
+	if (need > old_lo || (old_lo - need) / JSVAL_ALIGN * JSVAL_ALIGN < used) {
+		errno = ENOBUFS;
+		return -1;
+	}
+	lo = (old_lo - need) / JSVAL_ALIGN * JSVAL_ALIGN;
+	slots = (uint32_t *)(compact->dst->base + lo);
+	entries = (jsval_compact_entry_t *)(slots + cap * 2);
+	memset(slots, 0, cap * 2 * sizeof(uint32_t));
+	if (compact->count > 0) {
+		memcpy(entries, compact->entries,
+				compact->count * sizeof(*entries));
+	}
+	compact->slots = slots;
+	compact->entries = entries;
+	compact->cap = cap;
+	for (i = 0; i < compact->count; i++) {
+		jsval_compact_index(compact, i);
+	}
+
+	/* Slide the new block up against the top, over the old one. */
+	final_lo = (compact->top - need) / JSVAL_ALIGN * JSVAL_ALIGN;
+	memmove(compact->dst->base + final_lo, slots, need);
+	compact->slots = (uint32_t *)(compact->dst->base + final_lo);
+	compact->entries = (jsval_compact_entry_t *)(compact->slots + cap * 2);
+	compact->dst->pages->total_len = (uint32_t)final_lo;
+	return 0;
+}
+
+static size_t jsval_compact_node_size(jsval_region_t *src, jsval_t value)
+{
+	void *node = jsval_region_ptr(src, value.off);
+
+	switch (value.kind) {
+	case JSVAL_KIND_STRING:
+		return sizeof(jsval_native_string_t)
+				+ ((jsval_native_string_t *)node)->cap * sizeof(uint16_t);
+	case JSVAL_KIND_STRING_JSSTR8:
+		return sizeof(jsval_native_string_jsstr8_t)
+				+ ((jsval_native_string_jsstr8_t *)node)->len;
+	case JSVAL_KIND_SYMBOL:
+		return sizeof(jsval_native_symbol_t);
+	case JSVAL_KIND_BIGINT:
+		return sizeof(jsval_native_bigint_t)
+				+ ((jsval_native_bigint_t *)node)->cap * sizeof(uint32_t);
+	case JSVAL_KIND_FUNCTION:
+		return sizeof(jsval_native_function_t);
+	case JSVAL_KIND_DATE:
+		return sizeof(jsval_native_date_t);
+	case JSVAL_KIND_ARRAY_BUFFER:
+		return sizeof(jsval_native_array_buffer_t)
+				+ ((jsval_native_array_buffer_t *)node)->byte_length;
+	case JSVAL_KIND_TYPED_ARRAY:
+		return sizeof(jsval_native_typed_array_t);
+	case JSVAL_KIND_OBJECT:
+	{
+		jsval_native_object_t *object = (jsval_native_object_t *)node;
+
+		if (object->shape_off != 0) {
+			return sizeof(*object) + object->len * sizeof(jsval_cell_t);
+		}
+		return jsval_native_object_bytes(object->cap);
+	}
+	case JSVAL_KIND_ARRAY:
+		return sizeof(jsval_native_array_t)
+				+ ((jsval_native_array_t *)node)->cap * sizeof(jsval_cell_t);
+	case JSVAL_KIND_SET:
+		return jsval_native_set_bytes(((jsval_native_set_t *)node)->cap);
+	case JSVAL_KIND_MAP:
+		return jsval_native_map_bytes(((jsval_native_map_t *)node)->cap);
+	case JSVAL_KIND_ITERATOR:
+		return sizeof(jsval_native_iterator_t);
+	case JSVAL_KIND_CRYPTO:
+		return sizeof(jsval_native_crypto_t);
+	case JSVAL_KIND_SUBTLE_CRYPTO:
+		return sizeof(jsval_native_subtle_crypto_t);
+	case JSVAL_KIND_CRYPTO_KEY:
+		return sizeof(jsval_native_crypto_key_t);
+	case JSVAL_KIND_DOM_EXCEPTION:
+		return sizeof(jsval_native_dom_exception_t);
+	case JSVAL_KIND_PROMISE:
+		return sizeof(jsval_native_promise_t);
+	case JSVAL_KIND_HEADERS:
+		return sizeof(jsval_native_headers_t)
+				+ ((jsval_native_headers_t *)node)->cap
+				* sizeof(jsval_native_headers_entry_t);
+	default:
+		/* Regexps, URLs, requests, responses and streams hold host
+		 * pointers or queue links that cannot be relocated. */
+		return 0;
+	}
+}
+
+static int jsval_compact_copy_bytes(jsval_region_t *dst, const void *src,
+		size_t len, size_t align, jsval_off_t *off_ptr)
+{
+	void *ptr;
+
+	if (jsval_region_reserve(dst, len ? len : 1, align, off_ptr, &ptr) < 0) {
+		return -1;
+	}
+	if (len > 0) {
+		memcpy(ptr, src, len);
+	}
+	return 0;
+}
+
+/* JSON docs have no outgoing jsval_t edges: copy bytes, tokens and the
+ * skip table at once and let lookup indexes rebuild lazily. */
+static int jsval_compact_copy_doc(jsval_compact_t *compact, jsval_off_t src_off,
+		jsval_off_t *dst_off_ptr)
+{
+	jsval_json_doc_t *src_doc = (jsval_json_doc_t *)jsval_region_ptr(
+			compact->src, src_off);
+	jsval_json_doc_t *doc;
+	jsval_off_t doc_off;
+
+	if (src_doc == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	JSVAL_ALLOC_TAG(compact->dst, JSVAL_ALLOC_CLASS_JSON_DOC);
+	if (jsval_compact_copy_bytes(compact->dst, src_doc, sizeof(*doc),
+			JSVAL_ALIGN, &doc_off) < 0) {
+		return -1;
+	}
+	doc = (jsval_json_doc_t *)(compact->dst->base + doc_off);
+	if (compact->image) {
+		/* An image must not point at the caller's bytes. */
+		doc->borrowed = NULL;
+	}
+	if (doc->borrowed == NULL) {
+		uint8_t *json;
+
+		JSVAL_ALLOC_TAG(compact->dst, JSVAL_ALLOC_CLASS_JSON_SOURCE);
+		if (jsval_region_reserve(compact->dst, src_doc->json_len + 1, 1,
+				&doc->json_off, (void **)&json) < 0) {
+			return -1;
+		}
+		memcpy(json, jsval_json_doc_bytes(compact->src, src_doc),
+				src_doc->json_len);
+		json[src_doc->json_len] = '\0';
+	}
+	JSVAL_ALLOC_TAG(compact->dst, JSVAL_ALLOC_CLASS_JSON_TOKENS);
+	if (jsval_compact_copy_bytes(compact->dst,
+			compact->src->base + src_doc->tokens_off,
+			src_doc->tokused * sizeof(jsmntok_t), JSVAL_ALIGN,
+			&doc->tokens_off) < 0) {
+		return -1;
+	}
+	doc->tokcap = doc->tokused;
+	JSVAL_ALLOC_TAG(compact->dst, JSVAL_ALLOC_CLASS_JSON_TOKENS);
+	if (src_doc->skip_off != 0 && jsval_compact_copy_bytes(compact->dst,
+			compact->src->base + src_doc->skip_off,
+			src_doc->tokused * sizeof(uint32_t), sizeof(uint32_t),
+			&doc->skip_off) < 0) {
+		return -1;
+	}
+	doc->index_off = 0;
+	if (compact->image) {
+		uint32_t i;
+
+		/* A mapped image cannot cache indexes later: build them now. */
+		doc->index_objects = 1;
+		doc->index_arrays = 1;
+		for (i = 0; i < doc->tokused; i++) {
+			(void)jsval_json_array_elements(compact->dst, doc, i);
+			(void)jsval_json_object_index(compact->dst, doc, i);
+		}
+	}
+	*dst_off_ptr = doc_off;
+	return 0;
+}
+
+/* Point *value_ptr at the dst copy of its node, copying it on first
+ * sight and queueing it for its outgoing edges to be scanned. */
+static int jsval_compact_forward(jsval_compact_t *compact, jsval_t *value_ptr)
+{
+	jsval_t value = *value_ptr;
+	uint32_t mask;
+	uint32_t slot;
+	jsval_compact_entry_t *entry;
+	jsval_off_t dst_off;
+	size_t size;
+
+	if (value.repr == JSVAL_REPR_INLINE || value.off == 0) {
+		return 0;
+	}
+	mask = (uint32_t)(compact->cap * 2 - 1);
+	for (slot = jsval_compact_hash(value.off) & mask;
+			compact->slots[slot] != 0; slot = (slot + 1) & mask) {
+		entry = &compact->entries[compact->slots[slot] - 1];
+		if (entry->src_off == value.off) {
+			value_ptr->off = entry->dst_off;
+			return 0;
+		}
+	}
+
+	if (compact->image && value.repr == JSVAL_REPR_NATIVE
+			&& value.kind == JSVAL_KIND_FUNCTION) {
+		errno = ENOTSUP;
+		return -1;
+	}
+	if (value.repr == JSVAL_REPR_JSON) {
+		if (jsval_compact_copy_doc(compact, value.off, &dst_off) < 0) {
+			return -1;
+		}
+	} else {
+		size = jsval_compact_node_size(compact->src, value);
+		if (size == 0) {
+			errno = ENOTSUP;
+			return -1;
+		}
+		JSVAL_ALLOC_TAG(compact->dst, value.kind);
+		if (jsval_compact_copy_bytes(compact->dst,
+				compact->src->base + value.off, size, JSVAL_ALIGN,
+				&dst_off) < 0) {
+			return -1;
+		}
+	}
+
+	if (compact->count >= compact->cap
+			&& jsval_compact_grow(compact, compact->cap * 2) < 0) {
+		return -1;
+	}
+	entry = &compact->entries[compact->count];
+	entry->src_off = value.off;
+	entry->dst_off = dst_off;
+	entry->kind = value.kind;
+	entry->repr = value.repr;
+	memset(entry->reserved, 0, sizeof(entry->reserved));
+	jsval_compact_index(compact, compact->count);
+	compact->count++;
+	value_ptr->off = dst_off;
+	return 0;
+}
+
+static int jsval_compact_forward_off(jsval_compact_t *compact, uint8_t kind,
+		jsval_off_t *off_ptr)
+{
+	jsval_t value = jsval_undefined();
+
+	if (*off_ptr == 0) {
+		return 0;
+	}
+	value.kind = kind;
+	value.repr = JSVAL_REPR_NATIVE;
+	value.off = *off_ptr;
+	if (jsval_compact_forward(compact, &value) < 0) {
+		return -1;
+	}
+	*off_ptr = value.off;
+	return 0;
+}
+
+static int jsval_compact_forward_values(jsval_compact_t *compact,
+		jsval_t *values, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		if (jsval_compact_forward(compact, &values[i]) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Same over stored cells; JSON cells are decoded against the source. */
+static int jsval_compact_forward_cells(jsval_compact_t *compact,
+		jsval_cell_t *cells, size_t count)
+{
+#if JSMX_WITH_NAN_BOXING
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		jsval_t value = jsval_cell_unpack(compact->src, cells[i]);
+
+		if (jsval_compact_forward(compact, &value) < 0) {
+			return -1;
+		}
+		cells[i] = jsval_cell_pack(value);
+	}
+	return 0;
+#else
+	return jsval_compact_forward_values(compact, cells, count);
+#endif
+}
+
+/* Rewrite the outgoing edges of one copied node. */
+static int jsval_compact_scan(jsval_compact_t *compact,
+		const jsval_compact_entry_t *entry)
+{
+	uint8_t *node = compact->dst->base + entry->dst_off;
+
+	if (entry->repr == JSVAL_REPR_JSON) {
+		return 0;
+	}
+	switch (entry->kind) {
+	case JSVAL_KIND_SYMBOL:
+		return jsval_compact_forward(compact,
+				&((jsval_native_symbol_t *)node)->description);
+	case JSVAL_KIND_FUNCTION:
+		return jsval_compact_forward(compact,
+				&((jsval_native_function_t *)node)->name);
+	case JSVAL_KIND_TYPED_ARRAY:
+		return jsval_compact_forward_off(compact, JSVAL_KIND_ARRAY_BUFFER,
+				&((jsval_native_typed_array_t *)node)->buffer_off);
+	case JSVAL_KIND_OBJECT:
+	{
+		jsval_native_object_t *object = (jsval_native_object_t *)node;
+
+		if (object->forward_off != 0) {
+			return jsval_compact_forward_off(compact, JSVAL_KIND_OBJECT,
+					&object->forward_off);
+		}
+		if (object->shape_off != 0) {
+			if (jsval_compact_forward_off(compact, JSVAL_KIND_OBJECT,
+					&object->shape_off) < 0) {
+				return -1;
+			}
+			return jsval_compact_forward_cells(compact,
+					jsval_native_object_slots(object), object->len);
+		}
+		return jsval_compact_forward_cells(compact,
+				(jsval_cell_t *)jsval_native_object_props(object),
+				object->len * 2);
+	}
+	case JSVAL_KIND_ARRAY:
+	{
+		jsval_native_array_t *array = (jsval_native_array_t *)node;
+
+		return jsval_compact_forward_cells(compact,
+				jsval_native_array_values(array), array->len);
+	}
+	case JSVAL_KIND_SET:
+	{
+		jsval_native_set_t *set = (jsval_native_set_t *)node;
+
+		if (jsval_compact_forward_cells(compact,
+				jsval_native_set_values(set), set->len) < 0) {
+			return -1;
+		}
+		/* Identity hashes moved with the keys. */
+		set = (jsval_native_set_t *)(compact->dst->base + entry->dst_off);
+		return jsval_native_set_reindex(compact->dst, set);
+	}
+	case JSVAL_KIND_MAP:
+	{
+		jsval_native_map_t *map = (jsval_native_map_t *)node;
+
+		if (jsval_compact_forward_cells(compact,
+				(jsval_cell_t *)jsval_native_map_entries(map),
+				map->len * 2) < 0) {
+			return -1;
+		}
+		map = (jsval_native_map_t *)(compact->dst->base + entry->dst_off);
+		return jsval_native_map_reindex(compact->dst, map);
+	}
+	case JSVAL_KIND_HEADERS:
+	{
+		jsval_native_headers_t *headers = (jsval_native_headers_t *)node;
+
+		return jsval_compact_forward_values(compact,
+				(jsval_t *)jsval_native_headers_entries(headers),
+				headers->len * 2);
+	}
+	case JSVAL_KIND_ITERATOR:
+		return jsval_compact_forward(compact,
+				&((jsval_native_iterator_t *)node)->source_value);
+	case JSVAL_KIND_CRYPTO:
+		return jsval_compact_forward(compact,
+				&((jsval_native_crypto_t *)node)->subtle_value);
+	case JSVAL_KIND_CRYPTO_KEY:
+	{
+		jsval_native_crypto_key_t *key = (jsval_native_crypto_key_t *)node;
+
+		if (key->key_bytes_off != 0 && jsval_compact_copy_bytes(
+				compact->dst, compact->src->base + key->key_bytes_off,
+				key->key_byte_length, 1, &key->key_bytes_off) < 0) {
+			return -1;
+		}
+		return jsval_compact_forward(compact, &key->algorithm);
+	}
+	case JSVAL_KIND_DOM_EXCEPTION:
+	{
+		jsval_native_dom_exception_t *exception =
+			(jsval_native_dom_exception_t *)node;
+
+		if (jsval_compact_forward(compact, &exception->name) < 0
+				|| jsval_compact_forward(compact, &exception->message) < 0) {
+			return -1;
+		}
+		return jsval_compact_forward(compact, &exception->errors);
+	}
+	case JSVAL_KIND_PROMISE:
+	{
+		jsval_native_promise_t *promise = (jsval_native_promise_t *)node;
+		jsval_off_t src_off = promise->reactions_head;
+		jsval_off_t prev_off = 0;
+
+		if (promise->parked_microtask_off != 0) {
+			errno = ENOTSUP;
+			return -1;
+		}
+		if (jsval_compact_forward(compact, &promise->result) < 0) {
+			return -1;
+		}
+		/* Reaction nodes are owned by their promise: copy the chain. */
+		promise->reactions_head = 0;
+		promise->reactions_tail = 0;
+		while (src_off != 0) {
+			jsval_native_promise_reaction_t *reaction;
+			jsval_off_t off;
+
+			/* Copied at class size so it can be recycled later. */
+			JSVAL_ALLOC_TAG(compact->dst,
+					JSVAL_ALLOC_CLASS_PROMISE_REACTION);
+			if (jsval_compact_copy_bytes(compact->dst,
+					compact->src->base + src_off,
+					jsval_node_size(sizeof(*reaction)), JSVAL_ALIGN,
+					&off) < 0) {
+				return -1;
+			}
+			reaction = (jsval_native_promise_reaction_t *)
+				(compact->dst->base + off);
+			src_off = reaction->next_off;
+			reaction->next_off = 0;
+			if (jsval_compact_forward(compact, &reaction->on_fulfilled) < 0
+					|| jsval_compact_forward(compact,
+					&reaction->on_rejected) < 0
+					|| jsval_compact_forward(compact,
+					&reaction->passthrough) < 0
+					|| jsval_compact_forward_off(compact,
+					JSVAL_KIND_PROMISE, &reaction->downstream_off) < 0) {
+				return -1;
+			}
+			if (prev_off == 0) {
+				promise->reactions_head = off;
+			} else {
+				((jsval_native_promise_reaction_t *)
+					(compact->dst->base + prev_off))->next_off = off;
+			}
+			promise->reactions_tail = off;
+			prev_off = off;
+		}
+		return 0;
+	}
+	default:
+		return 0;
+	}
+}
+
+static int jsval_region_copy(jsval_region_t *src, jsval_region_t *dst,
+		int image)
+{
+	jsval_compact_t compact;
+	jsval_region_grow_fn grow;
+	jsval_t root;
+	size_t i;
+	int rc = 0;
+
+	if (!jsval_region_valid(src) || !jsval_region_valid(dst) || src == dst
+			|| src->base == dst->base
+			|| dst->pages->used_len != jsval_pages_head_size_aligned()) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (src->microtask_head != 0 || src->fetch_waitlist_head != 0
+			|| src->promise_combinator_head != 0) {
+		errno = EBUSY;
+		return -1;
+	}
+
+	memset(&compact, 0, sizeof(compact));
+	compact.src = src;
+	compact.dst = dst;
+	compact.top = dst->pages->total_len;
+	compact.image = image;
+	/* Growing dst in place would run over the scratch table. */
+	grow = dst->grow;
+	dst->grow = NULL;
+	if (jsval_compact_grow(&compact, JSVAL_COMPACT_INITIAL_CAP) < 0) {
+		dst->grow = grow;
+		return -1;
+	}
+
+	root = src->pages->root;
+	if (jsval_compact_forward(&compact, &root) < 0) {
+		rc = -1;
+	}
+	for (i = 0; rc == 0 && i < compact.count; i++) {
+		jsval_compact_entry_t entry = compact.entries[i];
+
+		if (jsval_compact_scan(&compact, &entry) < 0) {
+			rc = -1;
+		}
+	}
+
+	dst->pages->total_len = (uint32_t)compact.top;
+	dst->grow = grow;
+	if (rc < 0) {
+		int saved = errno;
+
+		dst->pages->used_len = (uint32_t)jsval_pages_head_size_aligned();
+		dst->used = dst->pages->used_len;
+		errno = saved;
+		return -1;
+	}
+	dst->pages->root = root;
+	dst->mark_floor = 0;
+	if (image) {
+		dst->pages->total_len = dst->pages->used_len;
+		return 0;
+	}
+	dst->scheduler = src->scheduler;
+	dst->fetch_transport = src->fetch_transport;
+	dst->fetch_transport_userdata = src->fetch_transport_userdata;
+	dst->fetch_waitlist_enabled = src->fetch_waitlist_enabled;
+	return 0;
+}
+
+int jsval_region_compact(jsval_region_t *src, jsval_region_t *dst)
+{
+	return jsval_region_copy(src, dst, 0);
+}
+
+int jsval_region_image(jsval_region_t *src, jsval_region_t *dst)
+{
+	return jsval_region_copy(src, dst, 1);
+}
+
+int jsval_region_map_image(jsval_region_t *region, const void *buf,
+		size_t len)
+{
+	const jsval_pages_t *pages = (const jsval_pages_t *)buf;
+	jsval_t root;
+
+	if (region == NULL || buf == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	/* rebase only reads the header, so a PROT_READ mapping is fine. */
+	jsval_region_rebase(region, (void *)buf, len);
+	if (region->pages == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	root = pages->root;
+	if (root.repr != JSVAL_REPR_INLINE
+			&& (root.off < jsval_pages_head_size_aligned()
+			|| root.off >= pages->used_len)) {
+		memset(region, 0, sizeof(*region));
+		errno = EINVAL;
+		return -1;
+	}
+	region->readonly = 1;
+	region->mark_floor = pages->used_len;
+	return 0;
+}
+
 /* =========================================================================
  * WHATWG Fetch API — JS object model
  *
@@ -35995,6 +39863,7 @@ static int jsval_headers_alloc_with_cap(jsval_region_t *region,
 		return -1;
 	}
 	bytes_len = sizeof(*h) + cap * sizeof(jsval_native_headers_entry_t);
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_HEADERS);
 	if (jsval_region_reserve(region, bytes_len, JSVAL_ALIGN, &off,
 			(void **)&h) < 0) {
 		return -1;
@@ -37247,6 +41116,7 @@ int jsval_request_new(jsval_region_t *region, jsval_t input_value,
 
 	{
 		size_t bytes_len = sizeof(*native);
+		JSVAL_ALLOC_TAG(region, JSVAL_KIND_REQUEST);
 		if (jsval_region_reserve(region, bytes_len,
 				JSVAL_ALIGN, &off, (void **)&native) < 0) {
 			return -1;
@@ -37611,6 +41481,7 @@ int jsval_response_new(jsval_region_t *region, jsval_t body_value,
 	}
 
 	{
+		JSVAL_ALLOC_TAG(region, JSVAL_KIND_RESPONSE);
 		if (jsval_region_reserve(region, sizeof(*native), JSVAL_ALIGN, &off,
 				(void **)&native) < 0) {
 			return -1;
@@ -37907,6 +41778,7 @@ int jsval_response_clone(jsval_region_t *region, jsval_t response,
 			return -1;
 		}
 		src->body_readable = branch_a;
+		JSVAL_ALLOC_TAG(region, JSVAL_KIND_RESPONSE);
 		if (jsval_region_reserve(region, sizeof(*dst), JSVAL_ALIGN,
 				&off, (void **)&dst) < 0) {
 			return -1;
@@ -37945,6 +41817,7 @@ int jsval_response_clone(jsval_region_t *region, jsval_t response,
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_RESPONSE);
 	if (jsval_region_reserve(region, sizeof(*dst), JSVAL_ALIGN, &off,
 			(void **)&dst) < 0) {
 		return -1;
@@ -38570,6 +42443,7 @@ int jsval_fetch(jsval_region_t *region, jsval_t input_value, jsval_t init_value,
 		*promise_ptr = promise;
 		return 0;
 	}
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_FETCH_REQUEST);
 	if (jsval_region_reserve(region, sizeof(*task), JSVAL_ALIGN, &task_off,
 			(void **)&task) < 0) {
 		if (transport->cancel != NULL) {
@@ -38718,6 +42592,7 @@ int jsval_request_new_from_parts(jsval_region_t *region,
 		}
 	}
 
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_REQUEST);
 	if (jsval_region_reserve(region, sizeof(*native), JSVAL_ALIGN, &off,
 			(void **)&native) < 0) {
 		return -1;
@@ -38826,6 +42701,7 @@ int jsval_request_new_with_lazy_headers(jsval_region_t *region,
 	/* Now allocate the Request native struct. All earlier allocs may
 	 * have grown the region, but we hold no native pointers across
 	 * them — only jsval_t values which are stable. */
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_REQUEST);
 	if (jsval_region_reserve(region, sizeof(*native), JSVAL_ALIGN, &off,
 			(void **)&native) < 0) {
 		return -1;
@@ -38886,6 +42762,7 @@ int jsval_response_new_from_parts(jsval_region_t *region,
 		}
 	}
 
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_RESPONSE);
 	if (jsval_region_reserve(region, sizeof(*native), JSVAL_ALIGN, &off,
 			(void **)&native) < 0) {
 		return -1;
@@ -38929,6 +42806,7 @@ static int jsval_body_drain_schedule(jsval_region_t *region,
 	if (jsval_array_buffer_new(region, initial_cap, &initial_buffer) < 0) {
 		return -1;
 	}
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_FETCH_BODY_DRAIN);
 	if (jsval_region_reserve(region, sizeof(*task), JSVAL_ALIGN, &task_off,
 			(void **)&task) < 0) {
 		return -1;
@@ -38941,6 +42819,7 @@ static int jsval_body_drain_schedule(jsval_region_t *region,
 	task->written_len = 0;
 	task->budget = budget;
 	task->consume_mode = consume_mode;
+	jsmn_init(&task->json_parser);
 	if (jsval_microtask_push(region, task_off, &task->base) < 0) {
 		return -1;
 	}
@@ -38966,6 +42845,152 @@ static int jsval_body_drain_reject(jsval_region_t *region,
 	return jsval_promise_reject(region, promise_value, reason);
 }
 
+static uint8_t *jsval_body_drain_bytes(jsval_region_t *region,
+		jsval_native_microtask_fetch_body_drain_t *task)
+{
+	jsval_t buffer_value = jsval_undefined();
+	jsval_native_array_buffer_t *buffer;
+
+	buffer_value.kind = JSVAL_KIND_ARRAY_BUFFER;
+	buffer_value.repr = JSVAL_REPR_NATIVE;
+	buffer_value.off = task->buffer_off;
+	buffer = jsval_native_array_buffer(region, buffer_value);
+	if (buffer == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return jsval_native_array_buffer_bytes(buffer);
+}
+
+/*
+ * Resume tokenizing the drained bytes. jsmn picks up at
+ * task->json_parser.pos; tokens only hold offsets, so the buffer may
+ * have moved since the last feed. Until EOF the trailing run after the
+ * last delimiter is held back: jsmn's non-strict mode would otherwise
+ * close a primitive such as "12" that the next chunk extends to "123".
+ * Sets *rc_ptr to jsmn's result (token count, JSMN_ERROR_PART or
+ * JSMN_ERROR_INVAL).
+ */
+static int jsval_body_drain_json_feed(jsval_region_t *region,
+		jsval_native_microtask_fetch_body_drain_t *task, int eof, int *rc_ptr)
+{
+	const uint8_t *bytes;
+	size_t limit = task->written_len;
+	int rc = 0;
+
+	bytes = jsval_body_drain_bytes(region, task);
+	if (bytes == NULL) {
+		return -1;
+	}
+	if (!eof) {
+		size_t floor = task->json_parser.pos;
+
+		/* Inside a string, bytes up to strpos are already scanned. */
+		if (task->json_parser.strpos > floor) {
+			floor = task->json_parser.strpos;
+		}
+		while (limit > floor && !jsval_json_is_delimiter(bytes[limit - 1])) {
+			limit--;
+		}
+		/* No quote since then either: it is all string content, which
+		 * cannot be cut short, so feed it and keep each byte scanned
+		 * once. */
+		if (limit == floor && task->json_parser.strpos != 0) {
+			limit = task->written_len;
+		}
+	}
+	for (;;) {
+		jsmntok_t *tokens = NULL;
+
+		if (task->json_tokens_off != 0) {
+			tokens = (jsmntok_t *)jsval_region_ptr(region,
+					task->json_tokens_off);
+			rc = jsmn_parse(&task->json_parser, (const char *)bytes, limit,
+					tokens, task->json_tokcap);
+			if (rc != JSMN_ERROR_NOMEM) {
+				break;
+			}
+		}
+		{
+			unsigned int new_cap = task->json_tokcap == 0
+					? 64 : task->json_tokcap;
+			jsmntok_t *grown;
+			jsval_off_t grown_off;
+
+			if (task->json_tokcap > 0) {
+				if (task->json_tokcap > UINT_MAX / 2) {
+					errno = EOVERFLOW;
+					return -1;
+				}
+				new_cap = task->json_tokcap * 2;
+			}
+			JSVAL_ALLOC_TAG(region, JSVAL_ALLOC_CLASS_JSON_TOKENS);
+			if (jsval_region_reserve(region, new_cap * sizeof(jsmntok_t),
+					JSVAL_ALIGN, &grown_off, (void **)&grown) < 0) {
+				return -1;
+			}
+			if (tokens != NULL && task->json_parser.toknext > 0) {
+				memcpy(grown, tokens,
+						task->json_parser.toknext * sizeof(jsmntok_t));
+			}
+			task->json_tokens_off = grown_off;
+			task->json_tokcap = new_cap;
+		}
+	}
+	*rc_ptr = rc;
+	return 0;
+}
+
+static int jsval_body_drain_reject_syntax(jsval_region_t *region,
+		jsval_native_microtask_fetch_body_drain_t *task, const char *message)
+{
+	jsval_t reason;
+
+	jsval_body_source_close_once(jsval_native_body_source(region,
+			task->source_off));
+	if (jsval_dom_exception_new_utf8(region, "SyntaxError", message,
+			&reason) < 0) {
+		return -1;
+	}
+	return jsval_promise_reject(region,
+			jsval_promise_value(task->promise_off), reason);
+}
+
+/* Wrap the drained bytes and the tokens fed so far in a JSON doc. The
+ * doc points at the drain buffer in place rather than copying it. */
+static int jsval_body_drain_json_resolve(jsval_region_t *region,
+		jsval_native_microtask_fetch_body_drain_t *task, jsval_t *value_ptr)
+{
+	jsval_json_doc_t *doc;
+	jsval_off_t doc_off;
+	uint8_t *bytes;
+	int rc;
+
+	if (jsval_body_drain_json_feed(region, task, 1, &rc) < 0) {
+		return -1;
+	}
+	if (rc < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	JSVAL_ALLOC_TAG(region, JSVAL_ALLOC_CLASS_JSON_DOC);
+	if (jsval_region_reserve(region, sizeof(*doc), JSVAL_ALIGN, &doc_off,
+			(void **)&doc) < 0) {
+		return -1;
+	}
+	bytes = jsval_body_drain_bytes(region, task);
+	if (bytes == NULL) {
+		return -1;
+	}
+	doc->json_off = (jsval_off_t)(bytes - region->base);
+	doc->json_len = task->written_len;
+	doc->tokens_off = task->json_tokens_off;
+	doc->tokcap = task->json_tokcap;
+	doc->borrowed = NULL;
+	return jsval_json_doc_complete(region, doc, doc_off,
+			task->json_parser.toknext, 1, value_ptr);
+}
+
 static int jsval_body_drain_resolve_eof(jsval_region_t *region,
 		jsval_native_microtask_fetch_body_drain_t *task)
 {
@@ -39008,7 +43033,7 @@ static int jsval_body_drain_resolve_eof(jsval_region_t *region,
 			}
 			return jsval_promise_reject(region, promise_value, reason);
 		}
-		if (jsval_json_parse(region, bytes, len, 256, &resolved) < 0) {
+		if (jsval_body_drain_json_resolve(region, task, &resolved) < 0) {
 			jsval_t reason;
 			if (jsval_dom_exception_new_utf8(region, "SyntaxError",
 					"invalid JSON", &reason) < 0) {
@@ -39203,6 +43228,24 @@ static int jsval_fetch_run_body_drain(jsval_region_t *region,
 		memcpy(jsval_native_array_buffer_bytes(buf) + task->written_len,
 				scratch, n);
 		task->written_len = new_total;
+		if (task->consume_mode == JSVAL_BODY_CONSUME_JSON
+				&& status != JSVAL_BODY_SOURCE_STATUS_EOF) {
+			int json_rc;
+
+			/* Tokenize while the rest of the body is still in flight;
+			 * a syntax error rejects without draining the remainder. */
+			if (jsval_body_drain_json_feed(region, task, 0, &json_rc) < 0) {
+				if (errno != ENOBUFS) {
+					return -1;
+				}
+				return jsval_body_drain_reject_syntax(region, task,
+						"invalid JSON");
+			}
+			if (json_rc == JSMN_ERROR_INVAL) {
+				return jsval_body_drain_reject_syntax(region, task,
+						"invalid JSON");
+			}
+		}
 	}
 	if (status == JSVAL_BODY_SOURCE_STATUS_EOF) {
 		return jsval_body_drain_resolve_eof(region, task);
@@ -39647,6 +43690,7 @@ static int jsval_readable_body_consumer_schedule(jsval_region_t *region,
 		(void)jsval_readable_stream_reader_release_lock(region, reader);
 		return -1;
 	}
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_READABLE_BODY_CONSUMER);
 	if (jsval_region_reserve(region, sizeof(*task), JSVAL_ALIGN, &task_off,
 			(void **)&task) < 0) {
 		(void)jsval_readable_stream_reader_release_lock(region, reader);
@@ -39695,6 +43739,7 @@ static int jsval_tee_branch_source_read(void *userdata,
 	jsval_native_tee_state_t *state;
 	jsval_off_t *head_ptr;
 	jsval_off_t *tail_ptr;
+	jsval_off_t chunk_off;
 	jsval_native_tee_chunk_t *chunk;
 	size_t n;
 
@@ -39739,10 +43784,12 @@ static int jsval_tee_branch_source_read(void *userdata,
 		}
 		*out_len = n;
 		*status_ptr = JSVAL_BODY_SOURCE_STATUS_READY;
+		chunk_off = *head_ptr;
 		*head_ptr = chunk->next_off;
 		if (*head_ptr == 0) {
 			*tail_ptr = 0;
 		}
+		jsval_region_node_free(ud->region, chunk_off, sizeof(*chunk) + n);
 		/* Phase 3c-11: update queue_bytes and wake the pump if it
 		 * was parked for backpressure and both branches are now
 		 * below the high-water mark. */
@@ -39859,8 +43906,8 @@ static int jsval_tee_branch_enqueue_chunk(jsval_region_t *region,
 		return -1;
 	}
 	total = sizeof(*chunk) + len;
-	if (jsval_region_reserve(region, total,
-			_Alignof(jsval_native_tee_chunk_t), &chunk_off,
+	JSVAL_ALLOC_TAG(region, JSVAL_ALLOC_CLASS_STREAM_QUEUE);
+	if (jsval_region_node_alloc(region, total, &chunk_off,
 			(void **)&chunk) < 0) {
 		return -1;
 	}
@@ -40233,6 +44280,7 @@ int jsval_readable_stream_tee(jsval_region_t *region, jsval_t readable,
 	}
 
 	/* Allocate tee state. */
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_READABLE_STREAM);
 	if (jsval_region_reserve(region, sizeof(*state),
 			_Alignof(jsval_native_tee_state_t), &state_off,
 			(void **)&state) < 0) {
@@ -40245,6 +44293,7 @@ int jsval_readable_stream_tee(jsval_region_t *region, jsval_t readable,
 	state->upstream_state = 0;
 
 	/* Allocate branch A userdata and stream. */
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_READABLE_STREAM);
 	if (jsval_region_reserve(region, sizeof(*ud_a),
 			_Alignof(jsval_native_tee_branch_ud_t), &ud_a_off,
 			(void **)&ud_a) < 0) {
@@ -40262,6 +44311,7 @@ int jsval_readable_stream_tee(jsval_region_t *region, jsval_t readable,
 	}
 
 	/* Allocate branch B userdata and stream. */
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_READABLE_STREAM);
 	if (jsval_region_reserve(region, sizeof(*ud_b),
 			_Alignof(jsval_native_tee_branch_ud_t), &ud_b_off,
 			(void **)&ud_b) < 0) {
@@ -40292,6 +44342,7 @@ int jsval_readable_stream_tee(jsval_region_t *region, jsval_t readable,
 	state->branch_b_stream_off = branch_b.off;
 
 	/* Schedule the tee pump microtask. */
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_READABLE_STREAM_TEE_PUMP);
 	if (jsval_region_reserve(region, sizeof(*task), JSVAL_ALIGN, &task_off,
 			(void **)&task) < 0) {
 		(void)jsval_readable_stream_reader_release_lock(region, reader);
@@ -40497,9 +44548,9 @@ static int jsval_readable_stream_enqueue_read(jsval_region_t *region,
 	jsval_native_readable_stream_pending_read_t *node;
 	jsval_off_t node_off;
 
-	if (jsval_region_reserve(region, sizeof(*node),
-			_Alignof(jsval_native_readable_stream_pending_read_t),
-			&node_off, (void **)&node) < 0) {
+	JSVAL_ALLOC_TAG(region, JSVAL_ALLOC_CLASS_STREAM_QUEUE);
+	if (jsval_region_node_alloc(region, sizeof(*node), &node_off,
+			(void **)&node) < 0) {
 		return -1;
 	}
 	node->next_off = 0;
@@ -40548,6 +44599,7 @@ static jsval_off_t jsval_readable_stream_dequeue_read(jsval_region_t *region,
 	if (stream->pending_reads_head == 0) {
 		stream->pending_reads_tail = 0;
 	}
+	jsval_region_node_free(region, node_off, sizeof(*node));
 	return promise_off;
 }
 
@@ -40566,7 +44618,8 @@ static int jsval_readable_stream_schedule_pump(jsval_region_t *region,
 	if (stream->pump_scheduled) {
 		return 0;
 	}
-	if (jsval_region_reserve(region, sizeof(*task), JSVAL_ALIGN, &task_off,
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_READABLE_STREAM_PUMP);
+	if (jsval_region_node_alloc(region, sizeof(*task), &task_off,
 			(void **)&task) < 0) {
 		return -1;
 	}
@@ -40599,6 +44652,7 @@ static int jsval_readable_stream_new_wrapping_source(jsval_region_t *region,
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_READABLE_STREAM);
 	if (jsval_region_alloc(region, sizeof(*stream),
 			_Alignof(jsval_native_readable_stream_t), &ptr) < 0) {
 		return -1;
@@ -40627,6 +44681,7 @@ int jsval_readable_stream_new_from_source(jsval_region_t *region,
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_READABLE_STREAM);
 	if (jsval_region_reserve(region, sizeof(*source),
 			_Alignof(jsval_native_body_source_t), &source_off,
 			(void **)&source) < 0) {
@@ -40640,6 +44695,7 @@ int jsval_readable_stream_new_from_source(jsval_region_t *region,
 	source->parked_stream_off = 0;
 	source->parked_drain_off = 0;
 
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_READABLE_STREAM);
 	if (jsval_region_alloc(region, sizeof(*stream),
 			_Alignof(jsval_native_readable_stream_t), &ptr) < 0) {
 		return -1;
@@ -40673,6 +44729,7 @@ int jsval_readable_stream_new_from_bytes(jsval_region_t *region,
 		return -1;
 	}
 	total = sizeof(*state) + len;
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_READABLE_STREAM);
 	if (jsval_region_reserve(region, total,
 			_Alignof(jsval_native_readable_stream_bytes_source_t),
 			&state_off, (void **)&state) < 0) {
@@ -40727,6 +44784,7 @@ int jsval_readable_stream_get_reader(jsval_region_t *region,
 		errno = EBUSY;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_READABLE_STREAM_READER);
 	if (jsval_region_alloc(region, sizeof(*reader),
 			_Alignof(jsval_native_readable_stream_reader_t), &ptr) < 0) {
 		return -1;
@@ -41233,9 +45291,9 @@ static int jsval_writable_stream_enqueue_write(jsval_region_t *region,
 		return -1;
 	}
 	total = sizeof(*node) + chunk_len;
-	if (jsval_region_reserve(region, total,
-			_Alignof(jsval_native_writable_stream_pending_write_t),
-			&node_off, (void **)&node) < 0) {
+	JSVAL_ALLOC_TAG(region, JSVAL_ALLOC_CLASS_STREAM_QUEUE);
+	if (jsval_region_node_alloc(region, total, &node_off,
+			(void **)&node) < 0) {
 		return -1;
 	}
 	node->next_off = 0;
@@ -41291,6 +45349,20 @@ static jsval_off_t jsval_writable_stream_dequeue_write(jsval_region_t *region,
 	return node_off;
 }
 
+/* A dequeued write is dead once its promise has been taken. */
+static void jsval_writable_stream_free_write(jsval_region_t *region,
+		jsval_off_t node_off)
+{
+	jsval_native_writable_stream_pending_write_t *node;
+
+	node = (jsval_native_writable_stream_pending_write_t *)
+			jsval_region_ptr(region, node_off);
+	if (node != NULL) {
+		jsval_region_node_free(region, node_off,
+				sizeof(*node) + node->len);
+	}
+}
+
 static int jsval_writable_stream_schedule_pump(jsval_region_t *region,
 		jsval_off_t stream_off)
 {
@@ -41306,7 +45378,8 @@ static int jsval_writable_stream_schedule_pump(jsval_region_t *region,
 	if (stream->pump_scheduled) {
 		return 0;
 	}
-	if (jsval_region_reserve(region, sizeof(*task), JSVAL_ALIGN, &task_off,
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_WRITABLE_STREAM_PUMP);
+	if (jsval_region_node_alloc(region, sizeof(*task), &task_off,
 			(void **)&task) < 0) {
 		return -1;
 	}
@@ -41350,6 +45423,7 @@ static int jsval_writable_stream_reject_pending(jsval_region_t *region,
 				return -1;
 			}
 			p = jsval_promise_value(node->promise_off);
+			jsval_writable_stream_free_write(region, node_off);
 			if (jsval_promise_reject(region, p, reason) < 0) {
 				return -1;
 			}
@@ -41386,6 +45460,7 @@ int jsval_writable_stream_new_from_sink(jsval_region_t *region,
 		errno = EINVAL;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_WRITABLE_STREAM);
 	if (jsval_region_reserve(region, sizeof(*sink),
 			_Alignof(jsval_native_underlying_sink_t), &sink_off,
 			(void **)&sink) < 0) {
@@ -41397,6 +45472,7 @@ int jsval_writable_stream_new_from_sink(jsval_region_t *region,
 	memset(sink->reserved, 0, sizeof(sink->reserved));
 	sink->parked_stream_off = 0;
 
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_WRITABLE_STREAM);
 	if (jsval_region_alloc(region, sizeof(*stream),
 			_Alignof(jsval_native_writable_stream_t), &ptr) < 0) {
 		return -1;
@@ -41451,6 +45527,7 @@ int jsval_writable_stream_get_writer(jsval_region_t *region,
 		errno = EBUSY;
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_WRITABLE_STREAM_DEFAULT_WRITER);
 	if (jsval_region_alloc(region, sizeof(*writer),
 			_Alignof(jsval_native_writable_stream_writer_t), &ptr) < 0) {
 		return -1;
@@ -41887,6 +45964,7 @@ static int jsval_writable_stream_run_pump(jsval_region_t *region,
 			jsval_t p = jsval_promise_value(node->promise_off);
 
 			(void)jsval_writable_stream_dequeue_write(region, stream);
+			jsval_writable_stream_free_write(region, node_off);
 			if (jsval_promise_resolve(region, p, jsval_undefined()) < 0) {
 				return -1;
 			}
@@ -41957,6 +46035,7 @@ static int jsval_writable_stream_run_pump(jsval_region_t *region,
 			jsval_t p = jsval_promise_value(node->promise_off);
 
 			(void)jsval_writable_stream_dequeue_write(region, stream);
+			jsval_writable_stream_free_write(region, node_off);
 			if (jsval_promise_resolve(region, p, jsval_undefined()) < 0) {
 				return -1;
 			}
@@ -42145,6 +46224,7 @@ static int jsval_transform_channel_push_chunk(jsval_region_t *region,
 		return -1;
 	}
 	total = sizeof(*chunk) + len;
+	JSVAL_ALLOC_TAG(region, JSVAL_ALLOC_CLASS_STREAM_QUEUE);
 	if (jsval_region_reserve(region, total,
 			_Alignof(jsval_native_transform_chunk_t), &chunk_off,
 			(void **)&chunk) < 0) {
@@ -42521,6 +46601,7 @@ int jsval_transform_stream_new(jsval_region_t *region,
 		return -1;
 	}
 
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_TRANSFORM_STREAM);
 	if (jsval_region_reserve(region, sizeof(*channel),
 			_Alignof(jsval_native_transform_channel_t), &channel_off,
 			(void **)&channel) < 0) {
@@ -42529,6 +46610,7 @@ int jsval_transform_stream_new(jsval_region_t *region,
 	memset(channel, 0, sizeof(*channel));
 	channel->error_reason = jsval_undefined();
 
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_TRANSFORM_STREAM);
 	if (jsval_region_reserve(region, sizeof(*wrapper),
 			_Alignof(jsval_native_transform_stream_t), &wrapper_off,
 			(void **)&wrapper) < 0) {
@@ -42548,6 +46630,7 @@ int jsval_transform_stream_new(jsval_region_t *region,
 
 	/* Source dispatch struct (region-allocated, lives with the
 	 * stream). */
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_TRANSFORM_STREAM);
 	if (jsval_region_reserve(region, sizeof(*src_disp),
 			_Alignof(jsval_transform_source_dispatch_t), &src_disp_off,
 			(void **)&src_disp) < 0) {
@@ -42557,6 +46640,7 @@ int jsval_transform_stream_new(jsval_region_t *region,
 	src_disp->channel_off = channel_off;
 
 	/* Body source struct that the readable wraps. */
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_TRANSFORM_STREAM);
 	if (jsval_region_reserve(region, sizeof(*source),
 			_Alignof(jsval_native_body_source_t), &source_off,
 			(void **)&source) < 0) {
@@ -42584,6 +46668,7 @@ int jsval_transform_stream_new(jsval_region_t *region,
 
 	/* Sink dispatch struct, then the writable side wrapping our
 	 * sink vtable. */
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_TRANSFORM_STREAM);
 	if (jsval_region_reserve(region, sizeof(*sink_disp),
 			_Alignof(jsval_transform_sink_dispatch_t), &sink_disp_off,
 			(void **)&sink_disp) < 0) {
@@ -43066,6 +47151,7 @@ int jsval_text_decoder_stream_new_with_init(jsval_region_t *region,
 			have_options, &fatal, &ignore_bom) < 0) {
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_TRANSFORM_STREAM);
 	if (jsval_region_reserve(region, sizeof(*state),
 			_Alignof(jsval_native_text_decoder_state_t), &state_off,
 			(void **)&state) < 0) {
@@ -43463,6 +47549,7 @@ int jsval_readable_stream_pipe_to(jsval_region_t *region, jsval_t readable,
 		return -1;
 	}
 
+	JSVAL_ALLOC_TAG_MICROTASK(region, JSVAL_MICROTASK_KIND_STREAM_PIPE_PUMP);
 	if (jsval_region_reserve(region, sizeof(*task), JSVAL_ALIGN, &task_off,
 			(void **)&task) < 0) {
 		(void)jsval_readable_stream_reader_release_lock(region, reader);
@@ -43729,6 +47816,7 @@ static int jsval_compression_stream_new_internal(jsval_region_t *region,
 	if (jsval_compression_window_bits(format, &window_bits) < 0) {
 		return -1;
 	}
+	JSVAL_ALLOC_TAG(region, JSVAL_KIND_TRANSFORM_STREAM);
 	if (jsval_region_reserve(region, sizeof(*state),
 			_Alignof(jsval_native_compression_state_t), &state_off,
 			(void **)&state) < 0) {
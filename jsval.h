@@ -11,7 +11,12 @@
 typedef uint32_t jsval_off_t;
 
 #define JSVAL_PAGES_MAGIC 0x4a535650u
+/* Boxed builds store 8-byte cells; their pages do not load elsewhere. */
+#if JSMX_WITH_NAN_BOXING
+#define JSVAL_PAGES_VERSION 0x101u
+#else
 #define JSVAL_PAGES_VERSION 1u
+#endif
 
 typedef enum jsval_repr_e {
 	JSVAL_REPR_INLINE = 0,
@@ -112,6 +117,17 @@ typedef enum jsval_promise_state_e {
 	JSVAL_PROMISE_STATE_REJECTED = 2
 } jsval_promise_state_t;
 
+/*
+ * A value handle. Handles are 16 bytes and are what the API passes
+ * around; containers store them as value cells. Built with
+ * JSMX_WITH_NAN_BOXING=1, array elements, object props and slots, and
+ * Set and Map entries are NaN-boxed into 8 bytes each (numbers as
+ * their double, everything else in the negative NaN space), halving
+ * container footprint. A parsed JSON document is then limited to 4M
+ * tokens (2M on 32-bit targets); larger ones fail with
+ * EOVERFLOW. Region images and snapshots only load on a build with
+ * the same setting.
+ */
 typedef struct jsval_s {
 	uint8_t kind;
 	uint8_t repr;
@@ -191,6 +207,60 @@ typedef struct jsval_fetch_transport_s {
 	void (*cancel)(void *userdata, void *state);
 } jsval_fetch_transport_t;
 
+/*
+ * Page allocator for growable regions (see jsval_region_set_grow).
+ * Called when an allocation would pass the end of the region: it must
+ * make at least `need` bytes addressable at `base` without moving them
+ * -- e.g. by committing more pages of a larger PROT_NONE reservation --
+ * store the new length (<= UINT32_MAX) in *len_ptr and return 0, or
+ * return -1 if it cannot.
+ */
+typedef int (*jsval_region_grow_fn)(void *ctx, uint8_t *base, size_t len,
+		size_t need, size_t *len_ptr);
+
+/*
+ * Allocation accounting (build with JSMX_WITH_ALLOC_STATS=1). Every
+ * bump allocation is charged to one class: native value nodes by
+ * jsval_kind_t, then JSON docs and their token, source and lookup
+ * index blocks, microtasks (also broken down by internal microtask
+ * kind), promise reactions, stream queue nodes (pending reads/writes,
+ * tee and transform chunks), and everything else. Bytes include
+ * alignment padding, so the classes sum to the growth of `used`.
+ * String payloads are also totalled on their own (they are included
+ * in the string kinds). Freelist reuse counts in recycled_count only.
+ * high_water is the largest used_len seen, across marks and restores.
+ */
+typedef enum jsval_alloc_class_e {
+	JSVAL_ALLOC_CLASS_JSON_DOC = JSVAL_KIND_STRING_JSSTR8 + 1,
+	JSVAL_ALLOC_CLASS_JSON_TOKENS,
+	JSVAL_ALLOC_CLASS_JSON_SOURCE,
+	JSVAL_ALLOC_CLASS_JSON_INDEX,
+	JSVAL_ALLOC_CLASS_MICROTASK,
+	JSVAL_ALLOC_CLASS_PROMISE_REACTION,
+	JSVAL_ALLOC_CLASS_STREAM_QUEUE,
+	JSVAL_ALLOC_CLASS_OTHER,
+	JSVAL_ALLOC_CLASS_COUNT
+} jsval_alloc_class_t;
+
+#define JSVAL_ALLOC_MICROTASK_KINDS 32
+
+typedef struct jsval_region_stats_s {
+	size_t bytes[JSVAL_ALLOC_CLASS_COUNT];
+	size_t count[JSVAL_ALLOC_CLASS_COUNT];
+	size_t microtask_bytes[JSVAL_ALLOC_MICROTASK_KINDS];
+	size_t microtask_count[JSVAL_ALLOC_MICROTASK_KINDS];
+	size_t string_payload_bytes;
+	size_t recycled_count;
+	size_t high_water;
+} jsval_region_stats_t;
+
+/*
+ * Size classes of the region's freelists for runtime nodes that are
+ * dead once dispatched (microtasks, promise reactions, pending stream
+ * reads/writes, tee chunks): 16, 32, ... 8192 bytes.
+ */
+#define JSVAL_REGION_NODE_CLASSES 10
+
 typedef struct jsval_region_s {
 	uint8_t *base;
 	size_t len;
@@ -201,7 +271,9 @@ typedef struct jsval_region_s {
 	size_t microtask_count;
 	uint8_t microtask_draining;
 	uint8_t fetch_waitlist_enabled;
-	uint8_t reserved[6];
+	uint8_t readonly;
+	uint8_t alloc_tag;
+	uint8_t reserved[4];
 	jsval_scheduler_t scheduler;
 	const jsval_fetch_transport_t *fetch_transport;
 	void *fetch_transport_userdata;
@@ -209,6 +281,12 @@ typedef struct jsval_region_s {
 	jsval_off_t fetch_waitlist_tail;
 	size_t fetch_waitlist_count;
 	jsval_off_t promise_combinator_head;
+	jsval_off_t mark_floor;
+	jsval_region_grow_fn grow;
+	void *grow_ctx;
+	jsval_off_t node_free[JSVAL_REGION_NODE_CLASSES];
+	jsval_region_stats_t *stats;
+	jsval_off_t atoms_off;
 } jsval_region_t;
 
 typedef int (*jsval_native_function_fn)(jsval_region_t *region, size_t argc,
@@ -245,6 +323,26 @@ void jsval_region_get_scheduler(const jsval_region_t *region,
 void jsval_region_set_fetch_transport(jsval_region_t *region,
 		const jsval_fetch_transport_t *transport, void *userdata);
 
+/*
+ * Growable regions. Size the initial buffer for the common case; once
+ * it is exhausted the region asks `grow` for more room in place and
+ * carries on, so offsets, and pointers already handed out, stay valid.
+ * jsval_region_measure_alloc then only fails past the 4 GiB offset
+ * limit. Cleared by jsval_region_init and jsval_region_rebase; pass
+ * NULL to make the region fixed-size again.
+ */
+void jsval_region_set_grow(jsval_region_t *region, jsval_region_grow_fn grow,
+		void *ctx);
+
+/*
+ * Start charging this region's allocations to `stats` (zeroed here;
+ * high_water starts at the current used_len), or stop with NULL.
+ * Cleared by jsval_region_init and jsval_region_rebase. Fails with
+ * ENOTSUP unless built with JSMX_WITH_ALLOC_STATS.
+ */
+int jsval_region_set_stats(jsval_region_t *region,
+		jsval_region_stats_t *stats);
+
 /*
  * External-driver fetch waitlist.
  *
@@ -289,6 +387,111 @@ const jsval_pages_t *jsval_region_pages(const jsval_region_t *region);
 int jsval_region_root(jsval_region_t *region, jsval_t *value_ptr);
 int jsval_region_set_root(jsval_region_t *region, jsval_t value);
 
+/*
+ * Region checkpoints for scoped temporaries.
+ *
+ * jsval_region_mark records the bump offset and root; a matching
+ * jsval_region_release hands everything allocated since back to the
+ * region and restores the root. Marks nest and must be released
+ * innermost first (releasing a mark that lies above the current bump
+ * offset fails with EINVAL).
+ *
+ * Release refuses with EBUSY, leaving the region untouched, while the
+ * microtask queue, the fetch waitlist or the promise combinator list
+ * still links a node allocated after the mark; drain or settle them
+ * first. While a mark is active, lazily built JSON lookup indexes are
+ * not cached on docs that predate the mark, so releasing never leaves
+ * an older doc pointing at reclaimed memory. For the same reason a
+ * shaped object that predates the mark cannot move to dictionary mode
+ * inside it: adding or deleting one of its keys fails with EBUSY
+ * (reading and writing its existing keys is fine). Values created
+ * after the mark must not otherwise be stored into objects that
+ * predate it.
+ */
+typedef struct jsval_region_mark_s {
+	jsval_off_t used;
+	jsval_off_t floor;
+	jsval_t root;
+} jsval_region_mark_t;
+
+int jsval_region_mark(jsval_region_t *region, jsval_region_mark_t *mark_ptr);
+int jsval_region_release(jsval_region_t *region,
+		const jsval_region_mark_t *mark);
+
+/*
+ * Warm-start snapshots. After a handler's bootstrap (hoisted regexes,
+ * imported keys, constant config) call jsval_region_snapshot; at the
+ * start of every later request jsval_region_restore copies the saved
+ * pages header back, dropping everything the previous request
+ * allocated along with any work it left queued (microtasks, fetch
+ * waitlist entries, promise combinators). No bootstrap object is
+ * rebuilt or copied.
+ *
+ * As in a warm isolate, changes a request makes to bootstrap objects
+ * persist, but a request must not store values it created into them:
+ * those bytes are reclaimed on restore. Like an active mark, a
+ * snapshot keeps lazy JSON lookup indexes off bootstrap docs (build
+ * them with a lookup before snapshotting if wanted) and keeps shaped
+ * bootstrap objects from adding or deleting keys (EBUSY). Snapshotting
+ * fails with EBUSY while work is queued.
+ */
+typedef struct jsval_region_snapshot_s {
+	jsval_pages_t pages;
+} jsval_region_snapshot_t;
+
+int jsval_region_snapshot(jsval_region_t *region,
+		jsval_region_snapshot_t *snapshot_ptr);
+int jsval_region_restore(jsval_region_t *region,
+		const jsval_region_snapshot_t *snapshot);
+
+/*
+ * Evacuating compaction: copy everything reachable from src's root into
+ * the empty region dst (freshly jsval_region_init'ed), rewriting
+ * offsets, and make the copy dst's root. Cost is proportional to live
+ * data; garbage is never visited. src is left untouched, so on failure
+ * the caller simply keeps using it. Any jsval_t held outside the root
+ * still points into src; re-read the root from dst afterwards.
+ *
+ * The scheduler and fetch transport settings carry over to dst. JSON
+ * docs keep their tokens and skip table but drop lazily built lookup
+ * indexes. The forwarding table is built in dst's free space, so dst
+ * needs headroom beyond the live data (up to about 60 bytes per live
+ * node while the table grows).
+ *
+ * Fails with EBUSY while src has queued microtasks, fetch waitlist
+ * entries or pending promise combinators (compact between turns),
+ * with ENOTSUP if a value that holds host pointers or stream/fetch
+ * state is reachable (RegExp, URL, Request, Response, streams, a
+ * parked promise), with ENOBUFS if dst is too small, and with EINVAL
+ * if dst is not empty.
+ */
+int jsval_region_compact(jsval_region_t *src, jsval_region_t *dst);
+
+/*
+ * Persisted page images. jsval_region_image compacts src into the empty
+ * region dst like jsval_region_compact, but produces a self-contained
+ * image that can be written to disk and mapped by another process:
+ * borrowed JSON bytes are copied in, lookup indexes are prebuilt for
+ * every JSON array and object wide enough to use one, and dst's
+ * total_len is trimmed to the bytes used, so the image is exactly
+ * dst->base[0 .. dst->pages->total_len). Functions (host code
+ * pointers) make it fail with ENOTSUP; other errors are as for
+ * jsval_region_compact.
+ *
+ * jsval_region_map_image attaches a region to an image in memory that
+ * may be mapped read-only (PROT_READ, shared through the page cache).
+ * The pages header is validated (magic, version, header size, lengths
+ * against `len`, root in range); failures return -1 with EINVAL. The
+ * region allocates nothing afterwards: allocation, set_root, release
+ * and restore fail with EROFS, and lookups never cache new indexes.
+ * Values reached from the image are frozen; mutating them writes to
+ * the mapping. Images are host-specific (byte order, struct layout)
+ * and are trusted beyond the header checks.
+ */
+int jsval_region_image(jsval_region_t *src, jsval_region_t *dst);
+int jsval_region_map_image(jsval_region_t *region, const void *buf,
+		size_t len);
+
 int jsval_is_native(jsval_t value);
 int jsval_is_json_backed(jsval_t value);
 
@@ -570,9 +773,176 @@ int jsval_queue_microtask(jsval_region_t *region, jsval_t callback);
 size_t jsval_microtask_pending(jsval_region_t *region);
 int jsval_microtask_drain(jsval_region_t *region, jsmethod_error_t *error);
 int jsval_object_new(jsval_region_t *region, size_t cap, jsval_t *value_ptr);
+
+/*
+ * Object shapes for key sets known at translation time ({id, name,
+ * score} literals, DTOs). Register the key list once per region with
+ * jsval_shape_new_utf8 (keys must be distinct), then create objects
+ * with jsval_object_new_shaped: they store only the values, in key
+ * order, all starting undefined, and share the shape's keys.
+ *
+ * jsval_object_get_slot / jsval_object_set_slot read and write slot k
+ * (the k-th key of `shape`) directly. Shaped objects are ordinary
+ * objects to the rest of the API; adding or deleting a key moves one
+ * to dictionary mode, after which the slot calls fall back to a
+ * lookup by the slot's key, so they stay correct on any object.
+ *
+ * A shape lives in the region like any value (compaction carries it
+ * along with the objects using it, but a jsval_shape_t held outside
+ * the region must be re-created afterwards). Errors: EINVAL for a bad
+ * shape, slot or duplicate key, ENOBUFS when a dictionary object is
+ * full, EBUSY when a shaped object older than an active mark or
+ * snapshot would need to move to dictionary mode.
+ */
+typedef struct jsval_shape_s {
+	jsval_off_t off;
+} jsval_shape_t;
+
+int jsval_shape_new_utf8(jsval_region_t *region, const uint8_t *const *keys,
+		const size_t *key_lens, size_t len, jsval_shape_t *shape_ptr);
+int jsval_object_new_shaped(jsval_region_t *region, jsval_shape_t shape,
+		jsval_t *value_ptr);
+int jsval_object_get_slot(jsval_region_t *region, jsval_t object,
+		jsval_shape_t shape, size_t slot, jsval_t *value_ptr);
+int jsval_object_set_slot(jsval_region_t *region, jsval_t object,
+		jsval_shape_t shape, size_t slot, jsval_t value);
+
+/*
+ * Property-name atoms. jsval_object_set_utf8, and so JSON promotion
+ * and jsval_shape_new_utf8, interns each new key in a per-region
+ * table: every object naming "id" shares one JSSTR8 string, and a key
+ * passed back as that string matches by offset before any byte
+ * compare. jsval_atom_utf8 returns the atom for `key`, interning it if
+ * needed, for use with the jsval_object_*_key calls.
+ *
+ * jsval_atom_hash is the key hash of the native object index, FNV-1a
+ * over code points. It does not depend on the region or the build, so
+ * a translator can emit it as a constant and pass it to
+ * jsval_object_get_utf8_hashed, which then skips hashing `key` (JSON
+ * objects ignore it).
+ *
+ * Atoms are ordinary region strings: release and restore forget the
+ * ones they reclaim, and compaction does not carry the table over.
+ */
+int jsval_atom_utf8(jsval_region_t *region, const uint8_t *key,
+		size_t key_len, jsval_t *atom_ptr);
+uint32_t jsval_atom_hash(const uint8_t *key, size_t key_len);
+int jsval_object_get_utf8_hashed(jsval_region_t *region, jsval_t object,
+		const uint8_t *key, size_t key_len, uint32_t hash,
+		jsval_t *value_ptr);
 int jsval_array_new(jsval_region_t *region, size_t cap, jsval_t *value_ptr);
 
 int jsval_json_parse(jsval_region_t *region, const uint8_t *json, size_t len, unsigned int token_cap, jsval_t *value_ptr);
+
+/*
+ * Count the jsmn tokens a parse of `json` would allocate, without
+ * touching a region. jsval_json_parse_auto runs this pre-pass and
+ * parses with exactly that token_cap, so the pool never over-reserves
+ * and never fails with JSMN_ERROR_NOMEM. Errors are jsmn's
+ * JSMN_ERROR_* codes, as for jsval_json_parse; the counting pass does
+ * not match brackets, so mismatched nesting is reported by the parse.
+ */
+int jsval_json_measure_tokens(const uint8_t *json, size_t len,
+		unsigned int *token_count_ptr);
+int jsval_json_parse_auto(jsval_region_t *region, const uint8_t *json,
+		size_t len, jsval_t *value_ptr);
+
+/*
+ * Zero-copy variant of jsval_json_parse: the resulting doc references
+ * the caller's `json` bytes instead of copying them into the region, so
+ * only the doc header, tokens and side tables are allocated. The input
+ * need not be NUL-terminated.
+ *
+ * Lifetime: the caller must keep `json[0..len)` alive and unmodified
+ * for as long as any value reachable from the returned doc (including
+ * values produced by jsval_object_get_utf8, iterators, and the region
+ * root) is read. jsval_promote / jsval_copy_json detach what they
+ * produce from the borrowed bytes.
+ *
+ * The doc stores the address of the borrowed bytes. It survives
+ * jsval_region_rebase unchanged as long as those bytes stay put; when
+ * they have moved too (e.g. a body buffer remapped into another
+ * process alongside the region image), re-point the doc with
+ * jsval_json_rebind_borrowed, passing any value from it and the same
+ * `len`. Rebinding an owned (jsval_json_parse) doc or a mismatched
+ * length fails with EINVAL.
+ */
+int jsval_json_parse_borrowed(jsval_region_t *region, const uint8_t *json,
+		size_t len, unsigned int token_cap, jsval_t *value_ptr);
+int jsval_json_rebind_borrowed(jsval_region_t *region, jsval_t value,
+		const uint8_t *json, size_t len);
+
+/*
+ * Opt the document holding `value` into keyed lookup indexes. Lookups
+ * into its JSON-backed objects normally scan the keys in order; after
+ * this call the first jsval_object_get_utf8 / jsval_object_has_own_utf8
+ * on an object with 16 or more keys builds a hash table for it, so
+ * repeated field reads on wide records are O(1). The table is cached
+ * in the region and costs (1 + 2 * cap) * 4 bytes per indexed object
+ * (cap being the power of two at or above twice its key count), plus
+ * 4 bytes per token of the doc once, on the first index of any kind.
+ * Lookups fall back to the scan when the region cannot fit the table
+ * or an active mark predates the doc. Region images prebuild the
+ * tables for every doc. Fails with EINVAL for a non-JSON value and
+ * EROFS on a read-only region whose doc was not indexed.
+ *
+ * jsval_json_index_arrays does the same for indexed reads: after it,
+ * the first jsval_array_get past element 0 of an array with 8 or more
+ * elements caches a table of its element tokens, 4 bytes per element
+ * (plus the same one-off per-token slots), so indexed loops are O(1)
+ * per read instead of walking the siblings. Without it, reads on
+ * JSON-backed arrays and objects never allocate.
+ */
+int jsval_json_index_objects(jsval_region_t *region, jsval_t value);
+int jsval_json_index_arrays(jsval_region_t *region, jsval_t value);
+
+/*
+ * Projection: read a handful of paths out of a large document without
+ * tokenizing the rest of it.
+ *
+ * A path is a dotted key chain with optional array steps, e.g.
+ * "user.id", "items[0]" or "items[*].sku"; "" selects the whole
+ * document. jsval_json_path_compile parses it once into a reusable
+ * jsval_json_path_t; key segments point into `path`, which must stay
+ * alive as long as the compiled form is used.
+ *
+ * jsval_json_project scans `json` once, balancing brackets and quotes
+ * to skip every subtree no path leads into, and tokenizes only the
+ * matched values. values[i] receives a JSON-backed value for
+ * paths[i], or undefined when the path is absent (the first of
+ * duplicate keys wins). A path containing [*] yields a native array of
+ * its JSON-backed matches in document order, empty when none match.
+ * Each match is copied into the region as its own doc, so region and
+ * token use follow what is read rather than the document size. At most
+ * 64 paths per call; malformed structure on the scanned route fails
+ * with EINVAL, while skipped subtrees are only checked for balance.
+ */
+#define JSVAL_JSON_PATH_MAX_SEGMENTS 8
+
+typedef enum jsval_json_path_kind_e {
+	JSVAL_JSON_PATH_KEY = 0,
+	JSVAL_JSON_PATH_INDEX = 1,
+	JSVAL_JSON_PATH_ANY = 2
+} jsval_json_path_kind_t;
+
+typedef struct jsval_json_path_segment_s {
+	const uint8_t *key;
+	size_t key_len;
+	uint32_t index;
+	uint8_t kind;
+} jsval_json_path_segment_t;
+
+typedef struct jsval_json_path_s {
+	size_t segment_count;
+	uint8_t wildcard;
+	jsval_json_path_segment_t segments[JSVAL_JSON_PATH_MAX_SEGMENTS];
+} jsval_json_path_t;
+
+int jsval_json_path_compile(const char *path, size_t len,
+		jsval_json_path_t *path_ptr);
+int jsval_json_project(jsval_region_t *region, const uint8_t *json,
+		size_t len, const jsval_json_path_t *paths, size_t path_count,
+		jsval_t *values);
 int jsval_promote(jsval_region_t *region, jsval_t value, jsval_t *value_ptr);
 int jsval_promote_in_place(jsval_region_t *region, jsval_t *value_ptr);
 int jsval_region_promote_root(jsval_region_t *region, jsval_t *value_ptr);
@@ -1491,6 +1861,50 @@ int jsval_response_body_source_off(jsval_region_t *region,
 int jsval_request_body_source_off(jsval_region_t *region,
 		jsval_t request, jsval_off_t *out);
 
+/*
+ * NDJSON / JSON Lines reader over a body source.
+ *
+ * Bytes are pulled from `vtable` into the caller's `buf` (which must
+ * fit the longest record), split on '\n' (a trailing '\r' is dropped
+ * and blank lines are skipped), and each record is tokenized in place
+ * (no copy, as jsval_json_parse_borrowed) and handed to `record`. The
+ * region is rolled back to its state before the record once the
+ * callback returns (jsval_region_mark/release), so memory use stays
+ * flat however long the input is. The callback must therefore copy out
+ * anything it needs to keep, and must leave no microtasks, fetch
+ * waitlist entries or promise combinators queued that it created; if
+ * it does, the run stops with EBUSY.
+ *
+ * jsval_ndjson_reader_run returns 1 once the source reached EOF and
+ * every record was delivered, 0 when the source reported PENDING or
+ * returned no bytes (call again after more bytes arrive; partial lines
+ * are kept), and -1 with errno on failure: EINVAL for a malformed
+ * record (line_no names it), ENOBUFS for a record longer than `cap`,
+ * EIO for a source error. The callback returns 0 to continue or -1
+ * with errno set to stop the run. A record that fails, malformed or
+ * rejected by the callback, is consumed: calling run again resumes
+ * with the line after it.
+ */
+typedef int (*jsval_ndjson_record_fn)(jsval_region_t *region, void *ctx,
+		jsval_t record, size_t line_no);
+
+typedef struct jsval_ndjson_reader_s {
+	const jsval_body_source_vtable_t *vtable;
+	void *userdata;
+	uint8_t *buf;
+	size_t cap;
+	size_t len;
+	size_t line_no;
+	uint8_t eof;
+} jsval_ndjson_reader_t;
+
+void jsval_ndjson_reader_init(jsval_ndjson_reader_t *reader,
+		const jsval_body_source_vtable_t *vtable, void *userdata,
+		uint8_t *buf, size_t cap);
+int jsval_ndjson_reader_run(jsval_region_t *region,
+		jsval_ndjson_reader_t *reader, jsval_ndjson_record_fn record,
+		void *ctx);
+
 /*
  * ReadableStream: minimal WHATWG-shaped facade over the body-source vtable.
  *
@@ -1623,6 +2037,72 @@ int jsval_writable_stream_abort(jsval_region_t *region, jsval_t stream,
 int jsval_writable_stream_sink_off(jsval_region_t *region, jsval_t stream,
 		jsval_off_t *out);
 
+/*
+ * Chunked JSON emitter into an underlying sink.
+ *
+ * Serializes `value` as jsval_copy_json would, but a `chunk_cap`-sized
+ * piece at a time into the caller's `chunk`, handing each full chunk
+ * (and the final partial one) to `vtable->write`. No full-size staging
+ * buffer and no measuring pass are needed. Between chunks the emitter
+ * keeps its place in `state`: the child index and output offset of
+ * each open native container, plus the source position inside a string
+ * or JSON span that spilled over, so a resumed pass descends straight
+ * to where the previous chunk stopped instead of re-walking the value.
+ * `value` must not be mutated until the stream completes.
+ *
+ * jsval_json_sink_stream_run returns 1 once every byte was accepted,
+ * 0 when the sink applied backpressure (PENDING, or READY accepting
+ * nothing; call again once it drains), and -1 with errno on failure:
+ * EIO with *error_value set when the sink reported ERROR, otherwise
+ * the jsval_copy_json errors (ENOTSUP, ELOOP, EOVERFLOW, ...). The
+ * sink's close() is not called; the caller owns the sink's lifetime.
+ */
+#define JSVAL_JSON_EMIT_MAX_DEPTH 256
+
+typedef struct jsval_json_emit_frame_s {
+	size_t index;
+	size_t len;
+	size_t emitted;
+} jsval_json_emit_frame_t;
+
+typedef struct jsval_json_emit_state_s {
+	uint8_t *buf;
+	size_t cap;
+	size_t len;
+	jsval_off_t stack[JSVAL_JSON_EMIT_MAX_DEPTH];
+	size_t depth;
+	/* Chunked mode: output bytes [skip, skip + cap) land in buf[0..fill). */
+	uint8_t chunked;
+	uint8_t full;
+	size_t skip;
+	size_t fill;
+	size_t resume_depth;
+	size_t resume_next;
+	jsval_json_emit_frame_t resume[JSVAL_JSON_EMIT_MAX_DEPTH];
+	/* The leaf a chunk filled inside: output offset of its first byte,
+	 * and the source position and output offset to pick up from. */
+	uint8_t leaf_pending;
+	uint8_t leaf_in_string;
+	size_t leaf_at;
+	size_t leaf_pos;
+	size_t leaf_len;
+} jsval_json_emit_state_t;
+
+typedef struct jsval_json_sink_stream_s {
+	const jsval_underlying_sink_vtable_t *vtable;
+	void *userdata;
+	jsval_t value;
+	size_t sent;
+	uint8_t done;
+	jsval_json_emit_state_t state;
+} jsval_json_sink_stream_t;
+
+void jsval_json_sink_stream_init(jsval_json_sink_stream_t *stream,
+		jsval_t value, const jsval_underlying_sink_vtable_t *vtable,
+		void *userdata, uint8_t *chunk, size_t chunk_cap);
+int jsval_json_sink_stream_run(jsval_region_t *region,
+		jsval_json_sink_stream_t *stream, jsval_t *error_value);
+
 /*
  * TransformStream: WHATWG-shaped composition of a ReadableStream
  * and a WritableStream connected through a C-callable transformer.
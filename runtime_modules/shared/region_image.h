@@ -0,0 +1,172 @@
+#ifndef JSMX_RUNTIME_MODULES_SHARED_REGION_IMAGE_H
+#define JSMX_RUNTIME_MODULES_SHARED_REGION_IMAGE_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "jsval.h"
+
+/*
+ * Region page images on disk.
+ *
+ * Large static datasets (routing tables, feature-flag JSON, lookup
+ * maps) can be built once into a region with jsval_region_image, saved
+ * here, and mapped back read-only by every worker: loading is an mmap
+ * plus a header check, no parsing, and the pages are shared across
+ * processes through the page cache.
+ *
+ *   - save writes dst->base[0 .. total_len) of an image region to
+ *     `path` through a temporary file and rename, so readers never see
+ *     a partial image.
+ *   - load maps the file PROT_READ / MAP_SHARED and attaches `region`
+ *     with jsval_region_map_image; the region is read-only (see
+ *     jsval.h).
+ *   - unload unmaps it; values read from the region are dead after.
+ *
+ * Images carry no byte-order or ABI tag beyond the pages header, so
+ * only load them on the build that saved them.
+ *
+ * This file is header-only. It follows the same pattern as
+ * `runtime_modules/shared/faas_bridge.h`.
+ */
+
+typedef struct runtime_region_image_s {
+	void *base;
+	size_t len;
+} runtime_region_image_t;
+
+/*
+ * Write an image region (from jsval_region_image) to `path`. Returns 0,
+ * or -1 with errno: EINVAL for a region that is not a trimmed image,
+ * or whatever open/write/rename reported.
+ */
+static int runtime_region_image_save(jsval_region_t *region,
+		const char *path)
+{
+	const jsval_pages_t *pages = jsval_region_pages(region);
+	char tmp_path[4096];
+	const uint8_t *bytes;
+	size_t left;
+	int fd;
+	int saved;
+
+	if (pages == NULL || path == NULL || pages->used_len != pages->total_len
+			|| snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path)
+			>= (int)sizeof(tmp_path)) {
+		errno = EINVAL;
+		return -1;
+	}
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return -1;
+	}
+	bytes = (const uint8_t *)pages;
+	left = pages->total_len;
+	while (left > 0) {
+		ssize_t n = write(fd, bytes, left);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			goto fail;
+		}
+		bytes += n;
+		left -= (size_t)n;
+	}
+	if (fsync(fd) < 0) {
+		goto fail;
+	}
+	if (close(fd) < 0) {
+		fd = -1;
+		goto fail;
+	}
+	if (rename(tmp_path, path) < 0) {
+		saved = errno;
+		(void)unlink(tmp_path);
+		errno = saved;
+		return -1;
+	}
+	return 0;
+
+fail:
+	saved = errno;
+	if (fd >= 0) {
+		(void)close(fd);
+	}
+	(void)unlink(tmp_path);
+	errno = saved;
+	return -1;
+}
+
+/*
+ * Map the image at `path` read-only and attach `region` to it. Returns
+ * 0, or -1 with errno: EINVAL if the file is not a valid image, or
+ * whatever open/fstat/mmap reported.
+ */
+static int runtime_region_image_load(runtime_region_image_t *image,
+		const char *path, jsval_region_t *region)
+{
+	struct stat st;
+	void *base;
+	int fd;
+	int saved;
+
+	if (image == NULL || path == NULL || region == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return -1;
+	}
+	if (fstat(fd, &st) < 0) {
+		saved = errno;
+		(void)close(fd);
+		errno = saved;
+		return -1;
+	}
+	if (st.st_size < (off_t)jsval_pages_head_size()
+			|| (uint64_t)st.st_size > UINT32_MAX) {
+		(void)close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+	base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	saved = errno;
+	(void)close(fd);
+	if (base == MAP_FAILED) {
+		errno = saved;
+		return -1;
+	}
+	if (jsval_region_map_image(region, base, (size_t)st.st_size) < 0) {
+		(void)munmap(base, (size_t)st.st_size);
+		errno = EINVAL;
+		return -1;
+	}
+	image->base = base;
+	image->len = (size_t)st.st_size;
+	return 0;
+}
+
+static void runtime_region_image_unload(runtime_region_image_t *image,
+		jsval_region_t *region)
+{
+	if (image == NULL || image->base == NULL) {
+		return;
+	}
+	(void)munmap(image->base, image->len);
+	image->base = NULL;
+	image->len = 0;
+	if (region != NULL) {
+		memset(region, 0, sizeof(*region));
+	}
+}
+
+#endif
@@ -0,0 +1,265 @@
+#ifndef JSMX_RUNTIME_MODULES_SHARED_REGION_POOL_H
+#define JSMX_RUNTIME_MODULES_SHARED_REGION_POOL_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "jsval.h"
+
+/*
+ * Per-request region pool.
+ *
+ * The FaaS lifecycle (docs/fetch.md) gives every request a fresh
+ * region and frees it afterwards. Mapping and first-touching a new
+ * buffer per request costs page faults and kernel zeroing on the hot
+ * path. This pool keeps released buffers on per-size-class free lists
+ * (power-of-two sizes starting at `min_size`) and hands them back out:
+ *
+ *   - acquire pops a buffer of the smallest class that fits and
+ *     re-attaches it with jsval_region_rebase; only the pages header
+ *     was reset on release, so nothing is memset and no page faults.
+ *   - new buffers are mapped pre-faulted (MAP_POPULATE, or touched
+ *     page by page), optionally from hugetlbfs (MAP_HUGETLB, classes
+ *     that are a multiple of 2 MiB; falls back to normal pages when
+ *     none are reserved) or advised for transparent huge pages.
+ *   - release resets the header and pushes the buffer back, or unmaps
+ *     it once its class holds RUNTIME_REGION_POOL_MAX_FREE buffers.
+ *
+ * Released bytes are NOT scrubbed, so one pool must only serve one
+ * trust domain (tenant / worker). Not thread-safe; keep one pool per
+ * worker thread.
+ *
+ * This file is header-only. It follows the same pattern as
+ * `runtime_modules/shared/faas_bridge.h`.
+ */
+
+#define RUNTIME_REGION_POOL_CLASSES 8
+#define RUNTIME_REGION_POOL_MAX_FREE 32
+#define RUNTIME_REGION_POOL_HUGE_PAGE ((size_t)2 << 20)
+
+typedef enum runtime_region_pool_flags_e {
+	RUNTIME_REGION_POOL_PREFAULT = 1,
+	RUNTIME_REGION_POOL_HUGETLB = 2,
+	RUNTIME_REGION_POOL_THP = 4
+} runtime_region_pool_flags_t;
+
+typedef struct runtime_region_pool_class_s {
+	size_t size;
+	size_t free_count;
+	void *free[RUNTIME_REGION_POOL_MAX_FREE];
+} runtime_region_pool_class_t;
+
+typedef struct runtime_region_pool_s {
+	unsigned int flags;
+	size_t mapped;    /* buffers mapped over the pool's lifetime */
+	size_t reused;    /* acquires served from a free list */
+	runtime_region_pool_class_t classes[RUNTIME_REGION_POOL_CLASSES];
+} runtime_region_pool_t;
+
+/*
+ * Set up the size classes: min_size rounded up to a page, then twice
+ * that, ... Each class, the largest included, must stay within
+ * jsval_off_t range (4 GiB). Returns 0, or -1 with errno=EINVAL for a
+ * too small or oversized min_size.
+ */
+static int runtime_region_pool_init(runtime_region_pool_t *pool,
+		size_t min_size, unsigned int flags)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t size;
+	int i;
+
+	if (pool == NULL || min_size < jsval_pages_head_size()
+			|| min_size > (UINT32_MAX >> (RUNTIME_REGION_POOL_CLASSES - 1))) {
+		errno = EINVAL;
+		return -1;
+	}
+	/* The page rounding can push the largest class past the limit. */
+	size = (min_size + page - 1) / page * page;
+	if (size > (UINT32_MAX >> (RUNTIME_REGION_POOL_CLASSES - 1))) {
+		errno = EINVAL;
+		return -1;
+	}
+	memset(pool, 0, sizeof(*pool));
+	pool->flags = flags;
+	for (i = 0; i < RUNTIME_REGION_POOL_CLASSES; i++) {
+		pool->classes[i].size = size;
+		size *= 2;
+	}
+	return 0;
+}
+
+static runtime_region_pool_class_t *runtime_region_pool_class(
+		runtime_region_pool_t *pool, size_t size)
+{
+	int i;
+
+	for (i = 0; i < RUNTIME_REGION_POOL_CLASSES; i++) {
+		if (pool->classes[i].size >= size) {
+			return &pool->classes[i];
+		}
+	}
+	return NULL;
+}
+
+static void *runtime_region_pool_map(runtime_region_pool_t *pool,
+		size_t size)
+{
+	int prot = PROT_READ | PROT_WRITE;
+	int base_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	void *buf = MAP_FAILED;
+
+#ifdef MAP_POPULATE
+	if (pool->flags & RUNTIME_REGION_POOL_PREFAULT) {
+		base_flags |= MAP_POPULATE;
+	}
+#endif
+#ifdef MAP_HUGETLB
+	if ((pool->flags & RUNTIME_REGION_POOL_HUGETLB)
+			&& size % RUNTIME_REGION_POOL_HUGE_PAGE == 0) {
+		buf = mmap(NULL, size, prot, base_flags | MAP_HUGETLB, -1, 0);
+	}
+#endif
+	if (buf == MAP_FAILED) {
+		buf = mmap(NULL, size, prot, base_flags, -1, 0);
+		if (buf == MAP_FAILED) {
+			return NULL;
+		}
+#ifdef MADV_HUGEPAGE
+		if (pool->flags & RUNTIME_REGION_POOL_THP) {
+			(void)madvise(buf, size, MADV_HUGEPAGE);
+		}
+#endif
+	}
+#ifndef MAP_POPULATE
+	if (pool->flags & RUNTIME_REGION_POOL_PREFAULT) {
+		size_t page = (size_t)sysconf(_SC_PAGESIZE);
+		volatile uint8_t *bytes = (volatile uint8_t *)buf;
+		size_t off;
+
+		for (off = 0; off < size; off += page) {
+			bytes[off] = 0;
+		}
+	}
+#endif
+	pool->mapped++;
+	return buf;
+}
+
+/*
+ * Map `count` buffers of the class fitting `size` ahead of time, so
+ * the first requests after startup also skip the fault path.
+ */
+static int runtime_region_pool_prefill(runtime_region_pool_t *pool,
+		size_t size, size_t count)
+{
+	runtime_region_pool_class_t *cls;
+
+	if (pool == NULL || (cls = runtime_region_pool_class(pool, size)) == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	while (count-- > 0 && cls->free_count < RUNTIME_REGION_POOL_MAX_FREE) {
+		jsval_region_t region;
+		void *buf = runtime_region_pool_map(pool, cls->size);
+
+		if (buf == NULL) {
+			errno = ENOMEM;
+			return -1;
+		}
+		/* Write the pages header now so acquire can rebase onto it. */
+		jsval_region_init(&region, buf, cls->size);
+		cls->free[cls->free_count++] = buf;
+	}
+	return 0;
+}
+
+/*
+ * Hand out an empty region of at least `size` bytes. Returns 0, or -1
+ * with errno: EINVAL if `size` exceeds the largest class or the class
+ * cannot hold a region, ENOMEM if a new buffer could not be mapped.
+ */
+static int runtime_region_pool_acquire(runtime_region_pool_t *pool,
+		size_t size, jsval_region_t *region)
+{
+	runtime_region_pool_class_t *cls;
+	void *buf;
+
+	if (pool == NULL || region == NULL
+			|| (cls = runtime_region_pool_class(pool, size)) == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (cls->free_count > 0) {
+		buf = cls->free[--cls->free_count];
+		jsval_region_rebase(region, buf, cls->size);
+		if (jsval_region_pages(region) != NULL) {
+			pool->reused++;
+			return 0;
+		}
+		/* Header was clobbered while out of the pool: start over. */
+	} else if ((buf = runtime_region_pool_map(pool, cls->size)) == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+	jsval_region_init(region, buf, cls->size);
+	if (jsval_region_pages(region) == NULL) {
+		(void)munmap(buf, cls->size);
+		memset(region, 0, sizeof(*region));
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Return a region obtained from runtime_region_pool_acquire. Any
+ * jsval_t into it is dead afterwards. Returns 0, or -1 with
+ * errno=EINVAL if the region does not match a pool class.
+ */
+static int runtime_region_pool_release(runtime_region_pool_t *pool,
+		jsval_region_t *region)
+{
+	runtime_region_pool_class_t *cls;
+	jsval_pages_t *pages;
+
+	if (pool == NULL || region == NULL || region->base == NULL
+			|| (cls = runtime_region_pool_class(pool, region->len)) == NULL
+			|| cls->size != region->len) {
+		errno = EINVAL;
+		return -1;
+	}
+	/* Reset just the header; rebase on acquire trusts it. */
+	pages = (jsval_pages_t *)region->base;
+	pages->used_len = (uint32_t)jsval_pages_head_size();
+	pages->total_len = (uint32_t)cls->size;
+	pages->root = jsval_undefined();
+	if (cls->free_count < RUNTIME_REGION_POOL_MAX_FREE) {
+		cls->free[cls->free_count++] = region->base;
+	} else {
+		(void)munmap(region->base, cls->size);
+	}
+	memset(region, 0, sizeof(*region));
+	return 0;
+}
+
+static void runtime_region_pool_destroy(runtime_region_pool_t *pool)
+{
+	int i;
+
+	if (pool == NULL) {
+		return;
+	}
+	for (i = 0; i < RUNTIME_REGION_POOL_CLASSES; i++) {
+		runtime_region_pool_class_t *cls = &pool->classes[i];
+
+		while (cls->free_count > 0) {
+			(void)munmap(cls->free[--cls->free_count], cls->size);
+		}
+	}
+}
+
+#endif
@@ -139,6 +139,39 @@ int test_string(void) {
 	return 0;
 }
 
+int test_string_escaped(void) {
+	jsmn_parser p;
+	jsmntok_t t[8];
+	const char *js = "{\"a\":\"x\",\"b\\n\":\"\\u0041\"}";
+
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), t, 8) == 5);
+	check(t[0].escaped == 0);
+	check(t[1].escaped == 0);
+	check(t[2].escaped == 0);
+	check(t[3].escaped == 1);
+	check(t[4].escaped == 1);
+	return 0;
+}
+
+int test_long_runs(void) {
+	/* Runs longer than one scan block, with stops at every offset. */
+	check(parse("{\"a\":\"0123456789abcdef0123456789abcdef0123456789\"}", 3, 3,
+				JSMN_OBJECT, -1, -1, 1,
+				JSMN_STRING, "a", 1,
+				JSMN_STRING, "0123456789abcdef0123456789abcdef0123456789", 0));
+	check(parse("[\"0123456789abcdef0123456789abcdef\\\"0123456789\\\\\"]", 2, 2,
+				JSMN_ARRAY, -1, -1, 1,
+				JSMN_STRING, "0123456789abcdef0123456789abcdef\\\"0123456789\\\\", 0));
+	check(parse("{\n                                        \"k\" :\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t 1\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n}", 3, 3,
+				JSMN_OBJECT, -1, -1, 1,
+				JSMN_STRING, "k", 1,
+				JSMN_PRIMITIVE, "1"));
+	check(parse("[\"0123456789abcdef0123456789abcdef0123456789", JSMN_ERROR_PART, 2));
+	check(parse("[                                                 ", JSMN_ERROR_PART, 1));
+	return 0;
+}
+
 int test_partial_string(void) {
 	int i;
 	int r;
@@ -164,6 +197,41 @@ int test_partial_string(void) {
 	return 0;
 }
 
+int test_partial_long_string(void) {
+	int i;
+	int r;
+	jsmn_parser p;
+	jsmntok_t tok[2];
+	char js[4100];
+
+	js[0] = '[';
+	js[1] = '"';
+	memset(js + 2, 'a', 4094);
+	js[4096] = '\\';
+	js[4097] = 'n';
+	js[4098] = '"';
+	js[4099] = ']';
+
+	/* Each feed resumes the string where the last one stopped. */
+	jsmn_init(&p);
+	for (i = 16; i < 4096; i += 16) {
+		r = jsmn_parse(&p, js, i, tok, 2);
+		check(r == JSMN_ERROR_PART);
+		check(p.pos == 1);
+		check(p.strpos == (unsigned int)i);
+	}
+	/* An escape cut in half is read again from its backslash. */
+	r = jsmn_parse(&p, js, 4097, tok, 2);
+	check(r == JSMN_ERROR_PART);
+	check(p.strpos == 4096);
+	r = jsmn_parse(&p, js, sizeof(js), tok, 2);
+	check(r == 2);
+	check(p.strpos == 0);
+	check(tok[1].type == JSMN_STRING && tok[1].start == 2 && tok[1].end == 4098);
+	check(tok[1].escaped == 1);
+	return 0;
+}
+
 int test_partial_array(void) {
 #ifdef JSMN_STRICT
 	int r;
@@ -545,8 +613,11 @@ int main(void) {
 	test(test_array, "test for a JSON arrays");
 	test(test_primitive, "test primitive JSON data types");
 	test(test_string, "test string JSON data types");
+	test(test_string_escaped, "test string escape marking");
+	test(test_long_runs, "test strings and whitespace longer than a scan block");
 
 	test(test_partial_string, "test partial JSON string parsing");
+	test(test_partial_long_string, "test partial string parsing resumes its scan");
 	test(test_partial_array, "test partial array reading");
 	test(test_array_nomem, "test array reading with a smaller number of tokens");
 	test(test_unquoted_keys, "test unquoted keys (like in JavaScript)");
@@ -6,6 +6,8 @@
 
 #include "jsval.h"
 #include "runtime_modules/shared/faas_bridge.h"
+#include "runtime_modules/shared/region_image.h"
+#include "runtime_modules/shared/region_pool.h"
 
 /* ---------- Fake body source (copied pattern from test_jsval) ---------- */
 
@@ -1257,6 +1259,134 @@ static void test_mock_transport_two_concurrent(void)
 
 /* ---------- Driver ---------- */
 
+static void test_region_pool_reuse(void)
+{
+	runtime_region_pool_t pool;
+	jsval_region_t region;
+	jsval_region_t big;
+	jsval_t root;
+	jsval_t value;
+	uint8_t *first_base;
+
+	assert(runtime_region_pool_init(&pool, 65536,
+			RUNTIME_REGION_POOL_PREFAULT | RUNTIME_REGION_POOL_THP) == 0);
+	assert(runtime_region_pool_prefill(&pool, 65536, 1) == 0);
+	assert(pool.mapped == 1);
+
+	/* Steady state: the same buffer comes back, header reset only. */
+	assert(runtime_region_pool_acquire(&pool, 10000, &region) == 0);
+	assert(pool.reused == 1);
+	assert(region.len == 65536);
+	first_base = region.base;
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"request one", 11,
+			&value) == 0);
+	assert(jsval_region_set_root(&region, value) == 0);
+	assert(runtime_region_pool_release(&pool, &region) == 0);
+	assert(region.base == NULL);
+
+	assert(runtime_region_pool_acquire(&pool, 65536, &region) == 0);
+	assert(region.base == first_base);
+	assert(pool.reused == 2 && pool.mapped == 1);
+	assert(region.used == jsval_pages_head_size());
+	assert(jsval_region_root(&region, &root) == 0);
+	assert(root.kind == JSVAL_KIND_UNDEFINED);
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"request two", 11,
+			&value) == 0);
+	/* A header that drifted while out is fully reset on release. */
+	((jsval_pages_t *)region.base)->total_len = 4096;
+	assert(runtime_region_pool_release(&pool, &region) == 0);
+	assert(runtime_region_pool_acquire(&pool, 65536, &region) == 0);
+	assert(region.base == first_base);
+	assert(jsval_region_pages(&region)->total_len == 65536);
+
+	/* Larger requests get the next class; too large is refused. */
+	assert(runtime_region_pool_acquire(&pool, 65537, &big) == 0);
+	assert(big.len == 131072 && pool.mapped == 2);
+	assert(runtime_region_pool_release(&pool, &big) == 0);
+	errno = 0;
+	assert(runtime_region_pool_acquire(&pool, (size_t)65536 << 8,
+			&big) == -1);
+	assert(errno == EINVAL);
+	assert(pool.classes[1].free_count == 1);
+
+	assert(runtime_region_pool_release(&pool, &region) == 0);
+	errno = 0;
+	assert(runtime_region_pool_release(&pool, &region) == -1);
+	assert(errno == EINVAL);
+	runtime_region_pool_destroy(&pool);
+	assert(pool.classes[0].free_count == 0);
+
+	/* Hugepage request falls back to normal pages when none exist. */
+	assert(runtime_region_pool_init(&pool, RUNTIME_REGION_POOL_HUGE_PAGE,
+			RUNTIME_REGION_POOL_HUGETLB) == 0);
+	assert(runtime_region_pool_acquire(&pool, 4096, &region) == 0);
+	assert(region.len == RUNTIME_REGION_POOL_HUGE_PAGE);
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"huge", 4,
+			&value) == 0);
+	assert(runtime_region_pool_release(&pool, &region) == 0);
+	runtime_region_pool_destroy(&pool);
+
+	/* The top class is checked after rounding min_size to a page. */
+	errno = 0;
+	assert(runtime_region_pool_init(&pool,
+			(UINT32_MAX >> (RUNTIME_REGION_POOL_CLASSES - 1)) - 1, 0) == -1);
+	assert(errno == EINVAL);
+}
+
+static void test_region_image_file(void)
+{
+	static const char routes[] =
+		"{\"/\":\"index\",\"/api\":\"api\",\"/health\":\"health\"}";
+	static uint8_t src_storage[8192];
+	static uint8_t dst_storage[8192];
+	char path[] = "/tmp/jsmx_region_image_XXXXXX";
+	runtime_region_image_t image;
+	jsval_region_t src;
+	jsval_region_t dst;
+	jsval_region_t mapped;
+	jsval_t root;
+	jsval_t value;
+	uint8_t buf[16];
+	size_t len;
+	int fd;
+
+	jsval_region_init(&src, src_storage, sizeof(src_storage));
+	assert(jsval_json_parse(&src, (const uint8_t *)routes,
+			sizeof(routes) - 1, 16, &root) == 0);
+	assert(jsval_region_set_root(&src, root) == 0);
+	jsval_region_init(&dst, dst_storage, sizeof(dst_storage));
+	assert(jsval_region_image(&src, &dst) == 0);
+
+	fd = mkstemp(path);
+	assert(fd >= 0);
+	close(fd);
+	assert(runtime_region_image_save(&dst, path) == 0);
+	errno = 0;
+	assert(runtime_region_image_save(&src, path) == -1);
+	assert(errno == EINVAL);
+
+	assert(runtime_region_image_load(&image, path, &mapped) == 0);
+	assert(image.len == dst.pages->total_len);
+	assert(jsval_region_root(&mapped, &root) == 0);
+	assert(jsval_object_get_utf8(&mapped, root, (const uint8_t *)"/api", 4,
+			&value) == 0);
+	assert(jsval_string_copy_utf8(&mapped, value, buf, sizeof(buf),
+			&len) == 0);
+	assert(len == 3 && memcmp(buf, "api", 3) == 0);
+	errno = 0;
+	assert(jsval_object_new(&mapped, 1, &value) == -1);
+	assert(errno == EROFS);
+	runtime_region_image_unload(&image, &mapped);
+	assert(image.base == NULL && mapped.base == NULL);
+
+	/* A truncated file is rejected. */
+	assert(truncate(path, 16) == 0);
+	errno = 0;
+	assert(runtime_region_image_load(&image, path, &mapped) == -1);
+	assert(errno == EINVAL);
+	unlink(path);
+}
+
 int main(void)
 {
 	test_plain_handler();
@@ -1278,6 +1408,8 @@ int main(void)
 	test_wintertc_proxy_handler_success();
 	test_wintertc_proxy_handler_upstream_error();
 	test_fetch_waitlist_drives_proxy_handler();
+	test_region_pool_reuse();
+	test_region_image_file();
 	puts("test_faas: ok");
 	return 0;
 }
@@ -5868,6 +5868,105 @@ static void test_map_semantics(void)
 	assert(got.kind == JSVAL_KIND_UNDEFINED);
 }
 
+static void test_collection_hashed_lookup(void)
+{
+	static uint8_t storage[1 << 20];
+	static uint8_t compacted[1 << 20];
+	jsval_region_t region;
+	jsval_region_t dst;
+	jsval_t set;
+	jsval_t map;
+	jsval_t root;
+	jsval_t key;
+	jsval_t got;
+	jsval_t objects[64];
+	char name[16];
+	size_t size;
+	int deleted;
+	int has;
+	int i;
+
+	jsval_region_init(&region, storage, sizeof(storage));
+
+	/* Dedup: every value goes in three times, the set keeps one. */
+	assert(jsval_set_new(&region, 2000, &set) == 0);
+	for (i = 0; i < 3000; i++) {
+		assert(jsval_set_add(&region, set, jsval_number(i % 1000)) == 0);
+	}
+	assert(jsval_set_add(&region, set, jsval_number(NAN)) == 0);
+	assert(jsval_set_add(&region, set, jsval_number(NAN)) == 0);
+	assert(jsval_set_add(&region, set, jsval_number(-0.0)) == 0);
+	assert(jsval_set_size(&region, set, &size) == 0);
+	assert(size == 1001);
+	assert(jsval_set_has(&region, set, jsval_number(999), &has) == 0);
+	assert(has == 1);
+	assert(jsval_set_has(&region, set, jsval_number(1000), &has) == 0);
+	assert(has == 0);
+	assert(jsval_set_has(&region, set, jsval_number(0.0 / 0.0), &has) == 0);
+	assert(has == 1);
+
+	/* Deleting from the middle keeps order and the index in step. */
+	for (i = 0; i < 1000; i += 2) {
+		assert(jsval_set_delete(&region, set, jsval_number(i),
+				&deleted) == 0);
+		assert(deleted == 1);
+	}
+	assert(jsval_set_size(&region, set, &size) == 0);
+	assert(size == 501);
+	for (i = 0; i < 1000; i++) {
+		assert(jsval_set_has(&region, set, jsval_number(i), &has) == 0);
+		assert(has == (i % 2));
+	}
+	assert(jsval_set_add(&region, set, jsval_number(0)) == 0);
+	assert(jsval_set_size(&region, set, &size) == 0);
+	assert(size == 502);
+	assert(jsval_set_clear(&region, set) == 0);
+	assert(jsval_set_has(&region, set, jsval_number(1), &has) == 0);
+	assert(has == 0);
+
+	/* Map keys by string content and object identity. */
+	assert(jsval_map_new(&region, 1100, &map) == 0);
+	for (i = 0; i < 1000; i++) {
+		snprintf(name, sizeof(name), "s%d", i);
+		assert(jsval_string_new_utf8(&region, (const uint8_t *)name,
+				strlen(name), &key) == 0);
+		assert(jsval_map_set(&region, map, key, jsval_number(i)) == 0);
+	}
+	for (i = 0; i < 64; i++) {
+		assert(jsval_object_new(&region, 0, &objects[i]) == 0);
+		assert(jsval_map_set(&region, map, objects[i],
+				jsval_number(-i)) == 0);
+	}
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"s500", 4,
+			&key) == 0);
+	assert(jsval_map_get(&region, map, key, &got) == 0);
+	assert_number_value(got, 500.0);
+	assert(jsval_map_delete(&region, map, key, &deleted) == 0);
+	assert(deleted == 1);
+	assert(jsval_map_key_at(&region, map, 500, &got) == 0);
+	assert_string(&region, got, "s501");
+	assert(jsval_map_get(&region, map, objects[63], &got) == 0);
+	assert_number_value(got, -63.0);
+
+	/* Identity hashes follow the keys through compaction. */
+	assert(jsval_array_new(&region, 2, &root) == 0);
+	assert(jsval_array_push(&region, root, map) == 0);
+	assert(jsval_array_push(&region, root, objects[7]) == 0);
+	assert(jsval_region_set_root(&region, root) == 0);
+	jsval_region_init(&dst, compacted, sizeof(compacted));
+	assert(jsval_region_compact(&region, &dst) == 0);
+	assert(jsval_region_root(&dst, &root) == 0);
+	assert(jsval_array_get(&dst, root, 0, &map) == 0);
+	assert(jsval_array_get(&dst, root, 1, &key) == 0);
+	assert(jsval_map_get(&dst, map, key, &got) == 0);
+	assert_number_value(got, -7.0);
+	assert(jsval_map_key_at(&dst, map, 0, &key) == 0);
+	assert(jsval_map_get(&dst, map, key, &got) == 0);
+	assert_number_value(got, 0.0);
+	assert(jsval_map_size(&dst, map, &size) == 0);
+	assert(size == 1063);
+}
+
 static void test_symbol_semantics(void)
 {
 	static const char json_text[] = "{\"plain\":1}";
@@ -6525,6 +6624,448 @@ static void test_region_alloc_helpers(void)
 	assert(errno == EINVAL);
 }
 
+typedef struct grow_test_pages_s {
+	size_t limit;
+	size_t step;
+	int calls;
+} grow_test_pages_t;
+
+static int grow_test_pages(void *ctx, uint8_t *base, size_t len, size_t need,
+		size_t *len_ptr)
+{
+	grow_test_pages_t *pages = (grow_test_pages_t *)ctx;
+	size_t next = len;
+
+	(void)base;
+	pages->calls++;
+	while (next < need) {
+		next += pages->step;
+	}
+	if (next > pages->limit) {
+		return -1;
+	}
+	*len_ptr = next;
+	return 0;
+}
+
+static void test_region_grow(void)
+{
+	static uint8_t storage[16384];
+	grow_test_pages_t pages = {sizeof(storage), 1024, 0};
+	jsval_region_t region;
+	jsval_t first;
+	jsval_t value;
+	size_t used;
+	int i;
+
+	jsval_region_init(&region, storage, 1024);
+	jsval_region_set_grow(&region, grow_test_pages, &pages);
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"first", 5,
+			&first) == 0);
+
+	/* Well past the initial buffer; earlier values stay put. */
+	for (i = 0; i < 200; i++) {
+		assert(jsval_string_new_utf8(&region,
+				(const uint8_t *)"grown string", 12, &value) == 0);
+	}
+	assert(pages.calls > 0);
+	assert(region.len > 1024 && region.len % 1024 == 0);
+	assert(region.pages->total_len == region.len);
+	assert_json(&region, first, "\"first\"");
+	assert_json(&region, value, "\"grown string\"");
+
+	/* Measuring defers to the allocator; it is asked on demand. */
+	used = region.used;
+	assert(jsval_region_measure_alloc(&region, &used, sizeof(storage), 1)
+			== 0);
+
+	/* Allocator refusal surfaces as ENOBUFS. */
+	errno = 0;
+	assert(jsval_region_alloc(&region, sizeof(storage), 1, NULL) == -1);
+	assert(errno == ENOBUFS);
+
+	/* Fixed-size again once the allocator is removed. */
+	jsval_region_set_grow(&region, NULL, &pages);
+	used = region.used;
+	assert(jsval_region_measure_alloc(&region, &used,
+			region.len - region.used + 1, 1) == -1);
+	jsval_region_init(&region, storage, 1024);
+	assert(region.grow == NULL);
+}
+
+static void test_region_compact(void)
+{
+	static const char json[] = "{\"items\":[1,2,3],\"name\":\"doc\"}";
+	static const char expected[] =
+		"{\"label\":\"live\",\"list\":[{\"n\":1},{\"n\":1},\"tail\"],"
+		"\"doc\":{\"items\":[1,2,3],\"name\":\"doc\"}}";
+	static uint8_t src_storage[65536];
+	static uint8_t dst_storage[16384];
+	uint8_t tiny_storage[512];
+	jsval_region_t src;
+	jsval_region_t dst;
+	jsval_region_t tiny;
+	jsval_t root;
+	jsval_t data;
+	jsval_t list;
+	jsval_t shared;
+	jsval_t value;
+	jsval_t map;
+	jsval_t typed;
+	jsval_t got;
+	jsval_t other;
+	jsval_t pending;
+	size_t size;
+	int i;
+
+	jsval_region_init(&src, src_storage, sizeof(src_storage));
+	assert(jsval_object_new(&src, 4, &data) == 0);
+	for (i = 0; i < 200; i++) {
+		assert(jsval_string_new_utf8(&src,
+				(const uint8_t *)"unreachable garbage", 19, &value) == 0);
+	}
+	assert(jsval_string_new_utf8(&src, (const uint8_t *)"live", 4,
+			&value) == 0);
+	assert(jsval_object_set_utf8(&src, data, (const uint8_t *)"label", 5,
+			value) == 0);
+	assert(jsval_object_new(&src, 1, &shared) == 0);
+	assert(jsval_object_set_utf8(&src, shared, (const uint8_t *)"n", 1,
+			jsval_number(1)) == 0);
+	assert(jsval_array_new(&src, 4, &list) == 0);
+	assert(jsval_array_push(&src, list, shared) == 0);
+	assert(jsval_array_push(&src, list, shared) == 0);
+	assert(jsval_string_new_utf8(&src, (const uint8_t *)"tail", 4,
+			&value) == 0);
+	assert(jsval_array_push(&src, list, value) == 0);
+	assert(jsval_object_set_utf8(&src, data, (const uint8_t *)"list", 4,
+			list) == 0);
+	assert(jsval_json_parse(&src, (const uint8_t *)json, sizeof(json) - 1, 16,
+			&value) == 0);
+	assert(jsval_object_set_utf8(&src, data, (const uint8_t *)"doc", 3,
+			value) == 0);
+	assert(jsval_map_new(&src, 2, &map) == 0);
+	assert(jsval_map_set(&src, map, shared, list) == 0);
+	assert(jsval_typed_array_new(&src, JSVAL_TYPED_ARRAY_UINT8, 4,
+			&typed) == 0);
+	assert(jsval_map_set(&src, map, jsval_number(2), typed) == 0);
+	assert(jsval_array_new(&src, 3, &root) == 0);
+	assert(jsval_array_push(&src, root, data) == 0);
+	assert(jsval_array_push(&src, root, map) == 0);
+	/* Enough live nodes to grow the forwarding table. */
+	assert(jsval_array_new(&src, 100, &other) == 0);
+	for (i = 0; i < 100; i++) {
+		char text[8];
+
+		snprintf(text, sizeof(text), "s%d", i);
+		assert(jsval_string_new_utf8(&src, (const uint8_t *)text,
+				strlen(text), &value) == 0);
+		assert(jsval_array_push(&src, other, value) == 0);
+	}
+	assert(jsval_array_push(&src, root, other) == 0);
+	assert(jsval_region_set_root(&src, root) == 0);
+	assert_json(&src, data, expected);
+
+	jsval_region_init(&dst, dst_storage, sizeof(dst_storage));
+	assert(jsval_region_compact(&src, &dst) == 0);
+	assert(dst.used < src.used);
+	assert(dst.pages->total_len == sizeof(dst_storage));
+	assert(jsval_region_root(&dst, &root) == 0);
+	assert(jsval_array_get(&dst, root, 0, &data) == 0);
+	assert_json(&dst, data, expected);
+
+	/* Sharing survives: both slots name the same copied object. */
+	assert(jsval_object_get_utf8(&dst, data, (const uint8_t *)"list", 4,
+			&list) == 0);
+	assert(jsval_array_get(&dst, list, 0, &got) == 0);
+	assert(jsval_array_get(&dst, list, 1, &other) == 0);
+	assert(got.off == other.off);
+	assert(jsval_array_get(&dst, root, 1, &map) == 0);
+	assert(jsval_map_get(&dst, map, got, &value) == 0);
+	assert(value.kind == JSVAL_KIND_ARRAY && value.off == list.off);
+	assert(jsval_map_get(&dst, map, jsval_number(2), &typed) == 0);
+	assert(jsval_typed_array_length(&dst, typed) == 4);
+	assert(jsval_map_size(&dst, map, &size) == 0);
+	assert(size == 2);
+	assert(jsval_array_get(&dst, root, 2, &other) == 0);
+	assert(jsval_array_get(&dst, other, 99, &value) == 0);
+	assert_json(&dst, value, "\"s99\"");
+
+	/* The copy is an ordinary region and src is untouched. */
+	assert(jsval_string_new_utf8(&dst, (const uint8_t *)"more", 4,
+			&value) == 0);
+	assert(jsval_region_root(&src, &root) == 0);
+	assert(jsval_array_get(&src, root, 0, &data) == 0);
+	assert_json(&src, data, expected);
+
+	/* dst must be empty and large enough; failures leave it empty. */
+	errno = 0;
+	assert(jsval_region_compact(&src, &dst) == -1);
+	assert(errno == EINVAL);
+	jsval_region_init(&tiny, tiny_storage, sizeof(tiny_storage));
+	errno = 0;
+	assert(jsval_region_compact(&src, &tiny) == -1);
+	assert(errno == ENOBUFS);
+	assert(tiny.used == jsval_pages_head_size());
+	assert(tiny.pages->total_len == sizeof(tiny_storage));
+
+	/* Pending combinators pin src until they settle. */
+	assert(jsval_promise_new(&src, &pending) == 0);
+	assert(jsval_promise_all(&src, &pending, 1, &value) == 0);
+	jsval_region_init(&dst, dst_storage, sizeof(dst_storage));
+	errno = 0;
+	assert(jsval_region_compact(&src, &dst) == -1);
+	assert(errno == EBUSY);
+	assert(jsval_promise_resolve(&src, pending, jsval_number(1)) == 0);
+	assert(jsval_microtask_drain(&src, NULL) == 0);
+	assert(jsval_region_compact(&src, &dst) == 0);
+
+	/* Values carrying host state are refused. */
+	assert(jsval_string_new_utf8(&src,
+			(const uint8_t *)"https://example.com/", 20, &value) == 0);
+	assert(jsval_url_new(&src, value, 0, jsval_undefined(), &value) == 0);
+	assert(jsval_region_set_root(&src, value) == 0);
+	jsval_region_init(&dst, dst_storage, sizeof(dst_storage));
+	errno = 0;
+	assert(jsval_region_compact(&src, &dst) == -1);
+	assert(errno == ENOTSUP);
+}
+
+static void test_region_image(void)
+{
+	static const char wide[] =
+		"{\"k0\":0,\"k1\":1,\"k2\":2,\"k3\":3,\"k4\":4,\"k5\":5,"
+		"\"k6\":6,\"k7\":7,\"k8\":8,\"k9\":9,\"k10\":10,\"k11\":11,"
+		"\"k12\":12,\"k13\":13,\"k14\":14,\"k15\":15,\"k16\":16,"
+		"\"list\":[0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15]}";
+	static uint8_t src_storage[16384];
+	static uint8_t dst_storage[16384];
+	static uint8_t image[16384];
+	char borrowed[sizeof(wide)];
+	jsval_region_t src;
+	jsval_region_t dst;
+	jsval_region_t mapped;
+	jsval_t root;
+	jsval_t doc;
+	jsval_t data;
+	jsval_t value;
+	jsval_t got;
+	jsval_t list;
+	size_t used;
+
+	jsval_region_init(&src, src_storage, sizeof(src_storage));
+	memcpy(borrowed, wide, sizeof(wide));
+	assert(jsval_json_parse_borrowed(&src, (const uint8_t *)borrowed,
+			sizeof(wide) - 1, 64, &doc) == 0);
+	assert(jsval_object_new(&src, 1, &data) == 0);
+	assert(jsval_string_new_utf8(&src, (const uint8_t *)"flag", 4,
+			&value) == 0);
+	assert(jsval_object_set_utf8(&src, data, (const uint8_t *)"name", 4,
+			value) == 0);
+	assert(jsval_array_new(&src, 2, &root) == 0);
+	assert(jsval_array_push(&src, root, doc) == 0);
+	assert(jsval_array_push(&src, root, data) == 0);
+	assert(jsval_region_set_root(&src, root) == 0);
+
+	jsval_region_init(&dst, dst_storage, sizeof(dst_storage));
+	assert(jsval_region_image(&src, &dst) == 0);
+	assert(dst.pages->total_len == dst.pages->used_len);
+	memcpy(image, dst_storage, dst.pages->total_len);
+	/* The image owns its JSON bytes. */
+	memset(borrowed, ' ', sizeof(borrowed));
+
+	assert(jsval_region_map_image(&mapped, image,
+			jsval_region_pages(&dst)->total_len) == 0);
+	used = mapped.used;
+	assert(jsval_region_root(&mapped, &root) == 0);
+	assert(jsval_array_get(&mapped, root, 0, &doc) == 0);
+	assert(jsval_object_get_utf8(&mapped, doc, (const uint8_t *)"k16", 3,
+			&got) == 0);
+	assert(jsval_strict_eq(&mapped, got, jsval_number(16)) == 1);
+	assert(jsval_object_get_utf8(&mapped, doc, (const uint8_t *)"list", 4,
+			&list) == 0);
+	assert(jsval_array_get(&mapped, list, 12, &got) == 0);
+	assert(jsval_strict_eq(&mapped, got, jsval_number(12)) == 1);
+	assert(jsval_array_get(&mapped, root, 1, &data) == 0);
+	assert_json(&mapped, data, "{\"name\":\"flag\"}");
+	assert(mapped.used == used);
+
+	/* Nothing can be allocated into a mapped image. */
+	errno = 0;
+	assert(jsval_string_new_utf8(&mapped, (const uint8_t *)"x", 1,
+			&value) == -1);
+	assert(errno == EROFS);
+	errno = 0;
+	assert(jsval_region_set_root(&mapped, got) == -1);
+	assert(errno == EROFS);
+
+	/* Header validation. */
+	errno = 0;
+	assert(jsval_region_map_image(&mapped, image, 64) == -1);
+	assert(errno == EINVAL);
+	image[0] ^= 0xff;
+	errno = 0;
+	assert(jsval_region_map_image(&mapped, image, sizeof(image)) == -1);
+	assert(errno == EINVAL);
+
+	/* Host function pointers cannot be persisted. */
+	assert(jsval_function_new(&src, test_function_sum, 2, 0,
+			jsval_undefined(), &value) == 0);
+	assert(jsval_region_set_root(&src, value) == 0);
+	jsval_region_init(&dst, dst_storage, sizeof(dst_storage));
+	errno = 0;
+	assert(jsval_region_image(&src, &dst) == -1);
+	assert(errno == ENOTSUP);
+}
+
+static void test_region_mark_release(void)
+{
+	static const char json[] =
+		"{\"k0\":0,\"k1\":1,\"k2\":2,\"k3\":3,\"k4\":4,\"k5\":5,"
+		"\"k6\":6,\"k7\":7,\"k8\":8,\"k9\":9,\"k10\":10,\"k11\":11,"
+		"\"k12\":12,\"k13\":13,\"k14\":14,\"k15\":15,\"k16\":16}";
+	uint8_t storage[8192];
+	jsval_region_t region;
+	jsval_region_mark_t outer;
+	jsval_region_mark_t inner;
+	jsval_t keep;
+	jsval_t doc;
+	jsval_t temp;
+	jsval_t got;
+	jsval_t pending;
+	jsval_t all;
+	jsval_t root;
+	size_t used;
+	int i;
+
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"keep", 4,
+			&keep) == 0);
+	assert(jsval_json_parse(&region, (const uint8_t *)json, sizeof(json) - 1,
+			40, &doc) == 0);
+	assert(jsval_region_set_root(&region, keep) == 0);
+
+	/* A scoped loop body reuses the same bytes on every iteration. */
+	used = region.used;
+	for (i = 0; i < 1000; i++) {
+		assert(jsval_region_mark(&region, &outer) == 0);
+		assert(jsval_string_new_utf8(&region,
+				(const uint8_t *)"a temporary string", 18, &temp) == 0);
+		assert(jsval_region_set_root(&region, temp) == 0);
+		assert(jsval_region_release(&region, &outer) == 0);
+		assert(region.used == used);
+		assert(region.pages->used_len == used);
+	}
+	assert(jsval_region_root(&region, &root) == 0);
+	assert(jsval_strict_eq(&region, root, keep) == 1);
+
+	/* Lookups on an older doc do not cache an index above the mark. */
+	assert(jsval_region_mark(&region, &outer) == 0);
+	assert(jsval_object_get_utf8(&region, doc, (const uint8_t *)"k16", 3,
+			&got) == 0);
+	assert(jsval_strict_eq(&region, got, jsval_number(16)) == 1);
+	assert(region.used == used);
+
+	/* Marks nest and unwind innermost first. */
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"x", 1,
+			&temp) == 0);
+	assert(jsval_region_mark(&region, &inner) == 0);
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"y", 1,
+			&temp) == 0);
+	assert(jsval_region_release(&region, &outer) == 0);
+	errno = 0;
+	assert(jsval_region_release(&region, &inner) == -1);
+	assert(errno == EINVAL);
+	assert(region.used == used);
+	assert(region.mark_floor == 0);
+
+	/* Queued work allocated inside the scope blocks the release. */
+	assert(jsval_promise_new(&region, &pending) == 0);
+	used = region.used;
+	assert(jsval_region_mark(&region, &outer) == 0);
+	assert(jsval_promise_all(&region, &pending, 1, &all) == 0);
+	errno = 0;
+	assert(jsval_region_release(&region, &outer) == -1);
+	assert(errno == EBUSY);
+	assert(jsval_promise_resolve(&region, pending, jsval_number(1)) == 0);
+	assert(jsval_microtask_drain(&region, NULL) == 0);
+	assert(jsval_microtask_pending(&region) == 0);
+	assert(jsval_region_release(&region, &outer) == 0);
+	assert(region.used == used);
+
+	/* Queue nodes older than the mark do not block it. */
+	assert(jsval_promise_new(&region, &pending) == 0);
+	assert(jsval_promise_all(&region, &pending, 1, &all) == 0);
+	used = region.used;
+	assert(jsval_region_mark(&region, &outer) == 0);
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"z", 1,
+			&temp) == 0);
+	assert(jsval_region_release(&region, &outer) == 0);
+	assert(region.used == used);
+	assert(jsval_region_mark(&region, NULL) == -1);
+}
+
+static void test_region_snapshot_restore(void)
+{
+	static const char json[] =
+		"{\"k0\":0,\"k1\":1,\"k2\":2,\"k3\":3,\"k4\":4,\"k5\":5,"
+		"\"k6\":6,\"k7\":7,\"k8\":8,\"k9\":9,\"k10\":10,\"k11\":11,"
+		"\"k12\":12,\"k13\":13,\"k14\":14,\"k15\":15,\"k16\":16}";
+	uint8_t storage[8192];
+	jsval_region_t region;
+	jsval_region_snapshot_t snapshot;
+	jsval_t config;
+	jsval_t temp;
+	jsval_t got;
+	jsval_t pending;
+	jsval_t all;
+	jsval_t root;
+	size_t used;
+	int i;
+
+	/* Bootstrap once: constant config becomes the root. */
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_json_parse(&region, (const uint8_t *)json, sizeof(json) - 1,
+			40, &config) == 0);
+	assert(jsval_region_set_root(&region, config) == 0);
+	assert(jsval_promise_new(&region, &pending) == 0);
+	assert(jsval_promise_all(&region, &pending, 1, &all) == 0);
+	errno = 0;
+	assert(jsval_region_snapshot(&region, &snapshot) == -1);
+	assert(errno == EBUSY);
+	assert(jsval_promise_resolve(&region, pending, jsval_number(1)) == 0);
+	assert(jsval_microtask_drain(&region, NULL) == 0);
+	assert(jsval_region_snapshot(&region, &snapshot) == 0);
+	used = region.used;
+
+	/* Each request starts from the bootstrap state. */
+	for (i = 0; i < 1000; i++) {
+		assert(jsval_region_restore(&region, &snapshot) == 0);
+		assert(region.used == used);
+		assert(jsval_region_root(&region, &root) == 0);
+		assert(jsval_strict_eq(&region, root, config) == 1);
+		assert(jsval_object_get_utf8(&region, config,
+				(const uint8_t *)"k16", 3, &got) == 0);
+		assert(jsval_strict_eq(&region, got, jsval_number(16)) == 1);
+		assert(region.used == used);
+		assert(jsval_string_new_utf8(&region,
+				(const uint8_t *)"per-request", 11, &temp) == 0);
+		assert(jsval_region_set_root(&region, temp) == 0);
+		if (i % 2 == 0) {
+			/* Work left queued by a request is dropped. */
+			assert(jsval_promise_new(&region, &pending) == 0);
+			assert(jsval_promise_all(&region, &pending, 1, &all) == 0);
+			assert(region.promise_combinator_head != 0);
+		}
+	}
+	assert(jsval_region_restore(&region, &snapshot) == 0);
+	assert(region.promise_combinator_head == 0);
+	assert(region.used == used);
+
+	errno = 0;
+	assert(jsval_region_restore(&region, NULL) == -1);
+	assert(errno == EINVAL);
+}
+
 static int
 test_replace_string_callback(jsval_region_t *region, void *opaque,
 		const jsval_replace_call_t *call, jsval_t *result_ptr,
@@ -6889,6 +7430,227 @@ static void test_json_root_rebase()
 	assert(jsval_truthy(&moved, got) == 1);
 }
 
+static void test_json_parse_borrowed()
+{
+	static const char json[] = "{\"name\":\"Ada\",\"tags\":[1,2]}trailing";
+	size_t json_len = sizeof("{\"name\":\"Ada\",\"tags\":[1,2]}") - 1;
+	uint8_t input[64];
+	uint8_t remapped[64];
+	uint8_t storage[4096];
+	uint8_t owned_storage[4096];
+	uint8_t moved_storage[4096];
+	uint8_t out[64];
+	jsval_region_t region;
+	jsval_region_t owned;
+	jsval_region_t moved;
+	jsval_t root;
+	jsval_t got;
+	size_t len;
+
+	memcpy(input, json, sizeof(json));
+	jsval_region_init(&region, storage, sizeof(storage));
+	jsval_region_init(&owned, owned_storage, sizeof(owned_storage));
+	assert(jsval_json_parse(&owned, input, json_len, 16, &got) == 0);
+	assert(jsval_json_parse_borrowed(&region, input, json_len, 16,
+			&root) == 0);
+	/* The borrowed doc skips the len + 1 source copy. */
+	assert(region.used + json_len < owned.used + 1 + sizeof(void *));
+	assert(jsval_object_get_utf8(&region, root, (const uint8_t *)"name", 4,
+			&got) == 0);
+	assert(jsval_string_copy_utf8(&region, got, out, sizeof(out), &len) == 0);
+	assert(len == 3 && memcmp(out, "Ada", 3) == 0);
+	assert(jsval_copy_json(&region, root, out, sizeof(out), &len) == 0);
+	assert(len == json_len && memcmp(out, json, len) == 0);
+
+	/* Rebase keeps reading the caller's bytes; a remap needs a rebind. */
+	memcpy(moved_storage, storage, region.used);
+	jsval_region_rebase(&moved, moved_storage, sizeof(moved_storage));
+	assert(jsval_region_root(&moved, &root) == 0);
+	assert(jsval_object_get_utf8(&moved, root, (const uint8_t *)"tags", 4,
+			&got) == 0);
+	assert(jsval_array_length(&moved, got) == 2);
+	memcpy(remapped, input, sizeof(json));
+	memset(input, 'x', sizeof(input));
+	assert(jsval_json_rebind_borrowed(&moved, got, remapped,
+			json_len + 1) == -1);
+	assert(errno == EINVAL);
+	assert(jsval_json_rebind_borrowed(&moved, got, remapped, json_len) == 0);
+	assert(jsval_copy_json(&moved, root, out, sizeof(out), &len) == 0);
+	assert(len == json_len && memcmp(out, json, len) == 0);
+
+	assert(jsval_region_root(&owned, &root) == 0);
+	assert(jsval_json_rebind_borrowed(&owned, root, remapped, json_len) == -1);
+	assert(errno == EINVAL);
+}
+
+static void test_json_parse_auto()
+{
+	static const char json[] =
+		"{\"id\":7,\"items\":[{\"sku\":\"a\"},{\"sku\":\"b\\\"c\"}],\"ok\":true}";
+	uint8_t storage[4096];
+	jsval_region_t region;
+	jsval_region_t sized;
+	jsval_t root;
+	jsval_t got;
+	unsigned int count;
+	size_t used;
+
+	assert(jsval_json_measure_tokens(NULL, 0, &count) == 0);
+	assert(count == 0);
+	assert(jsval_json_measure_tokens((const uint8_t *)"[1,\"x", 5,
+			&count) == JSMN_ERROR_PART);
+	assert(jsval_json_measure_tokens((const uint8_t *)json, sizeof(json) - 1,
+			&count) == 0);
+	assert(count == 13);
+
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_json_parse_auto(&region, (const uint8_t *)json,
+			sizeof(json) - 1, &root) == 0);
+	used = region.used;
+	assert(jsval_object_get_utf8(&region, root, (const uint8_t *)"ok", 2,
+			&got) == 0);
+	assert(jsval_truthy(&region, got) == 1);
+	assert_json(&region, root, json);
+
+	/* Exactly as small as a parse with a perfect guess. */
+	jsval_region_init(&sized, storage, sizeof(storage));
+	assert(jsval_json_parse(&sized, (const uint8_t *)json, sizeof(json) - 1,
+			count, &root) == 0);
+	assert(sized.used == used);
+	jsval_region_init(&sized, storage, sizeof(storage));
+	assert(jsval_json_parse(&sized, (const uint8_t *)json, sizeof(json) - 1,
+			count - 1, &root) == JSMN_ERROR_NOMEM);
+}
+
+static void test_json_copy_passthrough()
+{
+	static const char compact[] =
+		"{\"a\":[1,\"x y\",{\"b\\\"\":null}],\"c\":\"\\n\"}";
+	static const char spaced[] =
+		" {\n\t\"a\" : [ 1 , \"x y\" ,{ \"b\\\" \" : null } ] ,\r\n"
+		"  \"c\": \" \\n\" }\n";
+	uint8_t storage[4096];
+	jsval_region_t region;
+	jsval_t root;
+	jsval_t got;
+
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_json_parse(&region, (const uint8_t *)compact,
+			sizeof(compact) - 1, 16, &root) == 0);
+	assert_json(&region, root, compact);
+	assert(jsval_object_get_utf8(&region, root, (const uint8_t *)"a", 1,
+			&got) == 0);
+	assert_json(&region, got, "[1,\"x y\",{\"b\\\"\":null}]");
+
+	/* Whitespace between tokens is dropped; inside strings it is kept. */
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_json_parse(&region, (const uint8_t *)spaced,
+			sizeof(spaced) - 1, 16, &root) == 0);
+	assert_json(&region, root,
+			"{\"a\":[1,\"x y\",{\"b\\\" \":null}],\"c\":\" \\n\"}");
+	assert(jsval_object_get_utf8(&region, root, (const uint8_t *)"c", 1,
+			&got) == 0);
+	assert_json(&region, got, "\" \\n\"");
+}
+
+static void test_json_project_paths()
+{
+	static const char json[] =
+		" {\"noise\":[[1,2,{\"user\":\"x\"}],\"]}\\\"\",{\"a\":{}}],"
+		"\"user\":{\"name\":\"Ada\",\"i\\u0064\":42,\"id\":43},"
+		"\"items\":[{\"sku\":\"a1\",\"qty\":1},{\"qty\":2},"
+		"{\"sku\":{\"v\":[3]}}],\"tail\":null} ";
+	static const char *const specs[] = {
+		"user.id", "items[*].sku", "items[2].sku.v", "user.missing", "",
+		"tail",
+	};
+	jsval_json_path_t paths[6];
+	jsval_t values[6];
+	uint8_t storage[8192];
+	uint8_t full_storage[8192];
+	jsval_region_t region;
+	jsval_region_t full;
+	jsval_t root;
+	jsval_t got;
+	size_t i;
+
+	for (i = 0; i < 6; i++) {
+		assert(jsval_json_path_compile(specs[i], strlen(specs[i]),
+				&paths[i]) == 0);
+	}
+	assert(paths[1].wildcard == 1);
+	assert(paths[1].segment_count == 3);
+	assert(paths[1].segments[1].kind == JSVAL_JSON_PATH_ANY);
+	assert(paths[2].segments[1].kind == JSVAL_JSON_PATH_INDEX);
+	assert(paths[2].segments[1].index == 2);
+	assert(jsval_json_path_compile("a..b", 4, &paths[5]) == -1);
+	assert(errno == EINVAL);
+	assert(jsval_json_path_compile("a[x]", 4, &paths[5]) == -1);
+	assert(errno == EINVAL);
+	assert(jsval_json_path_compile("a.b.c.d.e.f.g.h.i", 17, &paths[5]) == -1);
+	assert(errno == ENOBUFS);
+	assert(jsval_json_path_compile("tail", 4, &paths[5]) == 0);
+
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_json_project(&region, (const uint8_t *)json,
+			sizeof(json) - 1, paths, 5, values) == 0);
+	/* The escaped "id" is the first "id". */
+	assert(values[0].repr == JSVAL_REPR_JSON);
+	assert(jsval_strict_eq(&region, values[0], jsval_number(42.0)) == 1);
+	assert(values[1].repr == JSVAL_REPR_NATIVE);
+	assert(jsval_array_length(&region, values[1]) == 2);
+	assert(jsval_array_get(&region, values[1], 0, &got) == 0);
+	assert_json(&region, got, "\"a1\"");
+	assert(jsval_array_get(&region, values[1], 1, &got) == 0);
+	assert_json(&region, got, "{\"v\":[3]}");
+	assert_json(&region, values[2], "[3]");
+	assert(values[3].kind == JSVAL_KIND_UNDEFINED);
+	assert(values[4].kind == JSVAL_KIND_OBJECT);
+	assert(jsval_region_root(&region, &root) == 0);
+	assert(root.kind == JSVAL_KIND_UNDEFINED);
+
+	/* Without the whole-document path, far less than a full parse. */
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_json_project(&region, (const uint8_t *)json,
+			sizeof(json) - 1, paths, 4, values) == 0);
+	jsval_region_init(&full, full_storage, sizeof(full_storage));
+	assert(jsval_json_parse_auto(&full, (const uint8_t *)json,
+			sizeof(json) - 1, &root) == 0);
+	assert(region.used < full.used);
+
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_json_project(&region, (const uint8_t *)"{\"items\":7}", 11,
+			paths, 2, values) == 0);
+	assert(values[0].kind == JSVAL_KIND_UNDEFINED);
+	assert(jsval_array_length(&region, values[1]) == 0);
+	assert(jsval_json_project(&region, (const uint8_t *)"{\"user\":{\"id\" 1}}",
+			17, paths, 1, values) == -1);
+	assert(errno == EINVAL);
+	assert(jsval_json_project(&region, (const uint8_t *)"{\"x\":[}", 7,
+			&paths[5], 1, values) == -1);
+	assert(errno == EINVAL);
+
+	/* A missing value on the scanned route is malformed, whether it
+	 * is the match or a sibling stepped over. */
+	assert(jsval_json_path_compile("a", 1, &paths[5]) == 0);
+	{
+		static const char *const empties[] = {
+			"{\"a\":}", "{\"a\": ,\"b\":1}", "{\"x\":,\"a\":1}",
+			"{\"x\":1,\"a\":,\"b\":2}", "{\"a\":]",
+		};
+
+		for (i = 0; i < sizeof(empties) / sizeof(empties[0]); i++) {
+			errno = 0;
+			assert(jsval_json_project(&region, (const uint8_t *)empties[i],
+					strlen(empties[i]), &paths[5], 1, values) == -1);
+			assert(errno == EINVAL);
+		}
+	}
+	assert(jsval_json_project(&region, (const uint8_t *)"{\"a\":1 }", 9,
+			&paths[5], 1, values) == 0);
+	assert(jsval_strict_eq(&region, values[0], jsval_number(1.0)) == 1);
+}
+
 static void test_native_container_helpers(void)
 {
 	uint8_t storage[16384];
@@ -7068,21 +7830,690 @@ static void test_json_container_helpers(void)
 	assert(errno == EINVAL);
 }
 
-static void test_object_copy_own_helpers(void)
+static void test_json_nested_sibling_skip(void)
 {
-	static const char json_source[] = "{\"z\":1,\"a\":2}";
-	static const char json_multi[] = "{\"b\":9,\"c\":3}";
-	static const char json_dups[] = "{\"a\":1,\"a\":9,\"c\":3}";
-	static const char json_fail[] = "{\"a\":1,\"b\":2}";
-	static const char json_dst_text[] = "{\"keep\":true}";
-	uint8_t storage[65536];
+	static const char json[] =
+		"{\"a\":{\"b\":[1,[2,3],{\"c\":4}],\"d\":\"x\"},"
+		"\"e\":[[],{},[[5]]],\"f\":null}";
+	uint8_t storage[32768];
 	jsval_region_t region;
-	jsval_t dst;
-	jsval_t src_native;
-	jsval_t items;
-	jsval_t src_json;
-	jsval_t multi_dst;
-	jsval_t multi_src;
+	jsval_t root;
+	jsval_t got;
+	jsval_t inner;
+
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_json_parse(&region, (const uint8_t *)json, sizeof(json) - 1, 32,
+			&root) == 0);
+	assert(jsval_object_size(&region, root) == 3);
+	assert_object_key_at(&region, root, 2, "f");
+	assert_object_value_json_at(&region, root, 1, "[[],{},[[5]]]");
+	assert(jsval_object_get_utf8(&region, root, (const uint8_t *)"f", 1,
+			&got) == 0);
+	assert(got.kind == JSVAL_KIND_NULL);
+
+	assert(jsval_object_get_utf8(&region, root, (const uint8_t *)"a", 1,
+			&inner) == 0);
+	assert(jsval_object_get_utf8(&region, inner, (const uint8_t *)"d", 1,
+			&got) == 0);
+	assert_string(&region, got, "x");
+	assert(jsval_object_get_utf8(&region, inner, (const uint8_t *)"b", 1,
+			&inner) == 0);
+	assert(jsval_array_get(&region, inner, 2, &got) == 0);
+	assert_json(&region, got, "{\"c\":4}");
+	assert(jsval_array_get(&region, inner, 3, &got) == 0);
+	assert(got.kind == JSVAL_KIND_UNDEFINED);
+
+	assert(jsval_object_get_utf8(&region, root, (const uint8_t *)"e", 1,
+			&inner) == 0);
+	assert(jsval_array_get(&region, inner, 2, &got) == 0);
+	assert_json(&region, got, "[[5]]");
+	assert(jsval_promote(&region, root, &got) == 0);
+	assert_json(&region, got, json);
+}
+
+static void test_json_array_linear_walks(void)
+{
+	static const char json[] =
+		"[0,[1],{\"v\":2},3,4,\"5\",6,[7,7],8,9,10,11]";
+	uint8_t storage[32768];
+	jsval_region_t region;
+	jsval_t root;
+	jsval_t iterator;
+	jsval_t key;
+	jsval_t value;
+	jsval_t got;
+	size_t i;
+	size_t used;
+	int done;
+	jsmethod_error_t error;
+
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_json_parse(&region, (const uint8_t *)json, sizeof(json) - 1, 32,
+			&root) == 0);
+	assert(jsval_array_length(&region, root) == 12);
+
+	/* Without opting in, indexed reads walk and allocate nothing. */
+	used = region.used;
+	assert(jsval_array_get(&region, root, 9, &got) == 0);
+	assert(jsval_strict_eq(&region, got, jsval_number(9.0)) == 1);
+	assert(region.used == used);
+	assert(jsval_json_index_arrays(&region, root) == 0);
+	assert(jsval_array_get(&region, root, 1, &got) == 0);
+	assert(region.used > used);
+
+	assert(jsval_get_iterator(&region, root, JSVAL_ITERATOR_SELECTOR_VALUES,
+			&iterator, &error) == 0);
+	for (i = 0; i < 12; i++) {
+		assert(jsval_iterator_next(&region, iterator, &done, &value,
+				&error) == 0);
+		assert(done == 0);
+		assert(value.repr == JSVAL_REPR_JSON);
+		assert(jsval_array_get(&region, root, i, &got) == 0);
+		assert(got.kind == value.kind);
+		assert(got.as.index == value.as.index);
+	}
+	assert(jsval_iterator_next(&region, iterator, &done, &value, &error) == 0);
+	assert(done == 1);
+	assert(value.kind == JSVAL_KIND_UNDEFINED);
+
+	assert(jsval_get_iterator(&region, root, JSVAL_ITERATOR_SELECTOR_ENTRIES,
+			&iterator, &error) == 0);
+	for (i = 0; i < 3; i++) {
+		assert(jsval_iterator_next_entry(&region, iterator, &done, &key,
+				&value, &error) == 0);
+		assert(done == 0);
+		assert_number_value(key, (double)i);
+	}
+	assert_json(&region, value, "{\"v\":2}");
+
+	/* The element table is built once; later indexed reads reuse it. */
+	used = region.used;
+	for (i = 12; i-- > 0;) {
+		assert(jsval_array_get(&region, root, i, &got) == 0);
+	}
+	assert(region.used == used);
+	assert(jsval_array_get(&region, root, 7, &got) == 0);
+	assert_json(&region, got, "[7,7]");
+	assert(jsval_array_get(&region, root, 11, &got) == 0);
+	assert(jsval_strict_eq(&region, got, jsval_number(11.0)) == 1);
+	assert(jsval_array_get(&region, root, 12, &got) == 0);
+	assert(got.kind == JSVAL_KIND_UNDEFINED);
+	assert(jsval_promote(&region, root, &got) == 0);
+	assert_json(&region, got, json);
+}
+
+static void test_json_escaped_key_lookup(void)
+{
+	static const char json[] =
+		"{\"ab\":1,\"a\\u0062c\":2,\"q\\\"\":3,\"abd\":4}";
+	uint8_t storage[4096];
+	jsval_region_t region;
+	jsval_t root;
+	jsval_t got;
+	int has;
+
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_json_parse(&region, (const uint8_t *)json, sizeof(json) - 1, 16,
+			&root) == 0);
+
+	/* Escaped keys still match by decoded value, not by raw bytes. */
+	assert(jsval_object_get_utf8(&region, root, (const uint8_t *)"abc", 3,
+			&got) == 0);
+	assert(jsval_strict_eq(&region, got, jsval_number(2.0)) == 1);
+	assert(jsval_object_get_utf8(&region, root, (const uint8_t *)"q\"", 2,
+			&got) == 0);
+	assert(jsval_strict_eq(&region, got, jsval_number(3.0)) == 1);
+	assert(jsval_object_has_own_utf8(&region, root,
+			(const uint8_t *)"a\\u0062c", 7, &has) == 0);
+	assert(has == 0);
+
+	/* Unescaped keys compare directly against the source span. */
+	assert(jsval_object_get_utf8(&region, root, (const uint8_t *)"ab", 2,
+			&got) == 0);
+	assert(jsval_strict_eq(&region, got, jsval_number(1.0)) == 1);
+	assert(jsval_object_has_own_utf8(&region, root, (const uint8_t *)"a", 1,
+			&has) == 0);
+	assert(has == 0);
+	assert(jsval_object_has_own_utf8(&region, root, (const uint8_t *)"abcd", 4,
+			&has) == 0);
+	assert(has == 0);
+}
+
+static void test_json_wide_object_lookup(void)
+{
+	static const char json[] =
+		"{\"f0\":0,\"f1\":1,\"f2\":2,\"f3\":3,\"f4\":4,\"f5\":5,\"f6\":6,"
+		"\"f7\":7,\"f8\":8,\"f9\":9,\"f10\":10,\"f11\":11,\"f12\":12,"
+		"\"f13\":13,\"f14\":14,\"f\\u0031\\u0035\":15,\"f16\":{\"n\":16},"
+		"\"f17\":17,\"f18\":18,\"f3\":33}";
+	uint8_t storage[32768];
+	jsval_region_t region;
+	jsval_t root;
+	jsval_t got;
+	char name[8];
+	size_t used;
+	int has;
+	int i;
+
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_json_parse(&region, (const uint8_t *)json, sizeof(json) - 1, 64,
+			&root) == 0);
+
+	/* Without opting in, lookups scan and allocate nothing. */
+	used = region.used;
+	assert(jsval_object_get_utf8(&region, root, (const uint8_t *)"f18", 3,
+			&got) == 0);
+	assert(jsval_strict_eq(&region, got, jsval_number(18.0)) == 1);
+	assert(region.used == used);
+	errno = 0;
+	assert(jsval_json_index_objects(&region, jsval_number(1)) == -1);
+	assert(errno == EINVAL);
+
+	assert(jsval_json_index_objects(&region, root) == 0);
+	assert(jsval_object_get_utf8(&region, root, (const uint8_t *)"f0", 2,
+			&got) == 0);
+	assert(jsval_strict_eq(&region, got, jsval_number(0.0)) == 1);
+	assert(region.used > used);
+
+	/* The key index is built once; later lookups reuse it. */
+	used = region.used;
+	for (i = 18; i >= 0; i--) {
+		snprintf(name, sizeof(name), "f%d", i);
+		assert(jsval_object_get_utf8(&region, root, (const uint8_t *)name,
+				strlen(name), &got) == 0);
+		if (i == 16) {
+			assert_json(&region, got, "{\"n\":16}");
+		} else {
+			assert(jsval_strict_eq(&region, got, jsval_number((double)i)) == 1);
+		}
+	}
+	assert(region.used == used);
+
+	assert(jsval_object_has_own_utf8(&region, root, (const uint8_t *)"f19", 3,
+			&has) == 0);
+	assert(has == 0);
+	assert(jsval_object_has_own_utf8(&region, root, (const uint8_t *)"f15", 3,
+			&has) == 0);
+	assert(has == 1);
+	assert(jsval_object_get_utf8(&region, root, (const uint8_t *)"", 0,
+			&got) == 0);
+	assert(got.kind == JSVAL_KIND_UNDEFINED);
+	assert(region.used == used);
+}
+
+static void test_object_hashed_lookup(void)
+{
+	static uint8_t storage[1 << 20];
+	static uint8_t compacted[1 << 20];
+	jsval_region_t region;
+	jsval_region_t dst;
+	jsval_t object;
+	jsval_t copy;
+	jsval_t key;
+	jsval_t symbol;
+	jsval_t got;
+	char name[16];
+	int deleted;
+	int has;
+	int i;
+
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_object_new(&region, 2000, &object) == 0);
+	for (i = 0; i < 1000; i++) {
+		snprintf(name, sizeof(name), "k%d", i);
+		if (i % 2 == 0) {
+			assert(jsval_object_set_utf8(&region, object,
+					(const uint8_t *)name, strlen(name),
+					jsval_number(i)) == 0);
+		} else {
+			assert(jsval_string_new_utf8(&region, (const uint8_t *)name,
+					strlen(name), &key) == 0);
+			assert(jsval_object_set_key(&region, object, key,
+					jsval_number(i)) == 0);
+		}
+	}
+	assert(jsval_symbol_new(&region, 0, jsval_undefined(), &symbol) == 0);
+	assert(jsval_object_set_key(&region, object, symbol,
+			jsval_number(-1)) == 0);
+	assert(jsval_object_size(&region, object) == 1001);
+
+	/* Overwrites keep the slot; lookups cross key representations. */
+	assert(jsval_object_set_utf8(&region, object, (const uint8_t *)"k1", 2,
+			jsval_number(100)) == 0);
+	assert(jsval_object_size(&region, object) == 1001);
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"k998", 4,
+			&key) == 0);
+	assert(jsval_object_get_key(&region, object, key, &got) == 0);
+	assert(jsval_strict_eq(&region, got, jsval_number(998)) == 1);
+	assert(jsval_object_get_key(&region, object, symbol, &got) == 0);
+	assert(jsval_strict_eq(&region, got, jsval_number(-1)) == 1);
+	for (i = 0; i < 1000; i++) {
+		snprintf(name, sizeof(name), "k%d", i);
+		assert(jsval_object_get_utf8(&region, object, (const uint8_t *)name,
+				strlen(name), &got) == 0);
+		assert(jsval_strict_eq(&region, got,
+				jsval_number(i == 1 ? 100 : i)) == 1);
+	}
+	assert(jsval_object_has_own_utf8(&region, object, (const uint8_t *)"k1000",
+			5, &has) == 0);
+	assert(has == 0);
+
+	/* Deletes keep insertion order and the index in step. */
+	assert(jsval_object_delete_utf8(&region, object, (const uint8_t *)"k0", 2,
+			&deleted) == 0);
+	assert(deleted == 1);
+	assert(jsval_object_key_at(&region, object, 0, &key) == 0);
+	assert_string(&region, key, "k1");
+	assert(jsval_object_has_own_utf8(&region, object, (const uint8_t *)"k0",
+			2, &has) == 0);
+	assert(has == 0);
+	assert(jsval_object_get_utf8(&region, object, (const uint8_t *)"k999", 4,
+			&got) == 0);
+	assert(jsval_strict_eq(&region, got, jsval_number(999)) == 1);
+
+	/* copy_own indexes appended keys. */
+	assert(jsval_object_clone_own(&region, object, 1100, &copy) == 0);
+	assert(jsval_object_get_utf8(&region, copy, (const uint8_t *)"k500", 4,
+			&got) == 0);
+	assert(jsval_strict_eq(&region, got, jsval_number(500)) == 1);
+	assert(jsval_object_get_key(&region, copy, symbol, &got) == 0);
+	assert(jsval_strict_eq(&region, got, jsval_number(-1)) == 1);
+
+	/* The index is offset-free, so it survives compaction as is. */
+	assert(jsval_region_set_root(&region, object) == 0);
+	jsval_region_init(&dst, compacted, sizeof(compacted));
+	assert(jsval_region_compact(&region, &dst) == 0);
+	assert(jsval_region_root(&dst, &object) == 0);
+	assert(jsval_object_get_utf8(&dst, object, (const uint8_t *)"k321", 4,
+			&got) == 0);
+	assert(jsval_strict_eq(&region, got, jsval_number(321)) == 1);
+	assert(jsval_object_has_own_utf8(&dst, object, (const uint8_t *)"k0",
+			2, &has) == 0);
+	assert(has == 0);
+}
+
+static void test_object_shapes(void)
+{
+	static const uint8_t *const keys[] = {
+		(const uint8_t *)"id", (const uint8_t *)"name",
+		(const uint8_t *)"score"
+	};
+	static const size_t key_lens[] = { 2, 4, 5 };
+	static const uint8_t *const dup_keys[] = {
+		(const uint8_t *)"a", (const uint8_t *)"a"
+	};
+	static const size_t dup_lens[] = { 1, 1 };
+	uint8_t storage[32768];
+	uint8_t compacted[32768];
+	jsval_region_t region;
+	jsval_region_t dst;
+	jsval_region_mark_t mark;
+	jsval_region_snapshot_t snapshot;
+	jsval_shape_t shape;
+	jsval_shape_t bad_shape;
+	jsval_t row;
+	jsval_t other;
+	jsval_t source;
+	jsval_t name;
+	jsval_t got;
+	size_t used;
+	size_t i;
+	int deleted;
+
+	jsval_region_init(&region, storage, sizeof(storage));
+	errno = 0;
+	assert(jsval_shape_new_utf8(&region, dup_keys, dup_lens, 2,
+			&bad_shape) == -1);
+	assert(errno == EINVAL);
+	assert(jsval_shape_new_utf8(&region, keys, key_lens, 3, &shape) == 0);
+
+	/* Only the values are stored per object. */
+	used = region.used;
+	assert(jsval_object_new_shaped(&region, shape, &row) == 0);
+	assert(jsval_object_new_shaped(&region, shape, &other) == 0);
+	assert((region.used - used) / 2 < 3 * 2 * sizeof(jsval_t));
+	assert(jsval_object_size(&region, row) == 3);
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"ada", 3,
+			&name) == 0);
+	assert(jsval_object_set_slot(&region, row, shape, 0, jsval_number(7)) == 0);
+	assert(jsval_object_set_slot(&region, row, shape, 1, name) == 0);
+	assert(jsval_object_set_slot(&region, row, shape, 2,
+			jsval_number(9.5)) == 0);
+	assert(jsval_object_get_slot(&region, row, shape, 2, &got) == 0);
+	assert_number_value(got, 9.5);
+	errno = 0;
+	assert(jsval_object_get_slot(&region, row, shape, 3, &got) == -1);
+	assert(errno == EINVAL);
+
+	/* The rest of the API sees an ordinary object. */
+	assert_json(&region, row, "{\"id\":7,\"name\":\"ada\",\"score\":9.5}");
+	assert(jsval_object_get_slot(&region, other, shape, 0, &got) == 0);
+	assert(got.kind == JSVAL_KIND_UNDEFINED);
+	assert(jsval_object_get_utf8(&region, row, (const uint8_t *)"name", 4,
+			&got) == 0);
+	assert_string(&region, got, "ada");
+	assert(jsval_object_key_at(&region, row, 2, &got) == 0);
+	assert_string(&region, got, "score");
+	assert(jsval_object_set_utf8(&region, row, (const uint8_t *)"id", 2,
+			jsval_number(8)) == 0);
+	assert(jsval_object_get_slot(&region, row, shape, 0, &got) == 0);
+	assert_number_value(got, 8.0);
+
+	/* Adding a key falls back to a dictionary; slots still resolve. */
+	assert(jsval_object_set_utf8(&region, row, (const uint8_t *)"extra", 5,
+			jsval_bool(1)) == 0);
+	assert(jsval_object_size(&region, row) == 4);
+	assert(jsval_object_get_slot(&region, row, shape, 1, &got) == 0);
+	assert_string(&region, got, "ada");
+	assert(jsval_object_set_slot(&region, row, shape, 2, jsval_number(1)) == 0);
+	assert_json(&region, row,
+			"{\"id\":8,\"name\":\"ada\",\"score\":1,\"extra\":true}");
+
+	/* So does deleting one. */
+	assert(jsval_object_delete_utf8(&region, other, (const uint8_t *)"name",
+			4, &deleted) == 0);
+	assert(deleted == 1);
+	assert(jsval_object_size(&region, other) == 2);
+	assert(jsval_object_get_slot(&region, other, shape, 1, &got) == 0);
+	assert(got.kind == JSVAL_KIND_UNDEFINED);
+	assert(jsval_object_set_slot(&region, other, shape, 0,
+			jsval_number(3)) == 0);
+	assert(jsval_object_key_at(&region, other, 0, &got) == 0);
+	assert_string(&region, got, "id");
+	assert(jsval_object_value_at(&region, other, 0, &got) == 0);
+	assert_number_value(got, 3.0);
+
+	/* copy_own into a shaped object overwrites slots in place. */
+	assert(jsval_object_new_shaped(&region, shape, &other) == 0);
+	assert(jsval_object_new(&region, 1, &source) == 0);
+	assert(jsval_object_set_utf8(&region, source, (const uint8_t *)"score", 5,
+			jsval_number(42)) == 0);
+	assert(jsval_object_copy_own(&region, other, source) == 0);
+	assert(jsval_object_get_slot(&region, other, shape, 2, &got) == 0);
+	assert_number_value(got, 42.0);
+
+	/* Shaped and forwarded objects survive compaction. */
+	assert(jsval_array_new(&region, 2, &source) == 0);
+	assert(jsval_array_push(&region, source, row) == 0);
+	assert(jsval_array_push(&region, source, other) == 0);
+	assert(jsval_region_set_root(&region, source) == 0);
+	jsval_region_init(&dst, compacted, sizeof(compacted));
+	assert(jsval_region_compact(&region, &dst) == 0);
+	assert(jsval_region_root(&dst, &source) == 0);
+	assert(jsval_array_get(&dst, source, 0, &row) == 0);
+	assert(jsval_array_get(&dst, source, 1, &other) == 0);
+	assert_json(&dst, row,
+			"{\"id\":8,\"name\":\"ada\",\"score\":1,\"extra\":true}");
+	assert(jsval_object_get_utf8(&dst, other, (const uint8_t *)"score", 5,
+			&got) == 0);
+	assert_number_value(got, 42.0);
+	assert(jsval_object_key_at(&dst, other, 1, &got) == 0);
+	assert_string(&dst, got, "name");
+
+	/* A shaped object older than a mark keeps its shape inside it:
+	 * slot writes work, adding or deleting a key does not. */
+	assert(jsval_object_new_shaped(&region, shape, &row) == 0);
+	assert(jsval_object_set_slot(&region, row, shape, 0, jsval_number(1)) == 0);
+	assert(jsval_region_mark(&region, &mark) == 0);
+	assert(jsval_object_set_slot(&region, row, shape, 2, jsval_number(2)) == 0);
+	errno = 0;
+	assert(jsval_object_delete_utf8(&region, row, (const uint8_t *)"name", 4,
+			&deleted) == -1);
+	assert(errno == EBUSY);
+	errno = 0;
+	assert(jsval_object_set_utf8(&region, row, (const uint8_t *)"extra", 5,
+			jsval_bool(1)) == -1);
+	assert(errno == EBUSY);
+	assert(jsval_object_new_shaped(&region, shape, &other) == 0);
+	assert(jsval_object_delete_utf8(&region, other, (const uint8_t *)"name",
+			4, &deleted) == 0);
+	assert(deleted == 1);
+	assert(jsval_region_release(&region, &mark) == 0);
+	for (i = 0; i < 4; i++) {
+		assert(jsval_array_new(&region, 8, &source) == 0);
+	}
+	assert(jsval_object_size(&region, row) == 3);
+	assert(jsval_object_get_utf8(&region, row, (const uint8_t *)"id", 2,
+			&got) == 0);
+	assert_number_value(got, 1.0);
+	assert(jsval_object_delete_utf8(&region, row, (const uint8_t *)"name", 4,
+			&deleted) == 0);
+	assert(deleted == 1);
+
+	/* Likewise for bootstrap objects under a snapshot. */
+	assert(jsval_object_new_shaped(&region, shape, &row) == 0);
+	assert(jsval_region_snapshot(&region, &snapshot) == 0);
+	errno = 0;
+	assert(jsval_object_set_utf8(&region, row, (const uint8_t *)"extra", 5,
+			jsval_bool(1)) == -1);
+	assert(errno == EBUSY);
+	assert(jsval_object_set_slot(&region, row, shape, 0, jsval_number(5)) == 0);
+	assert(jsval_region_restore(&region, &snapshot) == 0);
+	for (i = 0; i < 4; i++) {
+		assert(jsval_array_new(&region, 8, &source) == 0);
+	}
+	assert(jsval_object_size(&region, row) == 3);
+	assert(jsval_object_get_slot(&region, row, shape, 0, &got) == 0);
+	assert_number_value(got, 5.0);
+}
+
+static void test_region_atoms(void)
+{
+	static const uint8_t *const keys[] = {
+		(const uint8_t *)"id", (const uint8_t *)"name"
+	};
+	static const size_t key_lens[] = { 2, 4 };
+	static const char json[] = "{\"id\":1,\"name\":\"x\"}";
+	uint8_t storage[65536];
+	jsval_region_t region;
+	jsval_region_mark_t mark;
+	jsval_shape_t shape;
+	jsval_t atom;
+	jsval_t again;
+	jsval_t a;
+	jsval_t b;
+	jsval_t parsed;
+	jsval_t promoted;
+	jsval_t key;
+	jsval_t got;
+	double number;
+	size_t used;
+	size_t i;
+
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_atom_utf8(&region, (const uint8_t *)"id", 2, &atom) == 0);
+	assert(atom.kind == JSVAL_KIND_STRING_JSSTR8);
+	assert_string(&region, atom, "id");
+	used = region.used;
+	assert(jsval_atom_utf8(&region, (const uint8_t *)"id", 2, &again) == 0);
+	assert(again.off == atom.off && region.used == used);
+
+	/* Keys set by name, promoted from JSON or declared by a shape all
+	 * resolve to the one atom. */
+	assert(jsval_object_new(&region, 2, &a) == 0);
+	assert(jsval_object_new(&region, 2, &b) == 0);
+	assert(jsval_object_set_utf8(&region, a, (const uint8_t *)"id", 2,
+			jsval_number(1)) == 0);
+	used = region.used;
+	assert(jsval_object_set_utf8(&region, b, (const uint8_t *)"id", 2,
+			jsval_number(2)) == 0);
+	assert(region.used == used);
+	assert(jsval_object_key_at(&region, b, 0, &key) == 0);
+	assert(key.off == atom.off);
+	assert(jsval_json_parse(&region, (const uint8_t *)json,
+			sizeof(json) - 1, 8, &parsed) == 0);
+	assert(jsval_promote_object_shallow(&region, parsed, 2, &promoted) == 0);
+	assert(jsval_object_key_at(&region, promoted, 0, &key) == 0);
+	assert(key.off == atom.off);
+	assert(jsval_shape_new_utf8(&region, keys, key_lens, 2, &shape) == 0);
+	assert(jsval_object_new_shaped(&region, shape, &a) == 0);
+	assert(jsval_object_key_at(&region, a, 0, &key) == 0);
+	assert(key.off == atom.off);
+	assert(jsval_object_get_key(&region, b, atom, &got) == 0);
+	assert_number_value(got, 2);
+
+	/* The hash is FNV-1a over code points, fixed across builds. */
+	assert(jsval_atom_hash(NULL, 0) == 2166136261u);
+	assert(jsval_atom_hash((const uint8_t *)"a", 1) == 0xe40c292cu);
+	assert(jsval_object_get_utf8_hashed(&region, b, (const uint8_t *)"id", 2,
+			jsval_atom_hash((const uint8_t *)"id", 2), &got) == 0);
+	assert_number_value(got, 2);
+	assert(jsval_object_get_utf8_hashed(&region, promoted,
+			(const uint8_t *)"name", 4,
+			jsval_atom_hash((const uint8_t *)"name", 4), &got) == 0);
+	assert_string(&region, got, "x");
+	assert(jsval_object_get_utf8_hashed(&region, parsed,
+			(const uint8_t *)"id", 2,
+			jsval_atom_hash((const uint8_t *)"id", 2), &got) == 0);
+	assert(jsval_to_number(&region, got, &number) == 0 && number == 1);
+
+	/* Atoms made inside a released scope are forgotten, older ones
+	 * stay, including across table growth. */
+	assert(jsval_region_mark(&region, &mark) == 0);
+	for (i = 0; i < 200; i++) {
+		char buf[16];
+		int n = snprintf(buf, sizeof(buf), "k%zu", i);
+
+		assert(jsval_atom_utf8(&region, (const uint8_t *)buf, (size_t)n,
+				&again) == 0);
+	}
+	assert(jsval_atom_utf8(&region, (const uint8_t *)"id", 2, &again) == 0);
+	assert(again.off == atom.off);
+	assert(jsval_region_release(&region, &mark) == 0);
+	assert(jsval_region_mark(&region, &mark) == 0);
+	assert(jsval_atom_utf8(&region, (const uint8_t *)"name", 4, &again) == 0);
+	assert(again.off < mark.used);
+	assert(jsval_atom_utf8(&region, (const uint8_t *)"k7", 2, &again) == 0);
+	assert_string(&region, again, "k7");
+	assert(jsval_atom_utf8(&region, (const uint8_t *)"id", 2, &again) == 0);
+	assert(again.off == atom.off);
+	assert(jsval_region_release(&region, &mark) == 0);
+	assert(jsval_object_get_utf8(&region, b, (const uint8_t *)"id", 2,
+			&got) == 0);
+	assert_number_value(got, 2);
+}
+
+static void test_value_cells(void)
+{
+	static const char json[] = "[1,\"s\",{\"k\":true},null]";
+	uint8_t storage[65536];
+	uint8_t dst_storage[65536];
+	jsval_region_t region;
+	jsval_region_t dst;
+	jsval_t values[9];
+	jsval_t array;
+	jsval_t object;
+	jsval_t set;
+	jsval_t map;
+	jsval_t parsed;
+	jsval_t root;
+	jsval_t got;
+	double number;
+	size_t used;
+	size_t i;
+	int has;
+
+	/* Every kind of value reads back the same out of every container,
+	 * whatever the cell layout. */
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_json_parse(&region, (const uint8_t *)json,
+			sizeof(json) - 1, 16, &parsed) == 0);
+	values[0] = jsval_number(0.0 / 0.0);
+	values[1] = jsval_number(-0.0);
+	values[2] = jsval_number(-1.0 / 0.0);
+	values[3] = jsval_bool(1);
+	values[4] = jsval_null();
+	values[5] = jsval_undefined();
+	assert(jsval_array_get(&region, parsed, 2, &values[6]) == 0);
+	assert(values[6].kind == JSVAL_KIND_OBJECT);
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"str", 3,
+			&values[7]) == 0);
+	assert(jsval_object_new(&region, 1, &values[8]) == 0);
+
+	assert(jsval_array_new(&region, 9, &array) == 0);
+	assert(jsval_object_new(&region, 9, &object) == 0);
+	assert(jsval_set_new(&region, 9, &set) == 0);
+	assert(jsval_map_new(&region, 9, &map) == 0);
+	for (i = 0; i < 9; i++) {
+		char name[4];
+
+		snprintf(name, sizeof(name), "p%zu", i);
+		assert(jsval_array_push(&region, array, values[i]) == 0);
+		assert(jsval_object_set_utf8(&region, object, (const uint8_t *)name,
+				2, values[i]) == 0);
+		assert(jsval_set_add(&region, set, values[i]) == 0);
+		assert(jsval_map_set(&region, map, values[i], values[i]) == 0);
+	}
+	for (i = 0; i < 9; i++) {
+		char name[4];
+		jsval_t key;
+
+		snprintf(name, sizeof(name), "p%zu", i);
+		assert(jsval_array_get(&region, array, i, &got) == 0);
+		assert(got.kind == values[i].kind && got.repr == values[i].repr);
+		assert(jsval_object_get_utf8(&region, object, (const uint8_t *)name,
+				2, &got) == 0);
+		assert(got.kind == values[i].kind && got.repr == values[i].repr);
+		assert(jsval_set_has(&region, set, values[i], &has) == 0 && has);
+		assert(jsval_map_key_at(&region, map, i, &key) == 0);
+		assert(key.kind == values[i].kind && key.off == values[i].off);
+		assert(jsval_map_get(&region, map, values[i], &got) == 0);
+		assert(got.kind == values[i].kind && got.repr == values[i].repr);
+	}
+	assert(jsval_array_get(&region, array, 0, &got) == 0);
+	assert(got.as.number != got.as.number);
+	assert(jsval_array_get(&region, array, 1, &got) == 0);
+	assert(got.as.number == 0 && 1.0 / got.as.number < 0);
+	assert(jsval_array_get(&region, array, 2, &got) == 0);
+	assert(got.as.number == -1.0 / 0.0);
+	assert(jsval_array_get(&region, array, 3, &got) == 0);
+	assert(got.as.boolean == 1);
+	assert(jsval_array_get(&region, array, 6, &got) == 0);
+	assert(got.repr == JSVAL_REPR_JSON && got.off == values[6].off
+			&& got.as.index == values[6].as.index);
+	assert_json(&region, got, "{\"k\":true}");
+	assert(jsval_array_get(&region, array, 7, &got) == 0);
+	assert_string(&region, got, "str");
+
+	/* Compaction rewrites native cells and keeps JSON ones intact. */
+	assert(jsval_region_set_root(&region, map) == 0);
+	jsval_region_init(&dst, dst_storage, sizeof(dst_storage));
+	assert(jsval_region_compact(&region, &dst) == 0);
+	assert(jsval_region_root(&dst, &root) == 0);
+	assert(jsval_map_key_at(&dst, root, 6, &got) == 0);
+	assert_json(&dst, got, "{\"k\":true}");
+	assert(jsval_map_key_at(&dst, root, 7, &got) == 0);
+	assert_string(&dst, got, "str");
+	assert(jsval_map_get(&dst, root, jsval_number(-0.0), &got) == 0);
+	assert(jsval_to_number(&dst, got, &number) == 0 && number == 0);
+	assert(jsval_map_value_at(&dst, root, 0, &got) == 0);
+	assert(got.as.number != got.as.number);
+
+	/* Boxed cells are half the size of a handle. */
+	used = region.used;
+	assert(jsval_array_new(&region, 64, &array) == 0);
+#if JSMX_WITH_NAN_BOXING
+	assert(region.used - used < 64 * sizeof(jsval_t) / 2 + 64);
+#else
+	assert(region.used - used >= 64 * sizeof(jsval_t));
+#endif
+}
+
+static void test_object_copy_own_helpers(void)
+{
+	static const char json_source[] = "{\"z\":1,\"a\":2}";
+	static const char json_multi[] = "{\"b\":9,\"c\":3}";
+	static const char json_dups[] = "{\"a\":1,\"a\":9,\"c\":3}";
+	static const char json_fail[] = "{\"a\":1,\"b\":2}";
+	static const char json_dst_text[] = "{\"keep\":true}";
+	uint8_t storage[65536];
+	jsval_region_t region;
+	jsval_t dst;
+	jsval_t src_native;
+	jsval_t items;
+	jsval_t src_json;
+	jsval_t multi_dst;
+	jsval_t multi_src;
 	jsval_t dup_dst;
 	jsval_t dup_src;
 	jsval_t tight_dst;
@@ -14508,6 +15939,302 @@ static void test_fetch_body_drain_semantics(void)
 	}
 }
 
+static void test_fetch_body_drain_json_incremental(void)
+{
+	static const uint8_t body[] =
+		"{\"id\":12345,\"name\":\"chunked \\\"body\\\"\",\"items\":"
+		"[0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,"
+		"24,25,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,41,42,43,44,"
+		"45,46,47,48,49,50,51,52,53,54,55,56,57,58,59,60,61,62,63,64,65,"
+		"66,67,68,69],\"ok\":true,\"pi\":-3.25e2}";
+	static const uint8_t bad[] = "[1,2,}                                  3]";
+	uint8_t storage[262144];
+	jsval_region_t region;
+	jsval_t headers;
+	jsval_t request;
+	jsval_t got;
+	jsval_t field;
+	jsval_t promise;
+	jsval_promise_state_t state;
+	jsmethod_error_t error;
+	int chunk;
+
+	/* Tokenized chunk by chunk; numbers split across chunk edges must
+	 * not be closed early. */
+	for (chunk = 1; chunk <= 7; chunk += 3) {
+		fake_body_source_t src = {
+			.data = body, .total = sizeof(body) - 1, .cursor = 0,
+			.chunk_size = chunk, .fail_after = -1,
+			.reads = 0, .close_calls = 0,
+		};
+
+		jsval_region_init(&region, storage, sizeof(storage));
+		assert(jsval_headers_new(&region, JSVAL_HEADERS_GUARD_REQUEST,
+				&headers) == 0);
+		assert(jsval_request_new_from_parts(&region,
+				fetch_test_str(&region, "POST"),
+				fetch_test_str(&region, "https://ex.com"),
+				headers, &fake_body_vtable, &src, sizeof(body) - 1,
+				&request) == 0);
+		assert(jsval_request_json(&region, request, &promise) == 0);
+		memset(&error, 0, sizeof(error));
+		assert(jsval_microtask_drain(&region, &error) == 0);
+		assert(jsval_promise_state(&region, promise, &state) == 0);
+		assert(state == JSVAL_PROMISE_STATE_FULFILLED);
+		assert(jsval_promise_result(&region, promise, &got) == 0);
+		assert(got.repr == JSVAL_REPR_JSON);
+		assert_json(&region, got, (const char *)body);
+		assert(jsval_object_get_utf8(&region, got, (const uint8_t *)"id", 2,
+				&field) == 0);
+		assert(jsval_strict_eq(&region, field, jsval_number(12345.0)) == 1);
+		assert(jsval_object_get_utf8(&region, got, (const uint8_t *)"items",
+				5, &field) == 0);
+		assert(jsval_array_length(&region, field) == 70);
+		assert(src.close_calls == 1);
+	}
+
+	/* A string far longer than a chunk, with escapes split across
+	 * chunk edges, is scanned once as it arrives. */
+	for (chunk = 5; chunk <= 16; chunk += 11) {
+		static uint8_t long_body[8192];
+		static uint8_t long_copy[8192];
+		fake_body_source_t src;
+		size_t n = 0;
+		size_t i;
+
+		memcpy(long_body, "{\"blob\":\"", 9);
+		n = 9;
+		for (i = 0; i < 7000; i++) {
+			if (i % 61 == 60) {
+				long_body[n++] = '\\';
+				long_body[n++] = 'n';
+			} else {
+				long_body[n++] = (uint8_t)('a' + i % 26);
+			}
+		}
+		memcpy(long_body + n, "\",\"n\":7}", 8);
+		n += 8;
+		memset(&src, 0, sizeof(src));
+		src.data = long_body;
+		src.total = n;
+		src.chunk_size = chunk;
+		src.fail_after = -1;
+
+		jsval_region_init(&region, storage, sizeof(storage));
+		assert(jsval_headers_new(&region, JSVAL_HEADERS_GUARD_REQUEST,
+				&headers) == 0);
+		assert(jsval_request_new_from_parts(&region,
+				fetch_test_str(&region, "POST"),
+				fetch_test_str(&region, "https://ex.com"),
+				headers, &fake_body_vtable, &src, n, &request) == 0);
+		assert(jsval_request_json(&region, request, &promise) == 0);
+		memset(&error, 0, sizeof(error));
+		assert(jsval_microtask_drain(&region, &error) == 0);
+		assert(jsval_promise_state(&region, promise, &state) == 0);
+		assert(state == JSVAL_PROMISE_STATE_FULFILLED);
+		assert(jsval_promise_result(&region, promise, &got) == 0);
+		assert(jsval_object_get_utf8(&region, got, (const uint8_t *)"n", 1,
+				&field) == 0);
+		assert(jsval_strict_eq(&region, field, jsval_number(7.0)) == 1);
+		assert(jsval_object_get_utf8(&region, got, (const uint8_t *)"blob",
+				4, &field) == 0);
+		assert(field.kind == JSVAL_KIND_STRING);
+		assert(jsval_string_copy_utf8(&region, field, long_copy,
+				sizeof(long_copy), &n) == 0);
+		assert(n == 7000 && long_copy[60] == '\n' && long_copy[61] == 'j');
+	}
+
+	/* A syntax error rejects before the rest of the body is read. */
+	{
+		fake_body_source_t src = {
+			.data = bad, .total = sizeof(bad) - 1, .cursor = 0,
+			.chunk_size = 8, .fail_after = -1,
+			.reads = 0, .close_calls = 0,
+		};
+
+		jsval_region_init(&region, storage, sizeof(storage));
+		assert(jsval_headers_new(&region, JSVAL_HEADERS_GUARD_REQUEST,
+				&headers) == 0);
+		assert(jsval_request_new_from_parts(&region,
+				fetch_test_str(&region, "POST"),
+				fetch_test_str(&region, "https://ex.com"),
+				headers, &fake_body_vtable, &src, sizeof(bad) - 1,
+				&request) == 0);
+		assert(jsval_request_json(&region, request, &promise) == 0);
+		memset(&error, 0, sizeof(error));
+		assert(jsval_microtask_drain(&region, &error) == 0);
+		assert(jsval_promise_state(&region, promise, &state) == 0);
+		assert(state == JSVAL_PROMISE_STATE_REJECTED);
+		assert(src.cursor < src.total);
+		assert(src.close_calls == 1);
+	}
+}
+
+typedef struct ndjson_test_ctx_s {
+	double sum;
+	size_t records;
+	size_t last_line;
+	size_t max_used;
+} ndjson_test_ctx_t;
+
+static int ndjson_test_record(jsval_region_t *region, void *ctx,
+		jsval_t record, size_t line_no)
+{
+	ndjson_test_ctx_t *acc = (ndjson_test_ctx_t *)ctx;
+	jsval_t n;
+	double value;
+
+	assert(record.repr == JSVAL_REPR_JSON);
+	assert(jsval_object_get_utf8(region, record, (const uint8_t *)"n", 1,
+			&n) == 0);
+	assert(n.kind == JSVAL_KIND_NUMBER);
+	assert(jsval_to_number(region, n, &value) == 0);
+	acc->sum += value;
+	acc->records++;
+	acc->last_line = line_no;
+	if (region->used > acc->max_used) {
+		acc->max_used = region->used;
+	}
+	/* Scratch allocations are dropped with the record. */
+	assert(jsval_string_new_utf8(region, (const uint8_t *)"scratch", 7,
+			&n) == 0);
+	return 0;
+}
+
+static int ndjson_stall_read(void *userdata, uint8_t *buf, size_t cap,
+		size_t *out_len, jsval_body_source_status_t *status_ptr)
+{
+	(void)userdata;
+	(void)buf;
+	(void)cap;
+	*out_len = 0;
+	*status_ptr = JSVAL_BODY_SOURCE_STATUS_READY;
+	return 0;
+}
+
+static const jsval_body_source_vtable_t ndjson_stall_vtable = {
+	ndjson_stall_read,
+	NULL,
+};
+
+static void test_ndjson_reader(void)
+{
+	static uint8_t input[64 * 1024];
+	uint8_t storage[4096];
+	uint8_t line_buf[256];
+	jsval_region_t region;
+	jsval_ndjson_reader_t reader;
+	ndjson_test_ctx_t acc;
+	size_t len = 0;
+	size_t used;
+	int i;
+
+	for (i = 1; i <= 2000; i++) {
+		len += (size_t)snprintf((char *)input + len, sizeof(input) - len,
+				"{\"n\":%d,\"tag\":\"rec\"}%s", i,
+				i % 3 == 0 ? "\r\n\n" : "\n");
+	}
+	len--; /* last record without a trailing newline */
+
+	{
+		fake_body_source_t src = {
+			.data = input, .total = len, .cursor = 0,
+			.chunk_size = 37, .fail_after = -1,
+			.reads = 0, .close_calls = 0,
+		};
+
+		memset(&acc, 0, sizeof(acc));
+		jsval_region_init(&region, storage, sizeof(storage));
+		used = region.used;
+		jsval_ndjson_reader_init(&reader, &fake_body_vtable, &src, line_buf,
+				sizeof(line_buf));
+		assert(jsval_ndjson_reader_run(&region, &reader, ndjson_test_record,
+				&acc) == 1);
+		assert(acc.records == 2000);
+		assert(acc.sum == 2001000.0);
+		assert(acc.last_line == 2000 + 666);
+		assert(region.used == used);
+		assert(acc.max_used < 1024);
+	}
+
+	/* PENDING returns 0; the next run picks up where it left off. */
+	{
+		static const uint8_t body[] = "{\"n\":1}\n{\"n\":2}";
+		fake_body_source_t src = {
+			.data = body, .total = sizeof(body) - 1, .cursor = 0,
+			.chunk_size = 5, .fail_after = -1,
+			.reads = 0, .close_calls = 0, .pending = 1,
+		};
+
+		memset(&acc, 0, sizeof(acc));
+		jsval_region_init(&region, storage, sizeof(storage));
+		jsval_ndjson_reader_init(&reader, &fake_body_vtable, &src, line_buf,
+				sizeof(line_buf));
+		assert(jsval_ndjson_reader_run(&region, &reader, ndjson_test_record,
+				&acc) == 0);
+		assert(acc.records == 0);
+		src.pending = 0;
+		assert(jsval_ndjson_reader_run(&region, &reader, ndjson_test_record,
+				&acc) == 1);
+		assert(acc.records == 2);
+		assert(acc.sum == 3.0);
+	}
+
+	/* A malformed record stops the run and names its line. */
+	{
+		static const uint8_t body[] = "{\"n\":1}\n{\"n\":2]\n{\"n\":3}\n";
+		fake_body_source_t src = {
+			.data = body, .total = sizeof(body) - 1, .cursor = 0,
+			.chunk_size = 0, .fail_after = -1,
+			.reads = 0, .close_calls = 0,
+		};
+
+		memset(&acc, 0, sizeof(acc));
+		jsval_region_init(&region, storage, sizeof(storage));
+		jsval_ndjson_reader_init(&reader, &fake_body_vtable, &src, line_buf,
+				sizeof(line_buf));
+		assert(jsval_ndjson_reader_run(&region, &reader, ndjson_test_record,
+				&acc) == -1);
+		assert(errno == EINVAL);
+		assert(acc.records == 1);
+		assert(reader.line_no == 2);
+		/* The bad line is consumed; the next run resumes after it. */
+		assert(jsval_ndjson_reader_run(&region, &reader, ndjson_test_record,
+				&acc) == 1);
+		assert(acc.records == 2);
+		assert(acc.sum == 4.0);
+		assert(reader.line_no == 3);
+	}
+
+	/* A READY read with no bytes yields instead of spinning. */
+	{
+		jsval_region_init(&region, storage, sizeof(storage));
+		jsval_ndjson_reader_init(&reader, &ndjson_stall_vtable, NULL,
+				line_buf, sizeof(line_buf));
+		assert(jsval_ndjson_reader_run(&region, &reader, ndjson_test_record,
+				&acc) == 0);
+		assert(reader.len == 0);
+	}
+
+	/* A record longer than the line buffer fails with ENOBUFS. */
+	{
+		static const uint8_t body[] =
+			"{\"n\":1,\"pad\":\"0123456789012345678901234567890123456789\"}\n";
+		fake_body_source_t src = {
+			.data = body, .total = sizeof(body) - 1, .cursor = 0,
+			.chunk_size = 0, .fail_after = -1,
+			.reads = 0, .close_calls = 0,
+		};
+
+		jsval_region_init(&region, storage, sizeof(storage));
+		jsval_ndjson_reader_init(&reader, &fake_body_vtable, &src, line_buf,
+				32);
+		assert(jsval_ndjson_reader_run(&region, &reader, ndjson_test_record,
+				&acc) == -1);
+		assert(errno == ENOBUFS);
+	}
+}
+
 static int read_result_done(jsval_region_t *region, jsval_t result)
 {
 	jsval_t done_value;
@@ -15052,6 +16779,388 @@ static const jsval_underlying_sink_vtable_t erroring_sink_vtable = {
 	erroring_sink_close,
 };
 
+static void test_json_sink_stream(void)
+{
+	static const char doc_json[] = " { \"k\" : [ true , \"a b\" ] } ";
+	static const char expected[] =
+		"{\"name\":\"str\\\"eam\",\"list\":[1,[2,[3,\"four\"]],{}],"
+		"\"doc\":{\"k\":[true,\"a b\"]},\"tail\":null}";
+	uint8_t storage[16384];
+	jsval_region_t region;
+	jsval_json_sink_stream_t stream;
+	uint8_t chunk[7];
+	jsval_t root;
+	jsval_t list;
+	jsval_t inner;
+	jsval_t leaf;
+	jsval_t value;
+	jsval_t error;
+	size_t chunk_cap;
+
+	jsval_region_init(&region, storage, sizeof(storage));
+	assert(jsval_object_new(&region, 4, &root) == 0);
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"str\"eam", 7,
+			&value) == 0);
+	assert(jsval_object_set_utf8(&region, root, (const uint8_t *)"name", 4,
+			value) == 0);
+	assert(jsval_array_new(&region, 3, &list) == 0);
+	assert(jsval_array_push(&region, list, jsval_number(1)) == 0);
+	assert(jsval_array_new(&region, 2, &inner) == 0);
+	assert(jsval_array_push(&region, inner, jsval_number(2)) == 0);
+	assert(jsval_array_new(&region, 2, &leaf) == 0);
+	assert(jsval_array_push(&region, leaf, jsval_number(3)) == 0);
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"four", 4,
+			&value) == 0);
+	assert(jsval_array_push(&region, leaf, value) == 0);
+	assert(jsval_array_push(&region, inner, leaf) == 0);
+	assert(jsval_array_push(&region, list, inner) == 0);
+	assert(jsval_object_new(&region, 0, &value) == 0);
+	assert(jsval_array_push(&region, list, value) == 0);
+	assert(jsval_object_set_utf8(&region, root, (const uint8_t *)"list", 4,
+			list) == 0);
+	assert(jsval_json_parse(&region, (const uint8_t *)doc_json,
+			sizeof(doc_json) - 1, 8, &value) == 0);
+	assert(jsval_object_set_utf8(&region, root, (const uint8_t *)"doc", 3,
+			value) == 0);
+	assert(jsval_object_set_utf8(&region, root, (const uint8_t *)"tail", 4,
+			jsval_null()) == 0);
+	assert_json(&region, root, expected);
+
+	/* Every chunk size yields the same bytes as jsval_copy_json. */
+	for (chunk_cap = 1; chunk_cap <= sizeof(chunk); chunk_cap++) {
+		capturing_sink_t sink;
+
+		memset(&sink, 0, sizeof(sink));
+		jsval_json_sink_stream_init(&stream, root, &capturing_sink_vtable,
+				&sink, chunk, chunk_cap);
+		assert(jsval_json_sink_stream_run(&region, &stream, NULL) == 1);
+		assert(sink.written == sizeof(expected) - 1);
+		assert(memcmp(sink.buf, expected, sink.written) == 0);
+		assert(sink.close_calls == 0);
+	}
+
+	/* Backpressure yields; the run picks up mid-chunk once drained. */
+	{
+		bounded_sink_t sink;
+		uint8_t out[sizeof(expected)];
+		size_t out_len = 0;
+		int yields = 0;
+		int rc;
+
+		memset(&sink, 0, sizeof(sink));
+		jsval_json_sink_stream_init(&stream, root, &bounded_sink_vtable,
+				&sink, chunk, 5);
+		for (;;) {
+			sink.budget = 3;
+			sink.written = 0;
+			rc = jsval_json_sink_stream_run(&region, &stream, NULL);
+			assert(out_len + sink.written <= sizeof(out));
+			memcpy(out + out_len, sink.buf, sink.written);
+			out_len += sink.written;
+			if (rc == 1) {
+				break;
+			}
+			assert(rc == 0);
+			yields++;
+		}
+		assert(yields > 1);
+		assert(out_len == sizeof(expected) - 1);
+		assert(memcmp(out, expected, out_len) == 0);
+	}
+
+	/* Sink errors surface as EIO with the sink's reason. */
+	jsval_json_sink_stream_init(&stream, root, &erroring_sink_vtable, NULL,
+			chunk, sizeof(chunk));
+	errno = 0;
+	assert(jsval_json_sink_stream_run(&region, &stream, &error) == -1);
+	assert(errno == EIO);
+	assert(error.kind == JSVAL_KIND_DOM_EXCEPTION);
+
+	/* Emission errors are reported as jsval_copy_json reports them. */
+	assert(jsval_array_new(&region, 2, &value) == 0);
+	assert(jsval_array_push(&region, value, list) == 0);
+	assert(jsval_array_push(&region, value, jsval_undefined()) == 0);
+	jsval_json_sink_stream_init(&stream, value, &capturing_sink_vtable,
+			&(capturing_sink_t){0}, chunk, 4);
+	errno = 0;
+	assert(jsval_json_sink_stream_run(&region, &stream, NULL) == -1);
+	assert(errno == ENOTSUP);
+
+	/* Leaves many chunks long resume inside the leaf. */
+	{
+		static uint8_t big_storage[65536];
+		static char text[3001];
+		static char doc_text[3100];
+		static uint8_t want[16384];
+		static uint8_t out[16384];
+		uint8_t big_chunk[16];
+		bounded_sink_t sink;
+		size_t want_len = 0;
+		size_t out_len = 0;
+		size_t doc_len;
+		size_t i;
+		int inside = 0;
+		int rc;
+
+		for (i = 0; i < sizeof(text) - 1; i++) {
+			text[i] = i % 97 == 0 ? '"' : i % 89 == 0 ? '\n'
+					: (char)('a' + i % 26);
+		}
+		/* Unindexed, so it is copied through the minifier. */
+		doc_len = (size_t)snprintf(doc_text, sizeof(doc_text), "{ \"s\" : \"");
+		for (i = 0; i < 2000; i++) {
+			if (i % 97 == 0) {
+				doc_text[doc_len++] = '\\';
+				doc_text[doc_len++] = '"';
+			} else {
+				doc_text[doc_len++] = i % 7 == 0 ? ' ' : (char)('a' + i % 26);
+			}
+		}
+		doc_len += (size_t)snprintf(doc_text + doc_len,
+				sizeof(doc_text) - doc_len, "\" , \"n\" : [ 1 , 2 ] }");
+		jsval_region_init(&region, big_storage, sizeof(big_storage));
+		assert(jsval_array_new(&region, 3, &root) == 0);
+		assert(jsval_string_new_utf8(&region, (const uint8_t *)text,
+				sizeof(text) - 1, &value) == 0);
+		assert(jsval_array_push(&region, root, value) == 0);
+		assert(jsval_object_new(&region, 1, &value) == 0);
+		assert(jsval_object_set_utf8(&region, value, (const uint8_t *)text,
+				sizeof(text) - 1, jsval_number(1)) == 0);
+		assert(jsval_array_push(&region, root, value) == 0);
+		assert(jsval_json_parse(&region, (const uint8_t *)doc_text, doc_len,
+				16, &value) == 0);
+		assert(jsval_array_push(&region, root, value) == 0);
+		assert(jsval_copy_json(&region, root, NULL, 0, &want_len) == 0);
+		assert(want_len > 6000 && want_len <= sizeof(want));
+		assert(jsval_copy_json(&region, root, want, want_len, NULL) == 0);
+
+		memset(&sink, 0, sizeof(sink));
+		jsval_json_sink_stream_init(&stream, root, &bounded_sink_vtable,
+				&sink, big_chunk, sizeof(big_chunk));
+		for (;;) {
+			sink.budget = sizeof(sink.buf);
+			sink.written = 0;
+			rc = jsval_json_sink_stream_run(&region, &stream, NULL);
+			assert(out_len + sink.written <= sizeof(out));
+			memcpy(out + out_len, sink.buf, sink.written);
+			out_len += sink.written;
+			if (rc == 1) {
+				break;
+			}
+			assert(rc == 0);
+			if (stream.state.leaf_pending && stream.state.leaf_pos > 0) {
+				inside++;
+			}
+		}
+		assert(inside > 100);
+		assert(out_len == want_len);
+		assert(memcmp(out, want, out_len) == 0);
+	}
+}
+
+static void test_region_node_recycling(void)
+{
+	uint8_t storage[65536];
+	jsval_region_t region;
+	jsmethod_error_t error;
+	capturing_sink_t sink;
+	jsval_region_mark_t mark;
+	jsval_t args[100];
+	jsval_t function;
+	jsval_t stream;
+	jsval_t writer;
+	jsval_t promise;
+	jsval_t downstream;
+	jsval_promise_state_t state;
+	size_t promise_size;
+	size_t used;
+	int i;
+
+	jsval_region_init(&region, storage, sizeof(storage));
+	for (i = 0; i < 100; i++) {
+		args[i] = jsval_number(i);
+	}
+	assert(jsval_function_new(&region, test_promise_identity, 1, 0,
+			jsval_undefined(), &function) == 0);
+
+	/* Dispatched microtasks are reused: steady state allocates nothing. */
+	assert(jsval_queue_microtask(&region, function) == 0);
+	assert(jsval_microtask_drain(&region, &error) == 0);
+	used = region.used;
+	for (i = 0; i < 1000; i++) {
+		assert(jsval_queue_microtask(&region, function) == 0);
+		assert(jsval_microtask_drain(&region, &error) == 0);
+	}
+	assert(region.used == used);
+
+	/* Reactions and their tasks are reused; only the promise from
+	 * then() is new. */
+	assert(jsval_promise_new(&region, &promise) == 0);
+	promise_size = region.used - used;
+	assert(jsval_promise_resolve(&region, promise, jsval_number(1)) == 0);
+	assert(jsval_promise_then(&region, promise, function, jsval_undefined(),
+			&downstream) == 0);
+	assert(jsval_microtask_drain(&region, &error) == 0);
+	for (i = 0; i < 100; i++) {
+		used = region.used;
+		assert(jsval_promise_then(&region, promise, function,
+				jsval_undefined(), &downstream) == 0);
+		assert(jsval_microtask_drain(&region, &error) == 0);
+		assert(jsval_promise_state(&region, downstream, &state) == 0);
+		assert(state == JSVAL_PROMISE_STATE_FULFILLED);
+		assert(region.used - used == promise_size);
+	}
+
+	/* Pending writes and pump tasks are reused; each write() still
+	 * returns a fresh promise. */
+	memset(&sink, 0, sizeof(sink));
+	assert(jsval_writable_stream_new_from_sink(&region,
+			&capturing_sink_vtable, &sink, &stream) == 0);
+	assert(jsval_writable_stream_get_writer(&region, stream, &writer) == 0);
+	assert(jsval_writable_stream_writer_write(&region, writer,
+			(const uint8_t *)"chunk", 5, &promise) == 0);
+	assert(jsval_microtask_drain(&region, &error) == 0);
+	for (i = 0; i < 100; i++) {
+		sink.written = 0;
+		used = region.used;
+		assert(jsval_writable_stream_writer_write(&region, writer,
+				(const uint8_t *)"chunk", 5, &promise) == 0);
+		assert(jsval_microtask_drain(&region, &error) == 0);
+		assert(jsval_promise_state(&region, promise, &state) == 0);
+		assert(state == JSVAL_PROMISE_STATE_FULFILLED);
+		assert(region.used - used == promise_size);
+	}
+	assert(sink.write_calls == 101);
+
+	/* Nodes freed inside a released scope do not survive it. */
+	used = region.used;
+	assert(jsval_region_mark(&region, &mark) == 0);
+	assert(jsval_microtask_enqueue(&region, function, 100,
+			args) == 0);
+	assert(jsval_microtask_drain(&region, &error) == 0);
+	assert(jsval_region_release(&region, &mark) == 0);
+	assert(jsval_microtask_enqueue(&region, function, 100,
+			args) == 0);
+	assert(region.used > used);
+	assert(jsval_microtask_drain(&region, &error) == 0);
+
+	/* Older free nodes are not handed out inside a scope, so a task
+	 * queued there is still seen as pending by release. */
+	assert(jsval_queue_microtask(&region, function) == 0);
+	assert(jsval_microtask_drain(&region, &error) == 0);
+	assert(jsval_region_mark(&region, &mark) == 0);
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"scoped", 6,
+			&args[0]) == 0);
+	assert(jsval_microtask_enqueue(&region, function, 1, args) == 0);
+	errno = 0;
+	assert(jsval_region_release(&region, &mark) == -1);
+	assert(errno == EBUSY);
+	assert(jsval_microtask_pending(&region) == 1);
+	assert(jsval_microtask_drain(&region, &error) == 0);
+	assert(jsval_region_release(&region, &mark) == 0);
+	used = region.used;
+	assert(jsval_queue_microtask(&region, function) == 0);
+	assert(region.used == used);
+	assert(jsval_microtask_drain(&region, &error) == 0);
+}
+
+static void test_region_alloc_stats(void)
+{
+	uint8_t storage[16384];
+	jsval_region_t region;
+	jsval_region_stats_t stats;
+	jsmethod_error_t error;
+	jsval_t value;
+	jsval_t function;
+	size_t start;
+	size_t used;
+	size_t total;
+	size_t tasks;
+	int i;
+
+	jsval_region_init(&region, storage, sizeof(storage));
+#if JSMX_WITH_ALLOC_STATS
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"x", 1,
+			&value) == 0);
+	start = region.used;
+	assert(jsval_region_set_stats(&region, &stats) == 0);
+	assert(stats.high_water == start);
+
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"hello", 5,
+			&value) == 0);
+	assert(stats.count[JSVAL_KIND_STRING] == 1);
+	assert(stats.bytes[JSVAL_KIND_STRING] >= 5);
+	assert(stats.string_payload_bytes >= 5);
+	assert(stats.string_payload_bytes
+			< stats.bytes[JSVAL_KIND_STRING]);
+
+	assert(jsval_object_new(&region, 4, &value) == 0);
+	assert(stats.count[JSVAL_KIND_OBJECT] >= 1);
+
+	assert(jsval_json_parse(&region, (const uint8_t *)"{\"a\":[1,2]}", 11,
+			16, &value) == 0);
+	assert(stats.count[JSVAL_ALLOC_CLASS_JSON_DOC] == 1);
+	assert(stats.bytes[JSVAL_ALLOC_CLASS_JSON_TOKENS] > 0);
+	assert(stats.bytes[JSVAL_ALLOC_CLASS_JSON_SOURCE] >= 11);
+
+	assert(jsval_function_new(&region, test_promise_identity, 1, 0,
+			jsval_undefined(), &function) == 0);
+	assert(jsval_queue_microtask(&region, function) == 0);
+	assert(stats.count[JSVAL_ALLOC_CLASS_MICROTASK] == 1);
+	tasks = 0;
+	for (i = 0; i < JSVAL_ALLOC_MICROTASK_KINDS; i++) {
+		tasks += stats.microtask_count[i];
+	}
+	assert(tasks == 1);
+	assert(jsval_microtask_drain(&region, &error) == 0);
+
+	/* Recycled nodes are counted but charge no bytes. */
+	used = region.used;
+	assert(jsval_queue_microtask(&region, function) == 0);
+	assert(region.used == used);
+	assert(stats.recycled_count == 1);
+	assert(stats.count[JSVAL_ALLOC_CLASS_MICROTASK] == 1);
+	assert(jsval_microtask_drain(&region, &error) == 0);
+
+	/* Every byte of growth lands in exactly one class. */
+	total = 0;
+	for (i = 0; i < JSVAL_ALLOC_CLASS_COUNT; i++) {
+		total += stats.bytes[i];
+	}
+	assert(total == region.used - start);
+	assert(stats.high_water == region.used);
+
+	/* high_water survives a release. */
+	{
+		jsval_region_mark_t mark;
+
+		assert(jsval_region_mark(&region, &mark) == 0);
+		assert(jsval_object_new(&region, 32, &value) == 0);
+		used = region.used;
+		assert(jsval_region_release(&region, &mark) == 0);
+		assert(stats.high_water == used);
+	}
+
+	assert(jsval_region_set_stats(&region, NULL) == 0);
+	used = stats.bytes[JSVAL_KIND_STRING];
+	assert(jsval_string_new_utf8(&region, (const uint8_t *)"y", 1,
+			&value) == 0);
+	assert(stats.bytes[JSVAL_KIND_STRING] == used);
+#else
+	(void)error;
+	(void)function;
+	(void)start;
+	(void)used;
+	(void)total;
+	(void)tasks;
+	(void)i;
+	(void)value;
+	errno = 0;
+	assert(jsval_region_set_stats(&region, &stats) < 0);
+	assert(errno == ENOTSUP);
+#endif
+}
+
 static void test_writable_stream_semantics(void)
 {
 	uint8_t storage[262144];
@@ -17065,6 +19174,11 @@ static void test_array_buffer_bytes_mut_helper(void)
 int main(void)
 {
 	test_region_alloc_helpers();
+	test_region_mark_release();
+	test_region_snapshot_restore();
+	test_region_compact();
+	test_region_image();
+	test_region_grow();
 	test_native_storage();
 	test_value_semantics();
 	test_symbol_semantics();
@@ -17081,6 +19195,7 @@ int main(void)
 	test_base64_codec_semantics();
 	test_set_semantics();
 	test_map_semantics();
+	test_collection_hashed_lookup();
 	test_iterator_semantics();
 	test_typeof_semantics();
 	test_url_object_semantics();
@@ -17095,9 +19210,21 @@ int main(void)
 	test_json_backed_value_parity();
 	test_json_storage();
 	test_json_root_rebase();
+	test_json_parse_borrowed();
+	test_json_parse_auto();
+	test_json_copy_passthrough();
+	test_json_project_paths();
 	test_json_mutation_requires_promotion();
 	test_native_container_helpers();
 	test_json_container_helpers();
+	test_json_nested_sibling_skip();
+	test_json_array_linear_walks();
+	test_json_escaped_key_lookup();
+	test_json_wide_object_lookup();
+	test_object_hashed_lookup();
+	test_object_shapes();
+	test_region_atoms();
+	test_value_cells();
 	test_object_copy_own_helpers();
 	test_object_clone_own_helpers();
 	test_array_clone_dense_helpers();
@@ -17151,8 +19278,13 @@ int main(void)
 	test_response_readable_body_semantics();
 	test_readable_stream_tee_semantics();
 	test_fetch_body_drain_semantics();
+	test_fetch_body_drain_json_incremental();
+	test_ndjson_reader();
 	test_readable_stream_semantics();
 	test_writable_stream_semantics();
+	test_region_node_recycling();
+	test_region_alloc_stats();
+	test_json_sink_stream();
 	test_transform_stream_semantics();
 	test_text_decoder_encoder_stream_semantics();
 	test_text_decoder_stream_options_semantics();